@@ -0,0 +1,133 @@
+#!/bin/sh
+#
+#Loopback benchmark of file_server/file_client, run by 'make bench'
+#every transfer of the matrix file size x block/window setting x operation prints one JSON line:
+#the client report (-R: throughput, per-block round trip p50/p99, client CPU) plus the server CPU time
+#
+#usage: bench.sh [TFTP binary]
+#environment:
+#  BENCH_SIZES        file sizes, K/M/G suffixes (default "1K 64K 1M 16M 256M 1G 4G")
+#  BENCH_SETTINGS     <blksize>:<windowsize> pairs requested by the client (default "512:1 1428:1 1428:16 8192:8 65464:1")
+#  BENCH_OPS          operations (default "getfile putfile")
+#  BENCH_SERVER_ARGS  extra server arguments, e.g. "-e uring -t 2"
+#  BENCH_CLIENT_ARGS  extra client arguments, e.g. "-N loss=1%,delay=20,seed=1" for a simulated WAN link
+#  BENCH_PORT         server port (default 16969)
+#  BENCH_OUT          results file, JSON lines (default bench-results.jsonl)
+#  BENCH_DIR          scratch directory, needs twice the largest size (default a new temporary directory)
+#
+
+BIN=$(cd "$(dirname "${1:-./TFTP}")" && pwd)/$(basename "${1:-./TFTP}")
+SIZES=${BENCH_SIZES:-"1K 64K 1M 16M 256M 1G 4G"}
+SETTINGS=${BENCH_SETTINGS:-"512:1 1428:1 1428:16 8192:8 65464:1"}
+OPS=${BENCH_OPS:-"getfile putfile"}
+PORT=${BENCH_PORT:-16969}
+OUT=${BENCH_OUT:-bench-results.jsonl}
+DIR=${BENCH_DIR:-$(mktemp -d "${TMPDIR:-/tmp}/tftp-bench.XXXXXX")}
+TICKS=$(getconf CLK_TCK)
+FAILED=0
+
+if [ ! -x "$BIN" ]; then
+	echo "error: $BIN not found, run make first" >&2
+	exit 1
+fi
+
+mkdir -p "$DIR/server" "$DIR/client" || exit 1
+: > "$OUT"
+
+#size with a K/M/G suffix in bytes
+bytes()
+{
+	case $1 in
+		*K) echo $((${1%K} * 1024)) ;;
+		*M) echo $((${1%M} * 1024 * 1024)) ;;
+		*G) echo $((${1%G} * 1024 * 1024 * 1024)) ;;
+		*) echo "$1" ;;
+	esac
+}
+
+#user + system CPU time of the server in clock ticks (Linux /proc), 0 if unknown
+server_ticks()
+{
+	if [ -r "/proc/$SERVER/stat" ]; then
+		#the fields after the command name, utime and stime are fields 14 and 15 of the line
+		sed 's/^.*) //' "/proc/$SERVER/stat" | awk '{ print $12 + $13 }'
+	else
+		echo 0
+	fi
+}
+
+cleanup()
+{
+	kill -INT "$SERVER" 2>/dev/null
+	wait "$SERVER" 2>/dev/null
+
+	if [ -z "$BENCH_DIR" ]; then
+		rm -rf "$DIR"
+	fi
+}
+
+(cd "$DIR/server" && exec "$BIN" -m server -p "$PORT" $BENCH_SERVER_ARGS > "$DIR/server.log" 2>&1) &
+SERVER=$!
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+sleep 0.5
+
+if ! kill -0 "$SERVER" 2>/dev/null; then
+	echo "error: server did not start, see $DIR/server.log" >&2
+	cat "$DIR/server.log" >&2
+	exit 1
+fi
+
+for size in $SIZES; do
+	#one file serves both directions: downloaded from the server directory, uploaded from the client directory
+	rm -f "$DIR/server/"*.bin "$DIR/client/"*.bin
+	head -c "$(bytes "$size")" /dev/urandom > "$DIR/client/put.bin" || exit 1
+	ln "$DIR/client/put.bin" "$DIR/server/get.bin" 2>/dev/null || cp "$DIR/client/put.bin" "$DIR/server/get.bin" || exit 1
+
+	for setting in $SETTINGS; do
+		blksize=${setting%:*}
+		windowsize=${setting#*:}
+
+		for op in $OPS; do
+			if [ "$op" = "getfile" ]; then
+				file=get.bin
+			else
+				file=put.bin
+			fi
+
+			rm -f "$DIR/report.json"
+			before=$(server_ticks)
+
+			(cd "$DIR/client" && "$BIN" -m client -p "$PORT" -r 127.0.0.1 -o "$op" -f "$file" \
+				-b "$blksize" -w "$windowsize" -R "$DIR/report.json" $BENCH_CLIENT_ARGS > "$DIR/client.log" 2>&1)
+
+			after=$(server_ticks)
+
+			#the copy the transfer created is not needed any more
+			if [ "$op" = "getfile" ]; then
+				rm -f "$DIR/client/get.bin"
+			else
+				rm -f "$DIR/server/put.bin"
+			fi
+
+			if [ ! -s "$DIR/report.json" ]; then
+				echo "{\"operation\":\"$op\",\"size\":\"$size\",\"blksize\":$blksize,\"windowsize\":$windowsize,\"ok\":false}" | tee -a "$OUT"
+				FAILED=1
+				continue
+			fi
+
+			grep -q '"ok":true' "$DIR/report.json" || FAILED=1
+
+			#client report extended with the benchmark case and the server CPU time
+			awk -v size="$size" -v req="$blksize:$windowsize" -v cpu="$(((after - before) * 1000000 / TICKS))" '
+				{
+					sub(/}$/, sprintf(",\"size\":\"%s\",\"requested\":\"%s\",\"server_cpu_seconds\":%.6f}", size, req, cpu / 1e6))
+					print
+				}' "$DIR/report.json" | tee -a "$OUT"
+		done
+	done
+done
+
+rm -f "$DIR/server/"*.bin "$DIR/client/"*.bin
+echo "results written to $OUT" >&2
+exit $FAILED
@@ -0,0 +1,413 @@
+//
+//Content cache, whole files held in memory for repeated read requests
+//
+
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+//path hash (FNV-1a)
+static unsigned cache_hash(const char *path)
+{
+	uint32_t h = 2166136261u;
+
+	while (*path != '\0')
+	{
+		h ^= (uint8_t)*path++;
+		h *= 16777619u;
+	}
+
+	return h & (CACHE_HASH_SIZE - 1);
+}
+
+static void cache_lock(content_cache_t *c)
+{
+	#ifdef _WIN32
+		EnterCriticalSection(&c->lock);
+	#else
+		pthread_mutex_lock(&c->lock);
+	#endif
+}
+
+static void cache_unlock(content_cache_t *c)
+{
+	#ifdef _WIN32
+		LeaveCriticalSection(&c->lock);
+	#else
+		pthread_mutex_unlock(&c->lock);
+	#endif
+}
+
+//file modification time in ns
+static int64_t cache_mtime(const struct stat *st)
+{
+	#ifdef __linux__
+		return ((int64_t)st->st_mtim.tv_sec * 1000000000) + st->st_mtim.tv_nsec;
+	#else
+		return (int64_t)st->st_mtime * 1000000000;
+	#endif
+}
+
+static void cache_lru_unlink(content_cache_t *c, cache_entry_t *e)
+{
+	if (e->lruPrev != NULL)
+		e->lruPrev->lruNext = e->lruNext;
+	else
+		c->lruHead = e->lruNext;
+
+	if (e->lruNext != NULL)
+		e->lruNext->lruPrev = e->lruPrev;
+	else
+		c->lruTail = e->lruPrev;
+
+	e->lruNext = NULL;
+	e->lruPrev = NULL;
+}
+
+static void cache_lru_push_front(content_cache_t *c, cache_entry_t *e)
+{
+	e->lruPrev = NULL;
+	e->lruNext = c->lruHead;
+
+	if (c->lruHead != NULL)
+		c->lruHead->lruPrev = e;
+	else
+		c->lruTail = e;
+
+	c->lruHead = e;
+}
+
+static void cache_free_entry(content_cache_t *c, cache_entry_t *e)
+{
+	c->used -= e->size;
+	free(e->data);
+	free(e->path);
+	free(e);
+}
+
+static void cache_hash_unlink(content_cache_t *c, cache_entry_t *e)
+{
+	cache_entry_t **pp = &c->hashTbl[cache_hash(e->path)];
+
+	while (*pp != e)
+		pp = &(*pp)->hashNext;
+
+	*pp = e->hashNext;
+	c->numEntries--;
+}
+
+//takes an entry out of the hash table and LRU list, it is freed now or on its last release
+static void cache_remove(content_cache_t *c, cache_entry_t *e)
+{
+	cache_hash_unlink(c, e);
+	cache_lru_unlink(c, e);
+
+	if (e->refs > 0)
+		e->isStale = 1;
+	else
+		cache_free_entry(c, e);
+}
+
+//evicts least recently used entries that are not in use until 'size' more bytes fit
+// returns 1=fits, 0=budget exhausted by entries in use or being loaded
+static int cache_make_room(content_cache_t *c, uint64_t size)
+{
+	cache_entry_t *e = c->lruTail;
+	cache_entry_t *prev;
+
+	while ((c->used + size > c->budget) && (e != NULL))
+	{
+		prev = e->lruPrev;
+
+		if (e->refs == 0)
+			cache_remove(c, e);
+
+		e = prev;
+	}
+
+	return (c->used + size <= c->budget);
+}
+
+//admits a new entry for a file, called under the lock
+//its budget is reserved and it stays hidden from lookups until cache_load_done
+// returns entry to be read by cache_load, NULL if it doesn't fit
+static cache_entry_t *cache_admit(content_cache_t *c, const char *path, const struct stat *st)
+{
+	cache_entry_t *e;
+	unsigned h;
+
+	if (!cache_make_room(c, (uint64_t)st->st_size))
+		return NULL;
+
+	e = calloc(1, sizeof(*e));
+
+	if (e == NULL)
+		return NULL;
+
+	e->path = malloc(strlen(path) + 1);
+	e->data = malloc((size_t)st->st_size);
+
+	if ((e->path == NULL) || (e->data == NULL))
+	{
+		free(e->path);
+		free(e->data);
+		free(e);
+		return NULL;
+	}
+
+	strcpy(e->path, path);
+
+	e->dev = (uint64_t)st->st_dev;
+	e->ino = (uint64_t)st->st_ino;
+	e->mtime = cache_mtime(st);
+	e->size = (uint64_t)st->st_size;
+	e->isLoading = 1;
+
+	h = cache_hash(path);
+	e->hashNext = c->hashTbl[h];
+	c->hashTbl[h] = e;
+
+	c->used += e->size;
+	c->numEntries++;
+
+	return e;
+}
+
+//reads the file of an admitted entry, called without the lock
+// returns 1=data holds the file as it was admitted, 0=read failed or the file changed
+static int cache_load(const cache_entry_t *e)
+{
+	FILE *pFile;
+	struct stat st;
+	size_t bytesRead;
+	int isOk;
+
+	pFile = fopen(e->path, "rb");
+
+	if (pFile == NULL)
+		return 0;
+
+	bytesRead = fread(e->data, 1, (size_t)e->size, pFile);
+
+	// file changed while it was read, don't cache a torn copy
+	isOk = (bytesRead == (size_t)e->size) && (fstat(fileno(pFile), &st) == 0) &&
+		(e->dev == (uint64_t)st.st_dev) && (e->ino == (uint64_t)st.st_ino) &&
+		(e->mtime == cache_mtime(&st)) && (e->size == (uint64_t)st.st_size);
+
+	fclose(pFile);
+	return isOk;
+}
+
+//publishes a loaded entry or drops a failed one, called under the lock
+static void cache_load_done(content_cache_t *c, cache_entry_t *e, int isOk)
+{
+	if (isOk)
+	{
+		e->isLoading = 0;
+		cache_lru_push_front(c, e);
+	}
+	else
+	{
+		cache_hash_unlink(c, e);
+		cache_free_entry(c, e);
+	}
+}
+
+typedef struct
+{
+	io_job_t job;				//first, the pool hands back this pointer
+	content_cache_t *c;
+	cache_entry_t *e;
+} cache_load_job_t;
+
+//I/O pool call, loads an entry off the network loop
+static void cache_load_job(io_job_t *job)
+{
+	cache_load_job_t *lj = (cache_load_job_t *)job;
+	int isOk = cache_load(lj->e);
+
+	cache_lock(lj->c);
+	cache_load_done(lj->c, lj->e, isOk);
+	cache_unlock(lj->c);
+
+	free(lj);
+}
+
+void CacheInit(content_cache_t *c, uint64_t budget)
+{
+	memset(c, 0, sizeof(*c));
+	c->budget = budget;
+
+	#ifdef _WIN32
+		InitializeCriticalSection(&c->lock);
+	#else
+		pthread_mutex_init(&c->lock, NULL);
+	#endif
+}
+
+// gets the contents of a file, loading it on a miss or when the file changed, thread safe
+// returns entry to be released with CacheRelease, NULL if not cacheable (caller reads the file)
+cache_entry_t *CacheAcquire(content_cache_t *c, const char *path)
+{
+	struct stat st;
+	cache_entry_t *e;
+	cache_load_job_t *lj;
+	int isOk;
+
+	if (c->budget == 0)
+		return NULL;
+
+	//one stat per request validates the entry against the file on disk
+	if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size == 0) || ((uint64_t)st.st_size > c->budget))
+		return NULL;
+
+	//entries only change under the lock, their data is immutable and read without it
+	cache_lock(c);
+
+	for (e = c->hashTbl[cache_hash(path)]; e != NULL; e = e->hashNext)
+	{
+		if (strcmp(e->path, path) == 0)
+			break;
+	}
+
+	//another request's load is still running, this one streams from the file
+	if ((e != NULL) && e->isLoading)
+	{
+		cache_unlock(c);
+		return NULL;
+	}
+
+	if ((e != NULL) && ((e->dev != (uint64_t)st.st_dev) || (e->ino != (uint64_t)st.st_ino) ||
+		(e->mtime != cache_mtime(&st)) || (e->size != (uint64_t)st.st_size)))
+	{
+		// replaced or modified, sessions still sending the old copy keep it until released
+		cache_remove(c, e);
+		e = NULL;
+	}
+
+	if (e == NULL)
+	{
+		e = cache_admit(c, path, &st);
+		cache_unlock(c);
+
+		if (e == NULL)
+			return NULL;
+
+		if (c->io != NULL)
+		{
+			lj = calloc(1, sizeof(*lj));
+
+			if (lj != NULL)
+			{
+				//this request streams from the file, later ones hit the cache once loaded
+				lj->job.op = IO_OP_CALL;
+				lj->job.fn = cache_load_job;
+				lj->c = c;
+				lj->e = e;
+				IoPoolSubmit(c->io, &lj->job, cache_hash(path));
+				return NULL;
+			}
+		}
+
+		isOk = cache_load(e);
+
+		cache_lock(c);
+		cache_load_done(c, e, isOk);
+
+		if (!isOk)
+		{
+			cache_unlock(c);
+			return NULL;
+		}
+	}
+	else
+	{
+		cache_lru_unlink(c, e);
+		cache_lru_push_front(c, e);
+	}
+
+	e->refs++;
+
+	cache_unlock(c);
+	return e;
+}
+
+void CacheRelease(content_cache_t *c, cache_entry_t *e)
+{
+	cache_lock(c);
+
+	e->refs--;
+
+	if ((e->refs == 0) && e->isStale)
+		cache_free_entry(c, e);
+
+	cache_unlock(c);
+}
+
+// loads the files listed in a manifest, one path per line, '#' starts a comment
+// returns number of files loaded, -1 if the manifest can't be opened
+int CacheLoadManifest(content_cache_t *c, const char *manifest)
+{
+	FILE *pFile;
+	char line[1024];
+	char *p;
+	size_t len;
+	cache_entry_t *e;
+	int num = 0;
+
+	pFile = fopen(manifest, "r");
+
+	if (pFile == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		p = strchr(line, '#');
+
+		if (p != NULL)
+			*p = '\0';
+
+		//trim surrounding white space
+		p = line;
+
+		while ((*p == ' ') || (*p == '\t'))
+			p++;
+
+		len = strlen(p);
+
+		while ((len > 0) && ((p[len - 1] == '\n') || (p[len - 1] == '\r') || (p[len - 1] == ' ') || (p[len - 1] == '\t')))
+			p[--len] = '\0';
+
+		if (len == 0)
+			continue;
+
+		e = CacheAcquire(c, p);
+
+		if (e == NULL)
+		{
+			printf("cache: failed to load '%s'\n", p);
+			continue;
+		}
+
+		CacheRelease(c, e);
+		num++;
+	}
+
+	fclose(pFile);
+	return num;
+}
+
+// frees all entries, entries still in use must have been released
+void CacheDestroy(content_cache_t *c)
+{
+	while (c->lruHead != NULL)
+		cache_remove(c, c->lruHead);
+
+	#ifdef _WIN32
+		DeleteCriticalSection(&c->lock);
+	#else
+		pthread_mutex_destroy(&c->lock);
+	#endif
+}
@@ -0,0 +1,77 @@
+//
+//Content cache, whole files held in memory for repeated read requests
+//
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdint.h>
+#include "iopool.h"
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <windows.h>
+	typedef CRITICAL_SECTION cache_lock_t;
+#else
+	#include <pthread.h>
+	typedef pthread_mutex_t cache_lock_t;
+#endif
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#define CACHE_HASH_SIZE		256		//must be a power of 2
+
+typedef struct cache_entry_s
+{
+	char *path;				//key, as requested
+	uint64_t dev;			//file identity when loaded, a change invalidates the entry
+	uint64_t ino;
+	int64_t mtime;			//ns
+	uint64_t size;
+
+	uint8_t *data;			//file contents
+	int refs;				//sessions sending from data
+	int isStale;			//file changed while in use, freed on last release
+	int isLoading;			//being read, in the hash table but not the LRU list and not handed out
+
+	struct cache_entry_s *hashNext;
+	struct cache_entry_s *lruNext;	//most recently used first
+	struct cache_entry_s *lruPrev;
+} cache_entry_t;
+
+typedef struct
+{
+	uint64_t budget;		//max bytes of file data held, 0 = cache disabled
+	uint64_t used;
+	uint32_t numEntries;
+
+	cache_entry_t *hashTbl[CACHE_HASH_SIZE];
+	cache_entry_t *lruHead;
+	cache_entry_t *lruTail;
+
+	cache_lock_t lock;		//the cache is shared by all server workers
+	io_pool_t *io;			//reads files admitted on a miss, NULL = read by the caller
+} content_cache_t;
+
+extern void CacheInit(content_cache_t *c, uint64_t budget);
+
+// gets the contents of a file, loading it on a miss or when the file changed, thread safe
+// with an I/O pool the load runs there and this request is not served from the cache
+// returns entry to be released with CacheRelease, NULL if not cached (caller reads the file)
+extern cache_entry_t *CacheAcquire(content_cache_t *c, const char *path);
+
+extern void CacheRelease(content_cache_t *c, cache_entry_t *e);
+
+// loads the files listed in a manifest, one path per line, '#' starts a comment
+// returns number of files loaded, -1 if the manifest can't be opened
+extern int CacheLoadManifest(content_cache_t *c, const char *manifest);
+
+// frees all entries, entries still in use must have been released
+extern void CacheDestroy(content_cache_t *c);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _CACHE_H
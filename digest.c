@@ -0,0 +1,336 @@
+//
+//Checksums of transferred data, computed block by block as the data is sent or received
+//CRC32C uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them, SHA-256 is computed in software
+//
+
+#include "digest.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#define strcasecmp _stricmp
+#else
+	#include <strings.h>
+#endif
+
+//the SSE4.2 code is compiled for the target and chosen at run time if the CPU has SSE4.2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define DIGEST_CRC_SSE42
+	#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+	#define DIGEST_CRC_ARM
+	#include <arm_acle.h>
+#endif
+
+//CRC32C (Castagnoli, reflected polynomial 0x82F63B78), one byte at a time
+static const uint32_t kCrc32cTable[256] =
+{
+	0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C,
+	0x26A1E7E8, 0xD4CA64EB, 0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
+	0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24, 0x105EC76F, 0xE235446C,
+	0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+	0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC,
+	0xBC267848, 0x4E4DFB4B, 0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
+	0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35, 0xAA64D611, 0x580F5512,
+	0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+	0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD,
+	0x1642AE59, 0xE4292D5A, 0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
+	0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595, 0x417B1DBC, 0xB3109EBF,
+	0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+	0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F,
+	0xED03A29B, 0x1F682198, 0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
+	0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38, 0xDBFC821C, 0x2997011F,
+	0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+	0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E,
+	0x4767748A, 0xB50CF789, 0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
+	0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46, 0x7198540D, 0x83F3D70E,
+	0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+	0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE,
+	0xDDE0EB2A, 0x2F8B6829, 0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
+	0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93, 0x082F63B7, 0xFA44E0B4,
+	0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+	0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B,
+	0xB4091BFF, 0x466298FC, 0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
+	0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033, 0xA24BB5A6, 0x502036A5,
+	0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+	0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975,
+	0x0E330A81, 0xFC588982, 0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
+	0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622, 0x38CC2A06, 0xCAA7A905,
+	0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+	0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8,
+	0xE52CC12C, 0x1747422F, 0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
+	0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0, 0xD3D3E1AB, 0x21B862A8,
+	0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+	0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78,
+	0x7FAB5E8C, 0x8DC0DD8F, 0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
+	0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1, 0x69E9F0D5, 0x9B8273D6,
+	0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+	0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69,
+	0xD5CF889D, 0x27A40B9E, 0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
+	0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351
+};
+
+static const uint32_t kSha256K[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static uint32_t crc32c_table(uint32_t crc, const uint8_t *data, size_t len)
+{
+	while (len-- > 0)
+		crc = (crc >> 8) ^ kCrc32cTable[(crc ^ *data++) & 0xff];
+
+	return crc;
+}
+
+#ifdef DIGEST_CRC_SSE42
+//crc32c_table, 8 bytes per instruction
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *data, size_t len)
+{
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+	uint64_t v;
+
+	for (; len >= 8; len -= 8, data += 8)
+	{
+		memcpy(&v, data, 8);
+		crc64 = _mm_crc32_u64(crc64, v);
+	}
+
+	crc = (uint32_t)crc64;
+#else
+	uint32_t v;
+
+	for (; len >= 4; len -= 4, data += 4)
+	{
+		memcpy(&v, data, 4);
+		crc = _mm_crc32_u32(crc, v);
+	}
+#endif
+
+	for (; len > 0; len--)
+		crc = _mm_crc32_u8(crc, *data++);
+
+	return crc;
+}
+#endif
+
+#ifdef DIGEST_CRC_ARM
+//crc32c_table, 8 bytes per instruction
+static uint32_t crc32c_arm(uint32_t crc, const uint8_t *data, size_t len)
+{
+	uint64_t v;
+
+	for (; len >= 8; len -= 8, data += 8)
+	{
+		memcpy(&v, data, 8);
+		crc = __crc32cd(crc, v);
+	}
+
+	for (; len > 0; len--)
+		crc = __crc32cb(crc, *data++);
+
+	return crc;
+}
+#endif
+
+static uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+#if defined(DIGEST_CRC_SSE42)
+	if (__builtin_cpu_supports("sse4.2"))
+		return crc32c_sse42(crc, data, len);
+#elif defined(DIGEST_CRC_ARM)
+	return crc32c_arm(crc, data, len);
+#endif
+
+	return crc32c_table(crc, data, len);
+}
+
+#define ROR32(x, n)		(((x) >> (n)) | ((x) << (32 - (n))))
+
+//hashes one 64 byte block (FIPS 180-4)
+static void sha256_block(uint32_t *h, const uint8_t *p)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, k, t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = ((uint32_t)p[4*i] << 24) | ((uint32_t)p[4*i+1] << 16) | ((uint32_t)p[4*i+2] << 8) | p[4*i+3];
+
+	for (i = 16; i < 64; i++)
+	{
+		t1 = ROR32(w[i-2], 17) ^ ROR32(w[i-2], 19) ^ (w[i-2] >> 10);
+		t2 = ROR32(w[i-15], 7) ^ ROR32(w[i-15], 18) ^ (w[i-15] >> 3);
+		w[i] = w[i-16] + t2 + w[i-7] + t1;
+	}
+
+	a = h[0]; b = h[1]; c = h[2]; d = h[3];
+	e = h[4]; f = h[5]; g = h[6]; k = h[7];
+
+	for (i = 0; i < 64; i++)
+	{
+		t1 = k + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + kSha256K[i] + w[i];
+		t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		k = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+	h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+int DigestAlg(const char *name)
+{
+	if (strcasecmp(name, "crc32c") == 0)
+		return DIGEST_CRC32C;
+
+	if (strcasecmp(name, "sha256") == 0)
+		return DIGEST_SHA256;
+
+	return DIGEST_NONE;
+}
+
+const char *DigestName(int alg)
+{
+	switch (alg)
+	{
+		case DIGEST_CRC32C: return "crc32c";
+		case DIGEST_SHA256: return "sha256";
+		default: return NULL;
+	}
+}
+
+size_t DigestLen(int alg)
+{
+	switch (alg)
+	{
+		case DIGEST_CRC32C: return 4;
+		case DIGEST_SHA256: return 32;
+		default: return 0;
+	}
+}
+
+void DigestInit(digest_t *d, int alg)
+{
+	static const uint32_t kSha256Init[8] =
+	{
+		0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+	};
+
+	memset(d, 0, sizeof(*d));
+	d->alg = alg;
+	d->crc = 0xFFFFFFFF;
+	memcpy(d->h, kSha256Init, sizeof(d->h));
+}
+
+void DigestUpdate(digest_t *d, const uint8_t *data, size_t len)
+{
+	size_t used, n;
+
+	switch (d->alg)
+	{
+	case DIGEST_CRC32C:
+		d->crc = crc32c_update(d->crc, data, len);
+		break;
+
+	case DIGEST_SHA256:
+		used = (size_t)(d->len & 63);
+
+		//a block started by the last update is completed first
+		if (used > 0)
+		{
+			n = 64 - used;
+
+			if (n > len)
+				n = len;
+
+			memcpy(&d->block[used], data, n);
+			d->len += n;
+			data += n;
+			len -= n;
+
+			if (used + n < 64)
+				break;
+
+			sha256_block(d->h, d->block);
+		}
+
+		//whole blocks are hashed where they are
+		for (; len >= 64; len -= 64, data += 64)
+		{
+			sha256_block(d->h, data);
+			d->len += 64;
+		}
+
+		memcpy(d->block, data, len);
+		d->len += len;
+		break;
+
+	default:
+		break;
+	}
+}
+
+size_t DigestFinal(digest_t *d, uint8_t *out)
+{
+	uint64_t bits = d->len * 8;
+	size_t used;
+	int i;
+
+	switch (d->alg)
+	{
+	case DIGEST_CRC32C:
+		d->crc ^= 0xFFFFFFFF;
+
+		for (i = 0; i < 4; i++)
+			out[i] = (uint8_t)(d->crc >> (24 - 8 * i));
+
+		return 4;
+
+	case DIGEST_SHA256:
+		//padding: 0x80, zeros, the length in bits as the last 8 bytes of a block
+		used = (size_t)(d->len & 63);
+		d->block[used++] = 0x80;
+
+		if (used > 56)
+		{
+			memset(&d->block[used], 0, 64 - used);
+			sha256_block(d->h, d->block);
+			used = 0;
+		}
+
+		memset(&d->block[used], 0, 56 - used);
+
+		for (i = 0; i < 8; i++)
+			d->block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+
+		sha256_block(d->h, d->block);
+
+		for (i = 0; i < 32; i++)
+			out[i] = (uint8_t)(d->h[i / 4] >> (24 - 8 * (i % 4)));
+
+		return 32;
+
+	default:
+		return 0;
+	}
+}
+
+void DigestHex(const uint8_t *digest, size_t len, char *hex)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		sprintf(&hex[2 * i], "%02x", digest[i]);
+
+	hex[2 * len] = '\0';
+}
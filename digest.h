@@ -0,0 +1,62 @@
+//
+//Checksums of transferred data, computed block by block as the data is sent or received
+//CRC32C uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them, SHA-256 is computed in software
+//
+#ifndef _DIGEST_H
+#define _DIGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#define DIGEST_MAX_LEN		32		//bytes of the longest digest (SHA-256)
+
+typedef enum
+{
+	DIGEST_NONE = 0,
+	DIGEST_CRC32C,			//4 bytes, big endian
+	DIGEST_SHA256,			//32 bytes
+} digest_alg_t;
+
+typedef struct
+{
+	int alg;				//digest_alg_t
+	uint32_t crc;			//CRC32C, inverted
+	uint32_t h[8];			//SHA-256 state
+	uint8_t block[64];		//SHA-256 input not hashed yet
+	uint64_t len;			//bytes hashed
+} digest_t;
+
+// algorithm named name (crc32c, sha256), case is ignored
+// returns digest_alg_t, DIGEST_NONE if unknown
+extern int DigestAlg(const char *name);
+
+// name of an algorithm, NULL for DIGEST_NONE
+extern const char *DigestName(int alg);
+
+// length of the digest of an algorithm, 0 for DIGEST_NONE
+extern size_t DigestLen(int alg);
+
+/* starts a digest, DIGEST_NONE makes the updates no-ops */
+extern void DigestInit(digest_t *d, int alg);
+
+/* adds data to the digest */
+extern void DigestUpdate(digest_t *d, const uint8_t *data, size_t len);
+
+// completes the digest, d is not updated any more
+// out - DIGEST_MAX_LEN bytes
+// returns length of the digest
+extern size_t DigestFinal(digest_t *d, uint8_t *out);
+
+// formats a digest as lower case hex
+// hex - 2 * DIGEST_MAX_LEN + 1 bytes
+extern void DigestHex(const uint8_t *digest, size_t len, char *hex);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _DIGEST_H
@@ -0,0 +1,189 @@
+//
+//Event loop, waits for sockets to become readable
+//epoll on Linux, select() elsewhere
+//
+
+#include "evloop.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+	#include <errno.h>
+	#include <unistd.h>
+	#include <sys/epoll.h>
+#elif !defined(_WIN32)
+	#include <sys/select.h>
+#endif
+
+#ifdef __linux__
+
+int EvLoopCreate(ev_loop_t *ev)
+{
+	ev->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (ev->epfd < 0)
+	{
+		printf("epoll_create1 failed (%s)\n", strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+int EvLoopAdd(ev_loop_t *ev, SOCKET sock, void *ptr)
+{
+	struct epoll_event e;
+
+	memset(&e, 0, sizeof(e));
+	e.events = EPOLLIN;
+	e.data.ptr = ptr;
+
+	if (epoll_ctl(ev->epfd, EPOLL_CTL_ADD, sock, &e) < 0)
+	{
+		printf("epoll_ctl failed (%s)\n", strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+void EvLoopDel(ev_loop_t *ev, SOCKET sock)
+{
+	epoll_ctl(ev->epfd, EPOLL_CTL_DEL, sock, NULL);
+}
+
+int EvLoopWait(ev_loop_t *ev, ev_event_t *events, int maxEvents, int timeout_ms)
+{
+	struct epoll_event e[EV_MAX_EVENTS];
+	int i, n;
+
+	if (maxEvents > EV_MAX_EVENTS)
+		maxEvents = EV_MAX_EVENTS;
+
+	n = epoll_wait(ev->epfd, e, maxEvents, timeout_ms);
+
+	// EINTR: a signal arrived, let the caller check for it
+	if (n < 0)
+		return 0;
+
+	for (i = 0; i < n; i++)
+		events[i].ptr = e[i].data.ptr;
+
+	return n;
+}
+
+void EvLoopDestroy(ev_loop_t *ev)
+{
+	if (ev->epfd >= 0)
+		close(ev->epfd);
+
+	ev->epfd = -1;
+}
+
+#else
+
+int EvLoopCreate(ev_loop_t *ev)
+{
+	memset(ev, 0, sizeof(*ev));
+	return 1;
+}
+
+int EvLoopAdd(ev_loop_t *ev, SOCKET sock, void *ptr)
+{
+	SOCKET *socks;
+	void **ptrs;
+	int max;
+
+	// select() can only watch FD_SETSIZE sockets
+	if (ev->numSocks >= FD_SETSIZE)
+		return 0;
+
+	if (ev->numSocks == ev->maxSocks)
+	{
+		max = (ev->maxSocks) ? (ev->maxSocks * 2) : 16;
+
+		socks = realloc(ev->socks, max * sizeof(SOCKET));
+
+		if (socks == NULL)
+			return 0;
+
+		ev->socks = socks;
+
+		ptrs = realloc(ev->ptrs, max * sizeof(void *));
+
+		if (ptrs == NULL)
+			return 0;
+
+		ev->ptrs = ptrs;
+		ev->maxSocks = max;
+	}
+
+	ev->socks[ev->numSocks] = sock;
+	ev->ptrs[ev->numSocks] = ptr;
+	ev->numSocks++;
+
+	return 1;
+}
+
+void EvLoopDel(ev_loop_t *ev, SOCKET sock)
+{
+	int i;
+
+	for (i = 0; i < ev->numSocks; i++)
+	{
+		if (ev->socks[i] == sock)
+		{
+			ev->numSocks--;
+			ev->socks[i] = ev->socks[ev->numSocks];
+			ev->ptrs[i] = ev->ptrs[ev->numSocks];
+			return;
+		}
+	}
+}
+
+int EvLoopWait(ev_loop_t *ev, ev_event_t *events, int maxEvents, int timeout_ms)
+{
+	fd_set readfds;
+	struct timeval tv;
+	SOCKET maxSock = 0;
+	int i, n, ret;
+
+	FD_ZERO(&readfds);
+
+	for (i = 0; i < ev->numSocks; i++)
+	{
+		FD_SET(ev->socks[i], &readfds);
+
+		if (ev->socks[i] > maxSock)
+			maxSock = ev->socks[i];
+	}
+
+	// select() may modify the timeout, set it up on every call
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	ret = select((int)maxSock + 1, &readfds, NULL, NULL, (timeout_ms < 0) ? NULL : &tv);
+
+	if (ret <= 0)
+		return 0;
+
+	n = 0;
+
+	for (i = 0; (i < ev->numSocks) && (n < maxEvents); i++)
+	{
+		if (FD_ISSET(ev->socks[i], &readfds))
+			events[n++].ptr = ev->ptrs[i];
+	}
+
+	return n;
+}
+
+void EvLoopDestroy(ev_loop_t *ev)
+{
+	free(ev->socks);
+	free(ev->ptrs);
+	memset(ev, 0, sizeof(*ev));
+}
+
+#endif
@@ -0,0 +1,58 @@
+//
+//Event loop, waits for sockets to become readable
+//epoll on Linux, select() elsewhere
+//
+#ifndef _EVLOOP_H
+#define _EVLOOP_H
+
+#ifdef _WIN32
+	#include <winsock2.h>
+#else
+	typedef int SOCKET;
+	#define INVALID_SOCKET -1
+#endif
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#define EV_MAX_EVENTS	64		//events returned by one EvLoopWait call
+
+typedef struct
+{
+	void *ptr;			//user pointer the socket was added with
+} ev_event_t;
+
+typedef struct
+{
+#ifdef __linux__
+	int epfd;
+#else
+	SOCKET *socks;		//registered sockets and their user pointers
+	void **ptrs;
+	int numSocks;
+	int maxSocks;
+#endif
+} ev_loop_t;
+
+/* create an event loop, returns 1=success, 0=failed */
+extern int EvLoopCreate(ev_loop_t *ev);
+
+/* watch a socket for read events, returns 1=success, 0=failed */
+extern int EvLoopAdd(ev_loop_t *ev, SOCKET sock, void *ptr);
+
+/* stop watching a socket, call before closing it */
+extern void EvLoopDel(ev_loop_t *ev, SOCKET sock);
+
+// wait until a socket is readable or the timeout expires
+// timeout_ms: -1 = wait forever
+// returns number of events filled in, 0 = timeout or interrupted
+extern int EvLoopWait(ev_loop_t *ev, ev_event_t *events, int maxEvents, int timeout_ms);
+
+extern void EvLoopDestroy(ev_loop_t *ev);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _EVLOOP_H
@@ -0,0 +1,339 @@
+//
+//Network impairment simulator, datagrams of one direction of a link pass through a delay line
+//with loss (random or Gilbert-Elliott bursts), delay, jitter, reordering, duplication and a rate limit,
+//all random decisions come from a seeded generator so runs are reproducible
+//
+
+#include "impair.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//next random number, xorshift64*
+static uint64_t impair_rand(impair_t *im)
+{
+	im->rng ^= im->rng >> 12;
+	im->rng ^= im->rng << 25;
+	im->rng ^= im->rng >> 27;
+
+	return im->rng * 0x2545F4914F6CDD1DULL;
+}
+
+//returns 1 with probability p
+static int impair_chance(impair_t *im, double p)
+{
+	if (p <= 0.0)
+		return 0;
+
+	//53 random bits, uniform in [0, 1)
+	return ((double)(impair_rand(im) >> 11) / 9007199254740992.0) < p;
+}
+
+//parses a probability, a fraction or a percentage
+// returns 1=success, 0=invalid or out of 0..1
+static int impair_parse_prob(const char *s, char **end, double *p)
+{
+	*p = strtod(s, end);
+
+	if (*end == s)
+		return 0;
+
+	if (**end == '%')
+	{
+		*p /= 100.0;
+		(*end)++;
+	}
+
+	return (*p >= 0.0) && (*p <= 1.0);
+}
+
+//parses an unsigned number with an optional K/M/G (x1000) suffix
+// returns 1=success, 0=invalid
+static int impair_parse_num(const char *s, char **end, uint64_t *n)
+{
+	if ((*s < '0') || (*s > '9'))
+		return 0;
+
+	*n = strtoull(s, end, 10);
+
+	switch (**end)
+	{
+		case 'k': case 'K': *n *= 1000ULL; (*end)++; break;
+		case 'm': case 'M': *n *= 1000000ULL; (*end)++; break;
+		case 'g': case 'G': *n *= 1000000000ULL; (*end)++; break;
+		default: break;
+	}
+
+	return 1;
+}
+
+int ImpairParse(impair_config_t *cfg, const char *spec)
+{
+	const char *s = spec;
+	char *end;
+	uint64_t n;
+	int ok;
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->geLossBad = 1.0;
+	cfg->limit = IMPAIR_DEF_LIMIT;
+	cfg->seed = 1;
+
+	while (*s != '\0')
+	{
+		const char *eq = strchr(s, '=');
+		size_t nameLen;
+
+		if (eq == NULL)
+			return 0;
+
+		nameLen = (size_t)(eq - s);
+		end = (char *)eq + 1;
+		ok = 0;
+
+		#define IMPAIR_NAME(name)	((nameLen == strlen(name)) && (strncmp(s, name, nameLen) == 0))
+
+		if (IMPAIR_NAME("loss"))
+		{
+			ok = impair_parse_prob(eq + 1, &end, &cfg->loss);
+		}
+		else if (IMPAIR_NAME("ge"))
+		{
+			ok = impair_parse_prob(eq + 1, &end, &cfg->geP) && (*end == ':') &&
+				impair_parse_prob(end + 1, &end, &cfg->geR);
+
+			if (ok && (*end == ':'))
+				ok = impair_parse_prob(end + 1, &end, &cfg->geLossBad);
+
+			if (ok && (*end == ':'))
+				ok = impair_parse_prob(end + 1, &end, &cfg->geLossGood);
+		}
+		else if (IMPAIR_NAME("delay") || IMPAIR_NAME("jitter") || IMPAIR_NAME("limit"))
+		{
+			ok = impair_parse_num(eq + 1, &end, &n) && (n <= UINT32_MAX);
+
+			if (IMPAIR_NAME("delay"))
+				cfg->delayMs = (uint32_t)n;
+			else if (IMPAIR_NAME("jitter"))
+				cfg->jitterMs = (uint32_t)n;
+			else
+				cfg->limit = (uint32_t)n;
+		}
+		else if (IMPAIR_NAME("reorder"))
+		{
+			ok = impair_parse_prob(eq + 1, &end, &cfg->reorder);
+		}
+		else if (IMPAIR_NAME("dup"))
+		{
+			ok = impair_parse_prob(eq + 1, &end, &cfg->duplicate);
+		}
+		else if (IMPAIR_NAME("rate"))
+		{
+			ok = impair_parse_num(eq + 1, &end, &cfg->rate);
+		}
+		else if (IMPAIR_NAME("seed"))
+		{
+			ok = impair_parse_num(eq + 1, &end, &cfg->seed);
+		}
+
+		#undef IMPAIR_NAME
+
+		if (!ok || ((*end != ',') && (*end != '\0')))
+			return 0;
+
+		s = (*end == ',') ? end + 1 : end;
+	}
+
+	return 1;
+}
+
+void ImpairInit(impair_t *im, const impair_config_t *cfg, uint32_t stream)
+{
+	memset(im, 0, sizeof(*im));
+	im->cfg = *cfg;
+
+	//splitmix64 of seed and stream, xorshift needs a non zero state
+	im->rng = cfg->seed + 0x9E3779B97F4A7C15ULL * ((uint64_t)stream + 1);
+	im->rng = (im->rng ^ (im->rng >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	im->rng = (im->rng ^ (im->rng >> 27)) * 0x94D049BB133111EBULL;
+	im->rng ^= im->rng >> 31;
+
+	if (im->rng == 0)
+		im->rng = 1;
+}
+
+//inserts a packet into the queue ordered by release time, packets due at the same time keep their order
+static void impair_enqueue(impair_t *im, impair_pkt_t *pkt)
+{
+	impair_pkt_t **pp;
+
+	if ((im->tail == NULL) || (im->tail->releaseUs <= pkt->releaseUs))
+	{
+		pkt->next = NULL;
+
+		if (im->tail != NULL)
+			im->tail->next = pkt;
+		else
+			im->head = pkt;
+
+		im->tail = pkt;
+	}
+	else
+	{
+		for (pp = &im->head; (*pp)->releaseUs <= pkt->releaseUs; pp = &(*pp)->next)
+			;
+
+		pkt->next = *pp;
+		*pp = pkt;
+	}
+
+	im->count++;
+}
+
+//queues one copy of a packet
+// returns 1=queued, 0=queue full or out of memory
+static int impair_queue_copy(impair_t *im, const uint8_t *data, size_t len, uint32_t tag, uint64_t nowUs)
+{
+	impair_pkt_t *pkt;
+	uint64_t releaseUs;
+	int64_t jitterUs;
+
+	if (im->count >= im->cfg.limit)
+		return 0;
+
+	pkt = (impair_pkt_t *)malloc(sizeof(*pkt) + len);
+
+	if (pkt == NULL)
+		return 0;
+
+	//the rate limited link sends one packet after the other
+	if (im->linkFreeUs < nowUs)
+		im->linkFreeUs = nowUs;
+
+	if (im->cfg.rate > 0)
+		im->linkFreeUs += ((uint64_t)len * 1000000ULL) / im->cfg.rate;
+
+	releaseUs = im->linkFreeUs;
+
+	//a reordered packet skips the delay and overtakes the packets delayed before it
+	if ((im->cfg.reorder > 0.0) && impair_chance(im, im->cfg.reorder))
+	{
+		im->numReordered++;
+	}
+	else
+	{
+		releaseUs += (uint64_t)im->cfg.delayMs * 1000;
+
+		if (im->cfg.jitterMs > 0)
+		{
+			jitterUs = (int64_t)(impair_rand(im) % (2ULL * im->cfg.jitterMs * 1000 + 1)) - (int64_t)im->cfg.jitterMs * 1000;
+
+			if ((jitterUs < 0) && ((uint64_t)(-jitterUs) > releaseUs - nowUs))
+				releaseUs = nowUs;
+			else
+				releaseUs = (uint64_t)((int64_t)releaseUs + jitterUs);
+		}
+	}
+
+	pkt->releaseUs = releaseUs;
+	pkt->tag = tag;
+	pkt->len = len;
+	memcpy(pkt->data, data, len);
+
+	impair_enqueue(im, pkt);
+	return 1;
+}
+
+int ImpairSubmit(impair_t *im, const uint8_t *data, size_t len, uint32_t tag, uint64_t nowUs)
+{
+	int isLost = 0;
+	int n;
+
+	im->numSubmitted++;
+
+	//Gilbert-Elliott: the state moves once per packet, losses come in bursts while it is bad
+	if (im->cfg.geP > 0.0)
+	{
+		if (im->isBad)
+			im->isBad = !impair_chance(im, im->cfg.geR);
+		else
+			im->isBad = impair_chance(im, im->cfg.geP);
+
+		isLost = impair_chance(im, im->isBad ? im->cfg.geLossBad : im->cfg.geLossGood);
+	}
+
+	if ((!isLost) && (im->cfg.loss > 0.0))
+		isLost = impair_chance(im, im->cfg.loss);
+
+	if (isLost)
+	{
+		im->numDropped++;
+		return 0;
+	}
+
+	n = impair_queue_copy(im, data, len, tag, nowUs);
+
+	if (n == 0)
+	{
+		im->numDropped++;
+		return 0;
+	}
+
+	if ((im->cfg.duplicate > 0.0) && impair_chance(im, im->cfg.duplicate) &&
+		impair_queue_copy(im, data, len, tag, nowUs))
+	{
+		im->numDuplicated++;
+		n++;
+	}
+
+	return n;
+}
+
+int ImpairTake(impair_t *im, uint64_t nowUs, uint8_t *buf, size_t size, uint32_t *tag)
+{
+	impair_pkt_t *pkt = im->head;
+	size_t len;
+
+	if ((pkt == NULL) || (pkt->releaseUs > nowUs))
+		return -1;
+
+	im->head = pkt->next;
+
+	if (im->head == NULL)
+		im->tail = NULL;
+
+	im->count--;
+
+	len = (pkt->len < size) ? pkt->len : size;
+	memcpy(buf, pkt->data, len);
+	*tag = pkt->tag;
+
+	free(pkt);
+	return (int)len;
+}
+
+uint32_t ImpairNextMs(impair_t *im, uint64_t nowUs)
+{
+	if (im->head == NULL)
+		return UINT32_MAX;
+
+	if (im->head->releaseUs <= nowUs)
+		return 0;
+
+	return (uint32_t)((im->head->releaseUs - nowUs + 999) / 1000);
+}
+
+void ImpairFree(impair_t *im)
+{
+	impair_pkt_t *pkt;
+
+	while (im->head != NULL)
+	{
+		pkt = im->head;
+		im->head = pkt->next;
+		free(pkt);
+	}
+
+	im->tail = NULL;
+	im->count = 0;
+}
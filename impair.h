@@ -0,0 +1,89 @@
+//
+//Network impairment simulator, datagrams of one direction of a link pass through a delay line
+//with loss (random or Gilbert-Elliott bursts), delay, jitter, reordering, duplication and a rate limit,
+//all random decisions come from a seeded generator so runs are reproducible
+//
+#ifndef _IMPAIR_H
+#define _IMPAIR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#define IMPAIR_DEF_LIMIT	1000	//packets queued per direction, further packets are dropped (netem default)
+
+typedef struct
+{
+	double loss;			//random loss probability
+	double geP;				//Gilbert-Elliott: good -> bad transition probability, 0 = model off
+	double geR;				//Gilbert-Elliott: bad -> good transition probability
+	double geLossBad;		//loss probability in the bad state
+	double geLossGood;		//loss probability in the good state
+	uint32_t delayMs;		//added one way delay
+	uint32_t jitterMs;		//delay varies uniformly by +-jitterMs
+	double reorder;			//probability a packet skips the delay and overtakes the queue
+	double duplicate;		//probability a packet is delivered twice
+	uint64_t rate;			//bytes per second, 0 = unlimited
+	uint32_t limit;			//packets queued at most
+	uint64_t seed;
+} impair_config_t;
+
+typedef struct impair_pkt_s
+{
+	struct impair_pkt_s *next;
+	uint64_t releaseUs;		//time the packet leaves the delay line
+	uint32_t tag;			//caller data, e.g. the destination
+	size_t len;
+	uint8_t data[];
+} impair_pkt_t;
+
+typedef struct
+{
+	impair_config_t cfg;
+	uint64_t rng;			//xorshift64* state
+	int isBad;				//Gilbert-Elliott state
+	uint64_t linkFreeUs;	//the rate limited link has sent everything queued before this time
+
+	impair_pkt_t *head;		//queue ordered by release time
+	impair_pkt_t *tail;
+	uint32_t count;
+
+	uint64_t numSubmitted;
+	uint64_t numDropped;	//lost or queue full
+	uint64_t numDuplicated;
+	uint64_t numReordered;
+} impair_t;
+
+// parses a comma separated list of <name>=<value>:
+// loss=P, ge=P:R[:LOSSBAD[:LOSSGOOD]], delay=MS, jitter=MS, reorder=P, dup=P, rate=BYTES/S[K|M|G], limit=N, seed=N
+// probabilities are fractions or percentages (0.01 or 1%)
+// returns 1=success, 0=invalid spec
+extern int ImpairParse(impair_config_t *cfg, const char *spec);
+
+// sets up one direction, stream gives the directions of a link different random sequences from one seed
+extern void ImpairInit(impair_t *im, const impair_config_t *cfg, uint32_t stream);
+
+// passes a packet into the delay line
+// tag - returned with the packet by ImpairTake
+// returns number of copies queued: 0=dropped, 1, 2=duplicated
+extern int ImpairSubmit(impair_t *im, const uint8_t *data, size_t len, uint32_t tag, uint64_t nowUs);
+
+// takes the next packet that is due, copies it to buf (truncated to size)
+// returns packet length or -1 if no packet is due
+extern int ImpairTake(impair_t *im, uint64_t nowUs, uint8_t *buf, size_t size, uint32_t *tag);
+
+// milliseconds until the next packet is due, for the event loop timeout
+// returns 0=due now, UINT32_MAX=queue empty
+extern uint32_t ImpairNextMs(impair_t *im, uint64_t nowUs);
+
+/* frees the packets still queued */
+extern void ImpairFree(impair_t *im);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _IMPAIR_H
@@ -0,0 +1,423 @@
+//
+//Disk I/O thread pool, file reads and writes run off the network loop
+//jobs and their completions travel through lock-free MPSC queues
+//
+
+#define _FILE_OFFSET_BITS 64	//64 bit off_t for files over 2 GB on 32 bit builds
+
+#ifdef __linux__
+	#define _GNU_SOURCE
+#endif
+
+#include "iopool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <sched.h>
+	#include <unistd.h>
+#endif
+
+#ifdef __linux__
+	#include <sys/eventfd.h>
+#endif
+
+#ifndef _WIN32
+	#define IO_LOAD(p)			atomic_load_explicit(p, memory_order_acquire)
+	#define IO_STORE(p, v)		atomic_store_explicit(p, v, memory_order_release)
+	#define IO_XCHG(p, v)		atomic_exchange_explicit(p, v, memory_order_acq_rel)
+#else
+	#define IO_LOAD(p)			(*(p))
+	#define IO_STORE(p, v)		(*(p) = (v))
+	static void *io_xchg(void *p, void *v) { void *old = *(void **)p; *(void **)p = v; return old; }
+	#define IO_XCHG(p, v)		io_xchg((void *)(p), (void *)(v))
+#endif
+
+static void io_queue_init(io_queue_t *q)
+{
+	IO_STORE(&q->stub.next, NULL);
+	IO_STORE(&q->head, &q->stub);
+	q->tail = &q->stub;
+}
+
+//any thread
+static void io_queue_push(io_queue_t *q, io_job_t *job)
+{
+	io_job_t *prev;
+
+	IO_STORE(&job->next, NULL);
+	prev = IO_XCHG(&q->head, job);
+	IO_STORE(&prev->next, job);
+}
+
+//consumer thread only
+// returns oldest job, NULL if the queue is empty or a push is still linking its job in
+static io_job_t *io_queue_pop(io_queue_t *q)
+{
+	io_job_t *tail = q->tail;
+	io_job_t *next = IO_LOAD(&tail->next);
+
+	if (tail == &q->stub)
+	{
+		if (next == NULL)
+			return NULL;
+
+		q->tail = next;
+		tail = next;
+		next = IO_LOAD(&next->next);
+	}
+
+	if (next != NULL)
+	{
+		q->tail = next;
+		return tail;
+	}
+
+	if (tail != IO_LOAD(&q->head))
+		return NULL;
+
+	//last job, the stub keeps the queue non-empty while it is taken
+	io_queue_push(q, &q->stub);
+	next = IO_LOAD(&tail->next);
+
+	if (next != NULL)
+	{
+		q->tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+void IoJobRun(io_job_t *job)
+{
+	if (job->op == IO_OP_CALL)
+	{
+		job->fn(job);
+	}
+	else if (job->op == IO_OP_READ)
+	{
+		//a short read is the end of the file unless the stream has an error
+		job->result = fread(job->buf, 1, job->len, job->pFile);
+		job->isError = (job->result < job->len) && ferror(job->pFile);
+	}
+	else
+	{
+	#ifdef _WIN32
+		_fseeki64(job->pFile, (__int64)job->offset, SEEK_SET);
+		job->result = fwrite(job->buf, 1, job->len, job->pFile);
+	#else
+		ssize_t rc;
+
+		//positioned, straight to the file descriptor (O_DIRECT chunks bypass the stream buffer)
+		job->result = 0;
+
+		while (job->result < job->len)
+		{
+			rc = pwrite(fileno(job->pFile), &job->buf[job->result], job->len - job->result, (off_t)(job->offset + job->result));
+
+			if ((rc < 0) && (errno == EINTR))
+				continue;
+
+			if (rc <= 0)
+				break;
+
+			job->result += (size_t)rc;
+		}
+	#endif
+
+		job->isError = (job->result != job->len);
+	}
+}
+
+//posts a completed job to the network loop that submitted it
+static void io_post_done(io_job_t *job)
+{
+	io_done_t *d = job->done;
+
+	io_queue_push(&d->q, job);
+
+#ifndef _WIN32
+	if ((d->fd != INVALID_SOCKET) && !IO_XCHG(&d->isSignaled, 1))
+	{
+		#ifdef __linux__
+			uint64_t one = 1;
+
+			if (write(d->fd, &one, sizeof(one)) < 0)
+				return;
+		#else
+			uint8_t one = 1;
+
+			if (write(d->wfd, &one, sizeof(one)) < 0)
+				return;
+		#endif
+	}
+#endif
+}
+
+#ifndef _WIN32
+
+typedef struct io_thread_s
+{
+	pthread_t tid;
+	io_queue_t q;
+	atomic_int pending;			//jobs queued or running, the thread sleeps when 0
+	atomic_int stop;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} io_thread_t;
+
+static void *io_thread_main(void *arg)
+{
+	io_thread_t *t = (io_thread_t *)arg;
+	io_done_t *d;
+	io_job_t *job;
+
+	for (;;)
+	{
+		job = io_queue_pop(&t->q);
+
+		if (job != NULL)
+		{
+			//a job without a done queue may be freed by the call it runs
+			d = job->done;
+			IoJobRun(job);
+			atomic_fetch_sub(&t->pending, 1);
+
+			if (d != NULL)
+				io_post_done(job);
+
+			continue;
+		}
+
+		//a producer counted its job but is still linking it in
+		if (atomic_load(&t->pending) > 0)
+		{
+			sched_yield();
+			continue;
+		}
+
+		pthread_mutex_lock(&t->lock);
+
+		while ((atomic_load(&t->pending) == 0) && !atomic_load(&t->stop))
+			pthread_cond_wait(&t->cond, &t->lock);
+
+		pthread_mutex_unlock(&t->lock);
+
+		if ((atomic_load(&t->pending) == 0) && atomic_load(&t->stop))
+			break;
+	}
+
+	return NULL;
+}
+
+#endif
+
+int IoPoolCreate(io_pool_t *p, int numThreads)
+{
+	memset(p, 0, sizeof(*p));
+
+#ifndef _WIN32
+	int i;
+
+	if (numThreads > IO_MAX_THREADS)
+		numThreads = IO_MAX_THREADS;
+
+	if (numThreads <= 0)
+		return 1;
+
+	p->threads = calloc((size_t)numThreads, sizeof(io_thread_t));
+
+	if (p->threads == NULL)
+		return 0;
+
+	for (i = 0; i < numThreads; i++)
+	{
+		io_thread_t *t = &p->threads[i];
+
+		io_queue_init(&t->q);
+		pthread_mutex_init(&t->lock, NULL);
+		pthread_cond_init(&t->cond, NULL);
+
+		if (pthread_create(&t->tid, NULL, io_thread_main, t) != 0)
+		{
+			printf("failed to start I/O thread %d\n", i);
+			pthread_mutex_destroy(&t->lock);
+			pthread_cond_destroy(&t->cond);
+			break;
+		}
+
+		p->numThreads++;
+	}
+
+	if (p->numThreads == 0)
+	{
+		free(p->threads);
+		p->threads = NULL;
+	}
+#else
+	(void)numThreads;
+#endif
+
+	return 1;
+}
+
+void IoPoolSubmit(io_pool_t *p, io_job_t *job, unsigned affinity)
+{
+	io_done_t *d;
+
+#ifndef _WIN32
+	if (p->numThreads > 0)
+	{
+		io_thread_t *t = &p->threads[affinity % (unsigned)p->numThreads];
+
+		//counted before it is linked in, the thread only sleeps once it has seen 0
+		if (atomic_fetch_add(&t->pending, 1) == 0)
+		{
+			io_queue_push(&t->q, job);
+
+			pthread_mutex_lock(&t->lock);
+			pthread_cond_signal(&t->cond);
+			pthread_mutex_unlock(&t->lock);
+		}
+		else
+		{
+			io_queue_push(&t->q, job);
+		}
+
+		return;
+	}
+#endif
+
+	(void)affinity;
+
+	d = job->done;
+	IoJobRun(job);
+
+	if (d != NULL)
+		io_post_done(job);
+}
+
+void IoPoolDestroy(io_pool_t *p)
+{
+#ifndef _WIN32
+	int i;
+
+	for (i = 0; i < p->numThreads; i++)
+	{
+		io_thread_t *t = &p->threads[i];
+
+		pthread_mutex_lock(&t->lock);
+		atomic_store(&t->stop, 1);
+		pthread_cond_signal(&t->cond);
+		pthread_mutex_unlock(&t->lock);
+
+		pthread_join(t->tid, NULL);
+		pthread_mutex_destroy(&t->lock);
+		pthread_cond_destroy(&t->cond);
+	}
+
+	free(p->threads);
+	p->threads = NULL;
+#endif
+
+	p->numThreads = 0;
+}
+
+int IoDoneInit(io_done_t *d, const io_pool_t *p)
+{
+	memset(d, 0, sizeof(*d));
+	io_queue_init(&d->q);
+
+	d->fd = INVALID_SOCKET;
+	d->wfd = INVALID_SOCKET;
+
+	//completions run inline are drained by the loop itself
+	if (p->numThreads == 0)
+		return 1;
+
+#ifdef __linux__
+	d->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (d->fd < 0)
+	{
+		printf("eventfd failed (%s)\n", strerror(errno));
+		d->fd = INVALID_SOCKET;
+		return 0;
+	}
+#elif !defined(_WIN32)
+	int fds[2];
+
+	if (pipe(fds) < 0)
+	{
+		printf("pipe failed (%s)\n", strerror(errno));
+		return 0;
+	}
+
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	d->fd = fds[0];
+	d->wfd = fds[1];
+#endif
+
+	return 1;
+}
+
+io_job_t *IoDonePop(io_done_t *d)
+{
+	return io_queue_pop(&d->q);
+}
+
+void IoDoneAck(io_done_t *d)
+{
+#ifndef _WIN32
+	uint8_t buf[64];
+
+	if (d->fd == INVALID_SOCKET)
+		return;
+
+	//eventfd returns its counter in one read, a pipe holds one byte per wakeup
+	while (read(d->fd, buf, sizeof(buf)) > 0)
+		;
+
+	IO_STORE(&d->isSignaled, 0);
+#else
+	(void)d;
+#endif
+}
+
+void IoDoneWait(io_done_t *d)
+{
+#ifndef _WIN32
+	struct pollfd pfd;
+
+	if (d->fd == INVALID_SOCKET)
+		return;
+
+	pfd.fd = d->fd;
+	pfd.events = POLLIN;
+
+	while ((poll(&pfd, 1, -1) < 0) && (errno == EINTR))
+		;
+
+	IoDoneAck(d);
+#else
+	(void)d;
+#endif
+}
+
+void IoDoneDestroy(io_done_t *d)
+{
+#ifndef _WIN32
+	if (d->fd != INVALID_SOCKET)
+		close(d->fd);
+
+	if (d->wfd != INVALID_SOCKET)
+		close(d->wfd);
+#endif
+
+	d->fd = INVALID_SOCKET;
+	d->wfd = INVALID_SOCKET;
+}
@@ -0,0 +1,111 @@
+//
+//Disk I/O thread pool, file reads and writes run off the network loop
+//jobs and their completions travel through lock-free MPSC queues
+//
+#ifndef _IOPOOL_H
+#define _IOPOOL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "evloop.h"
+
+#ifndef _WIN32
+	#include <pthread.h>
+	#include <stdatomic.h>
+	#define IO_ATOMIC(t)	_Atomic(t)
+#else
+	#define IO_ATOMIC(t)	t		//no pool threads, jobs run inline
+#endif
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#define IO_MAX_THREADS		64
+
+typedef enum
+{
+	IO_OP_READ,			//fread len bytes into buf
+	IO_OP_WRITE,		//write len bytes from buf at offset
+	IO_OP_CALL,			//run fn(job), a job without a done queue belongs to fn and is not posted
+} io_op_t;
+
+struct io_done_s;
+
+typedef struct io_job_s
+{
+	IO_ATOMIC(struct io_job_s *) next;	//queue link
+
+	int op;						//io_op_t
+	FILE *pFile;
+	uint8_t *buf;
+	size_t len;
+	uint64_t block;				//caller's tag, block index of a read
+	uint64_t offset;			//file offset of a write (and of a read on the ring, the threads read at the stream position)
+
+	size_t result;				//bytes transferred
+	int isError;				//ferror() was set
+
+	void *owner;				//caller's context, e.g. the session
+	void (*fn)(struct io_job_s *job);	//IO_OP_CALL
+	struct io_done_s *done;		//queue the completed job is posted to
+} io_job_t;
+
+//intrusive multi-producer single-consumer queue (Vyukov)
+typedef struct
+{
+	IO_ATOMIC(io_job_t *) head;		//producers push here
+	io_job_t *tail;					//consumer pops here
+	io_job_t stub;
+} io_queue_t;
+
+//completions of one network loop, readable wakeup fd registered in its event loop
+typedef struct io_done_s
+{
+	io_queue_t q;
+	SOCKET fd;					//eventfd (Linux) or read end of a pipe, INVALID_SOCKET without pool threads
+	SOCKET wfd;					//write end of the pipe
+	IO_ATOMIC(int) isSignaled;	//wakeup pending, saves a write per completion
+} io_done_t;
+
+typedef struct
+{
+	int numThreads;				//0 = jobs run inline in IoPoolSubmit
+#ifndef _WIN32
+	struct io_thread_s *threads;
+#endif
+} io_pool_t;
+
+/* starts numThreads I/O threads, 0 runs jobs inline, returns 1=success, 0=failed */
+extern int IoPoolCreate(io_pool_t *p, int numThreads);
+
+// queues a job, jobs with the same affinity run in submission order on the same thread
+// the job is posted to job->done once it ran
+extern void IoPoolSubmit(io_pool_t *p, io_job_t *job, unsigned affinity);
+
+/* runs a job in the calling thread, without posting it */
+extern void IoJobRun(io_job_t *job);
+
+/* runs the queued jobs and stops the threads */
+extern void IoPoolDestroy(io_pool_t *p);
+
+/* creates a completion queue, wakeup fd only if the pool has threads, returns 1=success, 0=failed */
+extern int IoDoneInit(io_done_t *d, const io_pool_t *p);
+
+// takes the next completed job, call IoDoneAck first when woken up by the fd
+// returns job or NULL if there is none
+extern io_job_t *IoDonePop(io_done_t *d);
+
+/* consumes the wakeup of the fd, completions posted afterwards signal it again */
+extern void IoDoneAck(io_done_t *d);
+
+/* blocks until the fd signals a completion and consumes the wakeup, returns at once without pool threads */
+extern void IoDoneWait(io_done_t *d);
+
+extern void IoDoneDestroy(io_done_t *d);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _IOPOOL_H
@@ -1,1914 +1,6950 @@
-//
-//TCP command line file transfer program
-//
-
-#include <stdio.h>
-#include <stdint.h>
-#include <getopt.h>
-#include <string.h>
-#include <stdlib.h>
-#include "tmr.h"
-#include <stdbool.h>
-
-#ifdef _WIN32
-	#include <windows.h>
-	#include <winsock2.h>
-	#include <ws2tcpip.h>
-#else
-	#include <fcntl.h>
-	#include <errno.h>
-	#include <signal.h>
-	#include <unistd.h>
-	#include <sys/socket.h>
-	#include <netinet/in.h>
-	#include <arpa/inet.h>
-	#include <netdb.h>
-#endif
-
-#ifndef _WIN32
-typedef int SOCKET;
-#define INVALID_SOCKET -1
-#endif
-
-#define PROT_MAX_DATA 			512
-#define MAX_TX_BUFF				600
-#define MAX_RX_BUFF				2048
-#define MAX_MODE_BUFF			12
-
-#define ACK_TIMEOUT_SECS			3
-#define SEND_DATA_TIMEOUT_SEC		3
-#define PROGRESS_TMR_SEC			3
-#define DEF_TFTP_PORT				69
-
-
-//reading packet machine states
-typedef enum
-{
-	READ_OPT_CODE_1,		//optcode low byte
-	READ_OPT_CODE_2,		//optcode high byte
-	READ_FILENAME,
-	READ_MODE,
-	READ_DATA,
-	READ_BLOCK_NUM_1,
-	READ_BLOCK_NUM_2,
-	READ_ERR_CODE_1,
-	READ_ERR_CODE_2,
-	READ_ERR_MESSAGE
-} prot_st_t;
-
-typedef enum
-{
-	TFTP_RRQ = 1,		// Read Request, getfile
-	TFTP_WRQ  = 2,		// Write Request, putfile
-	TFTP_DATA = 3,		// Data Packet
-	TFTP_ACK = 4,		// Acknowledgment
-	TFTP_ERROR = 5		// Error Packet
-} tftp_opcode_t;
-
-//recieve protocol structure
-typedef struct
-{
-	uint8_t state;
-
-	uint16_t optcode;
-	uint16_t blocknum;
-	uint16_t errCode;
-
-	uint16_t rxLen;
-
-	uint8_t dataBuf[PROT_MAX_DATA];
-	uint8_t filename[PROT_MAX_DATA];
-	uint8_t mode[MAX_MODE_BUFF];
-	uint8_t errMessage[PROT_MAX_DATA];
-
-	int isLastDataBlock; // 1 if id data is less than 512
-} prot_frame_info_t;
-
-//client session
-typedef struct
-{
-	SOCKET clientSock;
-
-	const char* remoteIpStr;
-	uint16_t remotePort;	//69, port to establish session
-	uint16_t svrPort;		//port server chooses
-
-	int state;
-
-	int isFirstDataBlock;
-
-	tick_timer_t tmr1; //timer waiting for acks or data
-	tick_timer_t tmr2; //timer to print progress
-
-	int num_retrans_tries;
-
-	uint16_t blockNum;
-	uint16_t nextExpectedBlockNum;
-
-	prot_frame_info_t rxInfo;
-
-	FILE * pFile;
-	const char* filename;
-
-	uint16_t lastTxPort;
-
-	// file transmit buffer and lenght variables
-	uint8_t txBuf[MAX_TX_BUFF];
-	uint16_t txLen;
-} client_session_t;
-
-//client session
-typedef struct
-{
-	SOCKET serverSock;
-
-	const char* remoteIpStr;
-	uint16_t client_Port;	//client port that server will retrieve from recvfrom() function
-	const char* client_ip;	//client IP port that server will retrieve from recvfrom() function
-
-	// timers
-	tick_timer_t tmr1; 		//timer waiting for acks or data
-	tick_timer_t tmr2; 		//timer to print progress
-
-	int num_retrans_tries;
-	int state;
-
-	uint16_t blockNum;
-	uint16_t nextExpectedBlockNum;
-
-	prot_frame_info_t rxInfo;
-
-	FILE * pFile;
-	const char* filename;
-
-	uint16_t lastTxPort;
-
-	// file transmit buffer and lenght variables
-	uint8_t txBuf[MAX_TX_BUFF];
-	uint16_t txLen;
-} server_session_t;
-
-//client protocol machine states
-typedef enum
-{
-	CL_ST_GETFILE_RXDATA,				// Receving normal data (GETFILE session)
-	CL_ST_PUTFILE_TXDATA,				// Sending normal data (PUTFILE session)
-}cl_st_t;
-
-//server protocol machine states
-typedef enum
-{
-	SVR_ST_WAIT_FIST_REQUEST,		//wait for getfile or putfile request
-	SVR_ST_GETFILE_TXDATA,				// Sending normal data (GETFILE session)
-	SVR_ST_PUTFILE_RXDATA,				// Recieving normal data (PUTFILE session)
-}svr_st_t;
-
-//FSM client events
-typedef enum
-{
-	EV_CL_TIMEOUT,			// timeout
-	EV_CL_PDU_RX,			// Full protocol data unit received
-} cl_evt_t;
-
-//FSM server events
-typedef enum
-{
-	EV_SVR_TIMEOUT,				// timeout
-	EV_SVR_PDU_RX,				// Full protocol data unit received
-} svr_evt_t;
-
-
-static client_session_t clientCtx;
-static server_session_t serverCtx;
-
-static int gDone = 0;
-static int gFsmDebugOn = 0;
-static int gDebugDropPacket = 0;
-static int gDebugDropAllPks = 0;
-static int gMaxNumRetransTries = 3;
-static uint16_t gSrvPort = DEF_TFTP_PORT;
-
-//detection of ctrl+c
-#ifdef _WIN32
-	BOOL WINAPI signal_handler(DWORD dwCtrlType)
-	{
-		switch (dwCtrlType)
-		{
-			case CTRL_C_EVENT:
-			case CTRL_BREAK_EVENT:
-			case CTRL_CLOSE_EVENT:
-				gDone = 1;
-				printf("detected Ctrl-C, exiting...\n");
-				return TRUE;
-		}
-
-		return FALSE;
-	}
-#else
-	static void signal_handler(int sig)
-	{
-		switch (sig)
-		{
-			case SIGTERM:
-			case SIGHUP:
-			case SIGINT:
-			case SIGQUIT:
-				gDone= 1;
-				printf("detected Ctrl-C, exiting...\n");
-				break;
-			}
-	}
-#endif
-
-//gets client state name
-//state - client state
-//name - pointer to string buffer that receives the name
-static void client_get_state_name(int state, char *name)
-{
-	switch (state)
-	{
-		case CL_ST_GETFILE_RXDATA:
-			strcpy(name, "CL_ST_GETFILE_RXDATA");
-			break;
-
-		case CL_ST_PUTFILE_TXDATA:
-			strcpy(name, "CL_ST_PUTFILE_TXDATA");
-			break;
-
-		default:
-			strcpy(name, "UNKNOWN_ST");
-			break;
-	}
-}
-
-//gets server state name
-//state - server state
-//name - pointer to string buffer that receives the name
-static void server_get_state_name(int state, char *name)
-{
-	switch (state)
-	{
-		case SVR_ST_GETFILE_TXDATA:
-			strcpy(name, "SVR_ST_GETFILE_TXDATA");
-			break;
-
-		case SVR_ST_PUTFILE_RXDATA:
-			strcpy(name, "SVR_ST_PUTFILE_RXDATA");
-			break;
-
-		case SVR_ST_WAIT_FIST_REQUEST:
-			strcpy(name, "SVR_ST_WAIT_FIST_REQUEST");
-			break;
-
-		default:
-			strcpy(name, "UNKNOWN_ST");
-			break;
-	}
-}
-
-//gets server event name
-//event - server event
-//name - pointer to string buffer that receives the name
-static void server_get_event_name(int event, char *name)
-{
-	switch (event)
-	{
-		case EV_SVR_TIMEOUT:
-			strcpy(name, "EV_SVR_TIMEOUT");
-			break;
-
-		case EV_SVR_PDU_RX:
-			strcpy(name, "EV_SVR_PDU_RX");
-			break;
-
-		default:
-			strcpy(name, "UNKNOWN_EV");
-			break;
-	}
-}
-
-//gets client event name
-//event - client event
-//name - pointer to string buffer that receives the name
-static void client_get_event_name(int event, char *name)
-{
-	switch (event)
-	{
-		case EV_CL_TIMEOUT:
-			strcpy(name, "EV_CL_TIMEOUT");
-			break;
-
-		case EV_CL_PDU_RX:
-			strcpy(name, "EV_CL_PDU_RX");
-			break;
-
-		default:
-			strcpy(name, "UNKNOWN_EV");
-			break;
-	}
-}
-
-//changes to a new client state
-//ctx - pointer to client session context
-//newState - state to switch into
-static void client_change_state(client_session_t *ctx, int newState)
-{
-	char stateNameOld[64];
-	char stateNameNew[64];
-
-	if (gFsmDebugOn)
-	{
-		client_get_state_name(ctx->state, stateNameOld);
-		client_get_state_name(newState, stateNameNew);
-
-		printf("%s -> %s\n", stateNameOld, stateNameNew);
-	}
-
-	//change to new state
-	ctx->state = newState;
-}
-
-//changes to a new server state
-//ctx - pointer to server session context
-//newState - state to switch into
-static void server_change_state(server_session_t *ctx, int newState)
-{
-	char stateNameOld[64];
-	char stateNameNew[64];
-
-	if (gFsmDebugOn)
-	{
-		server_get_state_name(ctx->state, stateNameOld);
-		server_get_state_name(newState, stateNameNew);
-
-		printf("%s -> %s\n", stateNameOld, stateNameNew);
-	}
-
-	//change to new state
-	ctx->state = newState;
-}
-
-//send a packet buffer to the server
-//ctx - pointer to client session context
-//isReTransmit: 1 - is a reTransmission packet, 0 - is a regulat packet
-// 0 = failed, 1=success
-static int cl_send_packet_buffer(client_session_t *ctx, int isReTransmit)
-{
-	int rc;
-	struct sockaddr_in Addr;
-
-	//send buffer
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = (isReTransmit) ? ctx->lastTxPort : htons(ctx->svrPort);
-	Addr.sin_addr.s_addr = inet_addr(ctx->remoteIpStr);
-
-	ctx->lastTxPort = Addr.sin_port;
-
-	#ifdef _WIN32
-		rc = sendto(ctx->clientSock, (const char*)ctx->txBuf ,(size_t)ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#else
-		rc = sendto(ctx->clientSock, ctx->txBuf, (size_t)ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#endif
-
-	if (rc < 0)
-	{
-		#ifdef _WIN32
-			int err = WSAGetLastError();
-			printf("sendto failed with error code: %d\n", err);
-		#else
-
-			printf("sendto returns error: rc=%d\n", rc);
-			printf("error code:%d (%s)\n", errno, strerror(errno));
-		#endif
-		return 0;
-	}
-	return 1;
-}
-
-//send a packet buffer to the server
-//ctx - pointer to client session context
-//isReTransmit: 1 - is a reTransmission packet, 0 - is a regulat packet
-// 0 = failed, 1=success
-static int svr_send_packet_buffer(server_session_t *ctx, int isReTransmit)
-{
-	int rc;
-	struct sockaddr_in Addr;
-
-	//send buffer
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = (isReTransmit) ? ctx->lastTxPort : htons(ctx->client_Port);
-	Addr.sin_addr.s_addr = inet_addr(ctx->client_ip);
-
-	ctx->lastTxPort = Addr.sin_port;
-
-	#ifdef _WIN32
-		rc = sendto(ctx->serverSock, (const char*)ctx->txBuf ,(size_t)ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#else
-		rc = sendto(ctx->serverSock, ctx->txBuf, (size_t)ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#endif
-
-	if (rc < 0)
-	{
-		printf("sendto returns error: rc=%d\n", rc);
-		return 0;
-	}
-
-	return 1;
-}
-
-
-//initiates recieve protocol
-// pf - pointer to protolcol packet structure
-static void init_receive_pkt(prot_frame_info_t *pf)
-{
-	pf->state = READ_OPT_CODE_1;
-	pf->rxLen = 0;
-}
-
-// parces recieved packet and fills out prot_frame_info_t structure
-// pf - pointer to protolcol packet structure
-// pktBuf - pointer to buffer contating the recieved packet
-// pktBufLen - length of recieved buffer
-// Returns 1=success, 0=failed (malformed packet)
-static int receive_tftp_pkt(prot_frame_info_t *pf, uint8_t *pktBuf, int pktBufLen)
-{
-	int dataLen;
-	int n =0;
-	int i;
-	uint16_t *p;
-
-	if (pktBufLen < 4)
-		return 0;
-
-	if (pktBuf[n++] != 0)
-		return 0;
-
-	pf->optcode = (uint16_t)pktBuf[n++];
-
-	switch (pf->optcode)
-	{
-	case TFTP_DATA:
-		p = (uint16_t*)&pktBuf[n];
-
-		pf->blocknum = ntohs(*p);
-		n += 2;
-
-		dataLen = pktBufLen -4;
-
-		if (dataLen < PROT_MAX_DATA)
-			pf->isLastDataBlock = 1;
-		else
-			pf->isLastDataBlock = 0;
-
-		for (i = 0; i < dataLen; i++)
-		{
-			pf->dataBuf[i] = pktBuf[n++];
-		}
-		break;
-
-	case TFTP_ACK:
-		p = (uint16_t*)&pktBuf[n];
-
-		pf->blocknum = ntohs(*p);
-		break;
-
-	case TFTP_RRQ:
-	case TFTP_WRQ:
-
-		i = 0;
-		while ((n != 0x00) && (i < PROT_MAX_DATA))
-		{
-			pf->filename[i++] = pktBuf[n++];
-		}
-
-		pf->filename[i++] = 0x00;
-		n++;
-
-		while ((n != 0x00) && (i < MAX_MODE_BUFF))
-		{
-			pf->mode[i++] = pktBuf[n++];
-		}
-
-		pf->mode[i++] = 0x00;
-		break;
-
-	case TFTP_ERROR:
-		p = (uint16_t*)&pktBuf[n];
-
-		pf->errCode= ntohs(*p);
-		n += 2;
-
-		i = 0;
-		while((n != 0x00) && (i < PROT_MAX_DATA))
-		{
-			pf->errMessage[i++] = pktBuf[n++];
-		}
-
-		pf->errMessage[i++]= 0x00;
-		break;
-
-	default:
-		return 0;
-	}
-
-	pf->rxLen =(uint16_t)pktBufLen;
-	return 1;
-}
-
-//sends first request to server
-//ctx - pointer to client session context
-//operationStr - pointer to string buffer containing operation request (getfile or putfile)
-//filename - pointer to string buffer containing the filename
-static int send_first_request(client_session_t *ctx, const char* operationStr, const char* filename)
-{
-	size_t n = 0;
-	int rc;
-	int filenameLen;
-	struct sockaddr_in Addr;
-	socklen_t AddrSize = (socklen_t)sizeof(Addr);
-	const char *mode = "octet";
-
-	//check buffer overflow
-	if (strlen(filename) > PROT_MAX_DATA)
-		return 0;
-
-	if (strcmp(operationStr, "getfile") == 0)
-	{
-		ctx->txBuf[n++] = 0x00;
-		ctx->txBuf[n++] = TFTP_RRQ;
-		ctx->nextExpectedBlockNum = 1;
-
-		client_change_state(ctx, CL_ST_GETFILE_RXDATA);
-	}
-	else
-	{
-		ctx->txBuf[n++] = 0x00;
-		ctx->txBuf[n++] = TFTP_WRQ;
-		ctx->nextExpectedBlockNum = 0;
-
-		client_change_state(ctx, CL_ST_PUTFILE_TXDATA);
-	}
-
-	UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS); 	//start waitong for ack tmr
-
-	if (!gFsmDebugOn)
-		UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);	//start print progress tmr
-
-	filenameLen = strlen(filename);
-
-	//copy filename into packet buffer
-	memcpy(&ctx->txBuf[n], filename, filenameLen+1);
-	n += (filenameLen + 1);
-
-	memcpy(&ctx->txBuf[n], mode, strlen(mode)+1);
-	n += (strlen(mode) + 1);
-	ctx->txLen = n;
-
-	//send buffer
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = htons(ctx->remotePort);
-	Addr.sin_addr.s_addr = inet_addr(ctx->remoteIpStr);
-
-	ctx->lastTxPort = Addr.sin_port;
-
-	#ifdef _WIN32
-		rc = sendto(ctx->clientSock, (const char*)ctx->txBuf , n, 0, (struct sockaddr *)&Addr, AddrSize);
-	#else
-		rc = sendto(ctx->clientSock, ctx->txBuf, n, 0, (struct sockaddr *)&Addr, AddrSize);
-	#endif
-
-	if (rc == -1)
-	{
-		printf("failed to send first request\n");
-		return 0;
-	}
-
-	return 1;
-}
-
-
-//menu shown to the user if command line input is incorrect
-static void help(void)
-{
-	printf("help:\n");
-	printf("-m <operating mode>\n-p <Server Port Number>\n-r <Remote IP Address>\n-o <Operation>\n-f <filename>\n");
-}
-
-//safely closes socket
-//sock - pointer to socket
-static void close_socket(SOCKET *sock)
-{
-	if (*sock == INVALID_SOCKET)
-		return;
-
-	#ifdef _WIN32
-		closesocket(*sock);
-		WSACleanup();
-	#else
-		close(*sock);
-	#endif
-
-	*sock = INVALID_SOCKET;
-}
-
-//safely closes the socket and file
-//ctx - pointer to client session context
-static void cl_close_file_and_sock(client_session_t*ctx)
-{
-
-	close_socket(&ctx->clientSock);
-
-	if (ctx->pFile != NULL)
-	{
-		fclose(ctx->pFile);
-		ctx->pFile = NULL;
-	}
-}
-
-//safely closes the socket and file
-//ctx - pointer to server session context
-static void svr_close_file_and_sock(server_session_t*ctx)
-{
-	close_socket(&ctx->serverSock);
-
-	if (ctx->pFile != NULL)
-	{
-		fclose(ctx->pFile);
-		ctx->pFile = NULL;
-	}
-}
-
-//send ACK packet from client
-//ctx - pointer to client session context
-// 1 - success, 0 - failure
-static int cl_send_ack(client_session_t *ctx)
-{
-	int n = 0;
-	int rc;
-	struct sockaddr_in Addr;
-
-	ctx->txBuf[n++] = 0x00;
-	ctx->txBuf[n++] = TFTP_ACK;
-
-	//put block num in network byte order
-	ctx->txBuf[n++] = (ctx->blockNum >> 8) & 0xFF;	// High byte
-	ctx->txBuf[n++] = ctx->blockNum & 0xFF;			// Low byte
-
-	ctx->txLen = n;
-
-	//send buffer
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = htons(ctx->svrPort);
-	Addr.sin_addr.s_addr = inet_addr(ctx->remoteIpStr);
-
-	ctx->lastTxPort = Addr.sin_port;
-
-	#ifdef _WIN32
-		rc = sendto(ctx->clientSock, (const char*)ctx->txBuf , n, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#else
-		rc = sendto(ctx->clientSock, ctx->txBuf, n, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#endif
-
-	if (rc == -1)
-	{
-		return 0;
-	}
-
-	return 1;
-}
-
-//send ACK packet from server
-//ctx - pointer to server session context
-// 1 - success, 0 - failure
-static int svr_send_ack(server_session_t *ctx)
-{
-	int n = 0;
-	int rc;
-	struct sockaddr_in Addr;
-
-	ctx->txBuf[n++] = 0x00;
-	ctx->txBuf[n++] = TFTP_ACK;
-
-	//put block num in network byte order
-	ctx->txBuf[n++] = (ctx->blockNum >> 8) & 0xFF;	// High byte
-	ctx->txBuf[n++] = ctx->blockNum & 0xFF;			// Low byte
-
-	ctx->txLen = n;
-
-	//send buffer
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = htons(ctx->client_Port);
-	Addr.sin_addr.s_addr = inet_addr(ctx->client_ip);
-
-	ctx->lastTxPort = Addr.sin_port;
-
-	#ifdef _WIN32
-		rc = sendto(ctx->serverSock, (const char*)ctx->txBuf , n, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#else
-		rc = sendto(ctx->serverSock, ctx->txBuf, n, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#endif
-
-	if (rc == -1)
-	{
-		return 0;
-	}
-
-	return 1;
-}
-
-//send error packet from client
-//ctx - pointer to client session context
-// errCode - error code
-// errMsg - pointer to string buffer containing error message
-// 1 - success, 0 - failure
-static int cl_send_error_pkt(client_session_t *ctx, uint16_t errCode, const char* errMsg)
-{
-	int n = 0;
-	int rc;
-	struct sockaddr_in Addr;
-
-	if (strlen(errMsg) > PROT_MAX_DATA)
-		return 0;
-
-	ctx->txBuf[n++] = 0x00;
-	ctx->txBuf[n++] = TFTP_ERROR;
-
-	ctx->txBuf[n++] = (uint8_t)((errCode>> 8) & 0xff);
-	ctx->txBuf[n++] = (uint8_t)(errCode & 0xff);
-
-	//copy error string into packet buffer
-	memcpy(&ctx->txBuf[n++], errMsg, strlen(errMsg));
-
-	ctx->txLen = 5 + strlen(errMsg);
-
-	//null terminate buffer
-	ctx->txBuf[ctx->txLen++] = 0x00;
-
-	//send buffer
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = htons(ctx->svrPort);
-	Addr.sin_addr.s_addr = inet_addr(ctx->remoteIpStr);
-
-	#ifdef _WIN32
-		rc = sendto(ctx->clientSock, (const char*)ctx->txBuf , ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#else
-		rc = sendto(ctx->clientSock, ctx->txBuf, ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#endif
-
-	if (rc == -1)
-	{
-		return 0;
-	}
-
-	return 1;
-}
-
-//send error packet from server
-//ctx - pointer to server session context
-// errCode - error code
-// errMsg - pointer to string buffer containing error message
-// 1 - success, 0 - failure
-static int svr_send_error_pkt(server_session_t *ctx, uint16_t errCode, const char* errMsg)
-{
-	int n = 0;
-	int rc;
-	struct sockaddr_in Addr;
-
-	if (strlen(errMsg) > PROT_MAX_DATA)
-		return 0;
-
-	ctx->txBuf[n++] = 0x00;
-	ctx->txBuf[n++] = TFTP_ERROR;
-
-	ctx->txBuf[n++] = (uint8_t)((errCode>> 8) & 0xff);
-	ctx->txBuf[n++] = (uint8_t)(errCode & 0xff);
-
-	//copy error string into packet buffer
-	memcpy(&ctx->txBuf[n++], errMsg, strlen(errMsg));
-
-	ctx->txLen = 5 + strlen(errMsg);
-
-	//null terminate buffer
-	ctx->txBuf[ctx->txLen++] = 0x00;
-
-	//send buffer
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = htons(ctx->client_Port);
-	Addr.sin_addr.s_addr = inet_addr(ctx->client_ip);
-
-	#ifdef _WIN32
-		rc = sendto(ctx->serverSock, (const char*)ctx->txBuf , ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#else
-		rc = sendto(ctx->serverSock, ctx->txBuf, ctx->txLen, 0, (struct sockaddr *)&Addr, sizeof(Addr));
-	#endif
-
-	if (rc == -1)
-	{
-		return 0;
-	}
-
-	return 1;
-}
-
-//sends data to server
-//ctx - pointer to client session context
-// ev - client event
-static int cl_putfile_txData(client_session_t *ctx, int ev)
-{
-	size_t bytesToRead = PROT_MAX_DATA;
-	size_t bytesRead;
-	static int bytes_sent = 0;
-	int rc;
-	int n;
-
-	switch(ev)
-	{
-	case EV_CL_TIMEOUT:
-		//resend ack and increment retransmission tries, and break
-		ctx->num_retrans_tries++;
-
-		//close socket if we reach ,ax retransissions and return 0;
-		if (ctx->num_retrans_tries == gMaxNumRetransTries)
-		{
-			ctx->num_retrans_tries = 0;
-
-			printf("reached max number of timeouts, closing session\n");
-			cl_send_error_pkt(ctx, 0, "timeout waiting for ack, closing connection\n");
-			cl_close_file_and_sock(ctx);
-			gDone = 1;
-			return 0;
-		}
-
-		//resend packet
-		cl_send_packet_buffer(ctx, 1);
-
-		UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-		break;
-
-	case EV_CL_PDU_RX:
-		switch (ctx->rxInfo.optcode)
-		{
-		case TFTP_ACK:
-			//check block num
-			if (ctx->rxInfo.blocknum != ctx->nextExpectedBlockNum)
-				break;
-
-			ctx->nextExpectedBlockNum++;
-
-			//send data and restart tmr
-			ctx->blockNum++;
-			ctx->num_retrans_tries = 0;
-
-			bytesRead = fread(&ctx->txBuf[4], 1, bytesToRead, ctx->pFile);
-
-			// If zero, then this is the end of file
-			if ((bytesRead == 0) && (ctx->isFirstDataBlock == 0))
-			{
-				// Need to deternibe if we need to send an empty DATA block
-				if ((ctx->txLen - 4) < PROT_MAX_DATA)
-				{
-					// If last data block sent was shorter than 512
-					// close connection, success
-					printf("%s successfully uploaded, closing connection\n", ctx->filename);
-					return 0;
-				}
-			}
-
-			n = 0;
-			ctx->txBuf[n++] = 0x00;
-			ctx->txBuf[n++] = TFTP_DATA;
-			ctx->txBuf[n++] = (uint8_t)((ctx->blockNum >> 8) & 0xff);
-			ctx->txBuf[n++] = (uint8_t)(ctx->blockNum & 0xff);
-
-			ctx->txLen = (uint16_t)(4 + bytesRead);
-
-			//send data
-			rc = cl_send_packet_buffer(ctx, 0);
-
-			if (!rc)
-			{
-				printf("error sending data packet, closing connection\n");
-				cl_send_error_pkt(ctx,0, "error sending data packet, closing connection");
-
-				cl_close_file_and_sock(ctx);
-				return 0;
-			}
-
-			bytes_sent += bytesRead;
-
-			if((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
-			{
-				printf("bytes sent: %d\n", bytes_sent);
-				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
-			}
-
-			//restart tmr
-			UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-
-			ctx->isFirstDataBlock = 0;
-
-			return 1;
-
-		case TFTP_ERROR:
-			//parse error packet and print to console
-
-			printf("error code: %hu\n", ctx->rxInfo.errCode);
-
-			printf("%s\n", ctx->rxInfo.errMessage);
-			cl_close_file_and_sock(ctx);
-			return 0;
-
-		default:
-			printf("error unexpected optcode recieved, closing connection\n");
-
-			cl_send_error_pkt(ctx, 0, "error unexpected optcode recieved");
-
-			cl_close_file_and_sock(ctx);
-			return 0;
-		}
-		break;
-	}
-	return 1;
-}
-
-//recieves data from server
-//ctx - pointer to client session context
-// ev - client event
-static int cl_getfile_rxData(client_session_t *ctx, int ev)
-{
-	size_t bytesWritten;
-	static int bytes_recieved = 0;
-
-	switch (ev)
-	{
-		case EV_CL_TIMEOUT:
-			//resend ack and incremt retransmission tries, and break
-			ctx->num_retrans_tries++;
-
-			//close socket if we reach ,ax retransissions and return 0;
-			if (ctx->num_retrans_tries == gMaxNumRetransTries)
-			{
-				printf("reached max number of timouts, closing session\n");
-				ctx->num_retrans_tries = 0;
-
-				cl_send_error_pkt(ctx, 0, "timeout waiting for data, closing connection");
-				cl_close_file_and_sock(ctx);
-				gDone = 1;
-				return 0;
-			}
-
-			//send last buffer
-			cl_send_packet_buffer(ctx, 1);
-
-			UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-			break;
-
-		case EV_CL_PDU_RX:
-			switch (ctx->rxInfo.optcode)
-			{
-			case TFTP_DATA:
-				//compare received block no with expected block no
-				//If they mismatch, ignore the packet and break;
-				if (ctx->rxInfo.blocknum != ctx->nextExpectedBlockNum)
-					break;
-
-				// If they match - proceed
-				// Increment next expeted block number
-				ctx->nextExpectedBlockNum++;
-
-				if (ctx->isFirstDataBlock)
-				{
-					//open file for writing
-					ctx->pFile = fopen(ctx->filename, "wb");
-
-					if (ctx->pFile == NULL)
-					{
-						printf("error: failed to open file for writing\n");
-						cl_send_error_pkt(ctx, 1, "error, failed to open file for writing");
-
-						return 0;
-					}
-					ctx->isFirstDataBlock = 0;
-				}
-
-				ctx->num_retrans_tries = 0;
-
-				//recieve packet from client and write payload contents into file
-				bytesWritten = fwrite(ctx->rxInfo.dataBuf, 1, ctx->rxInfo.rxLen - 4, ctx->pFile);
-
-				if (bytesWritten != (ctx->rxInfo.rxLen - 4))
-				{
-					//send error packet
-					printf("error writing file data, closing connection, bytesWritten = %d (%u)\n", (int)bytesWritten, ctx->rxInfo.rxLen - 4);
-
-					cl_send_error_pkt(ctx, 0, "error writing file data, closing connection");
-
-					//close connection
-					cl_close_file_and_sock(ctx);
-					return 0;
-				}
-
-				//check if this id the last data packet
-				if (ctx->rxInfo.isLastDataBlock)
-				{
-					printf("%s successfully downloaded, closing connection\n", ctx->filename);
-					ctx->blockNum++;
-					cl_send_ack(ctx);
-					cl_close_file_and_sock(ctx);
-					return 0;
-				}
-
-				bytes_recieved += (int)bytesWritten;
-
-				if ((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
-				{
-					printf("bytes recieved: %d\n", bytes_recieved);
-					UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
-				}
-
-				//send ack
-				ctx->blockNum++;
-				cl_send_ack(ctx);
-
-				UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-				return 1;
-
-			case TFTP_ERROR:
-				//parse error packet and print to console
-
-				printf("error code: %hu\n", ctx->rxInfo.errCode);
-
-				printf("%s\n", ctx->rxInfo.errMessage);
-
-				cl_close_file_and_sock(ctx);
-				return 0;
-
-			default:
-				printf("error unexpected optcode recieved, closing connection\n");
-
-				cl_send_error_pkt(ctx, 0, "error unexpected optcode recieved");
-
-				//close socket
-				cl_close_file_and_sock(ctx);
-				return 0;
-			}
-
-			break;
-	}
-
-	return 1;
-}
-
-//client finite state machine
-//ctx - pointer to client session context
-// ev - client event
-static int cl_fsm_event(client_session_t *ctx, int ev)
-{
-	if (gFsmDebugOn)
-	{
-		char stateName[64];
-		char eventName[64];
-
-		client_get_state_name(ctx->state, stateName);
-		client_get_event_name(ev, eventName);
-
-		printf("CL FSM: ev [%s] <-- %s\n",
-			stateName, eventName);
-	}
-
-	switch (ctx->state)
-	{
-	case CL_ST_GETFILE_RXDATA:
-		if (!cl_getfile_rxData(ctx, ev))
-			return 0;
-		break;
-
-	case CL_ST_PUTFILE_TXDATA:
-		if (!cl_putfile_txData(ctx, ev))
-			return 0;
-		break;
-	}
-	return 1;
-}
-
-//waits for first request from client
-//ctx - pointer to sevrer session context
-// ev - server event
-static void svr_wait_first_request(server_session_t *ctx, int ev)
-{
-	size_t bytesToRead = PROT_MAX_DATA;
-	size_t bytesRead;
-	int n;
-
-	switch(ev)
-	{
-	case EV_SVR_PDU_RX:
-		switch(ctx->rxInfo.optcode)
-		{
-		//putfile request, recieving data
-		case TFTP_WRQ:
-			//get filename, open for writing
-			ctx->pFile = fopen((char*)ctx->rxInfo.filename, "wb");
-
-			if (ctx->pFile == NULL)
-			{
-				printf("error, failed to open file\n");
-				svr_send_error_pkt(ctx, 1, "file not found");
-				break;
-			}
-
-			ctx->filename = (char*)ctx->rxInfo.filename;
-
-			printf("recieved request to write data to file '%s'\n", ctx->filename);
-
-			//send first ack with block num = 0;
-			ctx->blockNum = 0;
-			ctx->nextExpectedBlockNum = 1;
-			svr_send_ack(ctx);
-
-			//start timer
-			UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-
-			if (!gFsmDebugOn)
-				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);	//start print progress tmr
-
-			server_change_state(ctx, SVR_ST_PUTFILE_RXDATA);
-			break;
-
-		//getfile request, sending data
-		case TFTP_RRQ:
-			//open file for reading
-			ctx->pFile = fopen((char*)ctx->rxInfo.filename, "rb");
-
-			if (ctx->pFile == NULL)
-			{
-				printf("error, failed to open file\n");
-				svr_send_error_pkt(ctx, 1, "file not found");
-				break;
-			}
-
-			ctx->filename = (char*)ctx->rxInfo.filename;
-
-			printf("recieved request to read data from file '%s'\n", ctx->filename);
-
-			//send first data with block num = 1
-			ctx->blockNum = 1;
-			ctx->nextExpectedBlockNum = 1;
-
-			n = 0;
-			ctx->txBuf[n++] = 0x00;
-			ctx->txBuf[n++] = TFTP_DATA;
-			ctx->txBuf[n++] = (uint8_t)((ctx->blockNum >> 8) & 0xff);
-			ctx->txBuf[n++] = (uint8_t)(ctx->blockNum & 0xff);
-
-			//build txBuff
-			bytesRead = fread(&ctx->txBuf[n], 1, bytesToRead, ctx->pFile);
-
-			n += bytesRead;
-
-			ctx->txLen = (uint16_t)n;
-
-			//data block, if timeout occurs exit and send error
-			if (!svr_send_packet_buffer(ctx, 0))
-			{
-				printf("error sending data packet\n");
-
-				svr_send_error_pkt(ctx,0, "error sending data packet");
-
-				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-				break;
-			}
-
-			//start timer
-			UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-
-			if (!gFsmDebugOn)
-				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);	//start print progress tmr
-
-			server_change_state(ctx, SVR_ST_GETFILE_TXDATA);
-			break;
-
-		default:
-
-			printf("error sending data packet\n");
-			svr_send_error_pkt(ctx,0, "error sending data packet");
-
-			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-			break;
-
-		}
-		break;
-
-	default:
-
-		server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-		break;
-
-	}
-}
-
-//sends data to client
-//ctx - pointer to server session context
-// ev - server event
-static void svr_getfile_txData(server_session_t *ctx, int ev)
-{
-	size_t bytesToRead = PROT_MAX_DATA;
-	size_t bytesRead;
-	static int bytes_sent = 0;
-	int rc, n;
-	switch (ev)
-	{
-	case EV_SVR_TIMEOUT:
-		//resend ack and incremt retransmission tries, and break
-		ctx->num_retrans_tries++;
-
-		//close socket if we reach ,ax retransissions and return 0;
-		if (ctx->num_retrans_tries == gMaxNumRetransTries)
-		{
-			ctx->num_retrans_tries = 0;
-
-			printf("reached max number of timouts\n");
-			svr_send_error_pkt(ctx, 0, "timeout waiting for ACK, closing connection\n");
-
-			//close file
-			if (ctx->pFile != NULL)
-			{
-				fclose(ctx->pFile);
-				ctx->pFile = NULL;
-			}
-
-			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-			break;
-		}
-
-		//resend buffer
-		svr_send_packet_buffer(ctx, 1);
-
-		UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-		break;
-
-	case EV_SVR_PDU_RX:
-		//check optcodes
-		switch (ctx->rxInfo.optcode)
-		{
-		case TFTP_ACK:
-			//send next data block from file
-			//check block num
-				if (ctx->rxInfo.blocknum != ctx->nextExpectedBlockNum)
-					break;
-
-				ctx->nextExpectedBlockNum++;
-
-				//increment block num
-				ctx->blockNum++;
-				ctx->num_retrans_tries = 0;
-
-				bytesRead = fread(&ctx->txBuf[4], 1, bytesToRead, ctx->pFile);
-
-				// If zero, then this is the end of file
-				if (bytesRead == 0)
-				{
-					// Need to deternibe if we need to send an empty DATA block
-					if ((ctx->txLen - 4) < PROT_MAX_DATA)
-					{
-						// If last data block sent was shorter than 512
-						// close connection, success
-						printf("%s successfully uploaded\nwaiting for next request\n", ctx->filename);
-
-						//close file
-						if (ctx->pFile != NULL)
-						{
-							fclose(ctx->pFile);
-							ctx->pFile = NULL;
-						}
-
-						server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-						break;;
-					}
-				}
-
-				n = 0;
-				ctx->txBuf[n++] = 0x00;
-				ctx->txBuf[n++] = TFTP_DATA;
-				ctx->txBuf[n++] = (uint8_t)((ctx->blockNum >> 8) & 0xff);
-				ctx->txBuf[n++] = (uint8_t)(ctx->blockNum & 0xff);
-
-				//printf("DATA HDR: %02x %02x %02x %02x\n", ctx->txBuf[0], ctx->txBuf[1], ctx->txBuf[2], ctx->txBuf[3]);
-
-				ctx->txLen = (uint16_t)(4 + bytesRead);
-
-				// send data block
-				rc = svr_send_packet_buffer(ctx, 0);
-
-				if (!rc)
-				{
-					svr_send_error_pkt(ctx,0, "error sending data packet, closing connection");
-
-					server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-					break;
-				}
-
-				bytes_sent += bytesRead;
-
-				if((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
-				{
-					printf("bytes sent: %d\n", bytes_sent);
-					UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
-				}
-
-				//restart tmr
-				UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-
-			break;
-		case TFTP_ERROR:
-			//get error message;
-			printf("error code: %hu\n", ctx->rxInfo.errCode);
-			printf("%s\n", ctx->rxInfo.errMessage);
-
-			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-			break;
-
-		default:
-			printf("error, unexpected optcode\n");
-			svr_send_error_pkt(ctx, 0, "error, unexpected optcode");
-
-			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-			break;
-		}
-		break;
-	}
-}
-
-//recieves data from client
-//ctx - pointer to server session context
-// ev - server event
-static void svr_putfile_rxData(server_session_t *ctx, int ev)
-{
-	size_t bytesWritten;
-	static int bytes_recieved = 0;
-	switch (ev)
-	{
-	case EV_SVR_TIMEOUT:
-		//resend ack and incremt retransmission tries, and break
-		ctx->num_retrans_tries++;
-
-		//close socket if we reach ,ax retransissions and return 0;
-		if (ctx->num_retrans_tries == gMaxNumRetransTries)
-		{
-			printf("reached ,max number of timouts\n");
-			svr_send_error_pkt(ctx, 0, "timeout waiting for ACK, closing connection\n");
-
-			ctx->num_retrans_tries = 0;
-
-			//close file
-			if (ctx->pFile != NULL)
-			{
-				fclose(ctx->pFile);
-				ctx->pFile = NULL;
-			}
-
-			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-			break;
-		}
-
-		//resend buffer
-		svr_send_packet_buffer(ctx, 1);
-
-		UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-		break;
-
-	case EV_SVR_PDU_RX:
-
-		switch (ctx->rxInfo.optcode)
-		{
-		case TFTP_DATA:
-			//compare received block no with expected block no
-			//If they mismatch, ignore the packet and break;
-			if (ctx->rxInfo.blocknum != ctx->nextExpectedBlockNum)
-				break;
-
-			// If they match - proceed
-			// Increment next expeted block number
-			ctx->nextExpectedBlockNum++;
-			ctx->num_retrans_tries = 0;
-
-			//recieve packet from client and write payload contents into file
-			bytesWritten = fwrite(ctx->rxInfo.dataBuf, 1, ctx->rxInfo.rxLen - 4, ctx->pFile);
-
-			if (bytesWritten != (ctx->rxInfo.rxLen - 4))
-			{
-				//send error packet
-				printf("error writing file data, closing connection, bytesWritten = %d (%u)\n", (int)bytesWritten, ctx->rxInfo.rxLen - 4);
-
-				svr_send_error_pkt(ctx, 0, "error writing file data, closing connection");
-
-				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-				break;
-			}
-
-			//check if this id the last data packet
-			if (ctx->rxInfo.isLastDataBlock)
-			{
-				printf("%s has been successfully downloaded\nwaiting for next request\n", ctx->filename);
-				ctx->blockNum++;
-				svr_send_ack(ctx);
-
-				if (ctx->pFile != NULL)
-				{
-					fclose(ctx->pFile);
-					ctx->pFile = NULL;
-				}
-
-				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-				break;
-			}
-
-			bytes_recieved += (int)bytesWritten;
-
-			if ((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
-			{
-				printf("bytes recieved: %d\n", bytes_recieved);
-				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
-			}
-
-			//send ack
-			ctx->blockNum++;
-			svr_send_ack(ctx);
-
-			UtilTickTimerStart(&ctx->tmr1, ACK_TIMEOUT_SECS);
-			break;
-		case TFTP_ERROR:
-			//get error message;
-			printf("error code: %hu\n", ctx->rxInfo.errCode);
-			printf("%s\n", ctx->rxInfo.errMessage);
-
-			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-			break;
-
-		default:
-			printf("error, unexpected optcode\n");
-			svr_send_error_pkt(ctx, 0, "error, unexpected optcode");
-
-			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
-			break;
-		}
-		break;
-	}
-}
-
-// server finite state machine
-//ctx - pointer to server session context
-// ev - server event
-static void svr_fsm_event(server_session_t *ctx, int ev)
-{
-	if (gFsmDebugOn)
-	{
-		char stateName[64];
-		char eventName[64];
-
-		server_get_state_name(ctx->state, stateName);
-		server_get_event_name(ev, eventName);
-
-		printf("SVR FSM: ev [%s] <-- %s\n",stateName, eventName);
-	}
-
-	switch (ctx->state)
-	{
-	case SVR_ST_GETFILE_TXDATA:
-		svr_getfile_txData(ctx, ev);
-		break;
-
-	case SVR_ST_PUTFILE_RXDATA:
-		svr_putfile_rxData(ctx, ev);
-		break;
-
-	case SVR_ST_WAIT_FIST_REQUEST:
-		svr_wait_first_request(ctx, ev);
-		break;
-	}
-}
-
-//creates client socket
-//client_sock - created socket
-static int create_outgoing_con_sock(SOCKET *client_sock)
-{
-	struct sockaddr_in Addr;
-	SOCKET sock;
-
-	#ifdef _WIN32
-		WSADATA wsaData;
-
-		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
-		{
-			printf("Failed to initialize Winsock\n");
-			return 0;
-		}
-	#endif
-
-	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-
-	if (sock == INVALID_SOCKET)
-	{
-		printf("failed to create outgoing connection socket\n");
-		return 0;
-	}
-
-	//bind socket
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_addr.s_addr = INADDR_ANY;
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = htons(0);
-
-	if (bind(sock, (struct sockaddr *)&Addr, sizeof(struct sockaddr_in)) == -1)
-	{
-		printf("failed to bind socket to local udp port\n");
-		close_socket(&sock);
-		return 0;
-	}
-
-	*client_sock = sock;
-	return 1;
-}
-
-//runs the client application
-// remote_ip - remote IP address
-//filename - pointer to string buffer containing filename
-//operation - operate request (getfile or putfile)
-// returns 0 - error occured, 1 - session ended normally
-static int file_client(const char *remote_ip, const char *filename, const char* operation)
-{
-	fd_set readfds;
-	int ret, rc;
-	uint8_t rxbuf[MAX_RX_BUFF];
-	struct timeval selTimeout;
-	int timeout_ms = 15;
-	int packetCount = 0;
-
-	tick_timer_t connectionTmr;	//waitng for connection timer
-	uint32_t ConTimeout = 5;	//seconds
-
-	struct sockaddr_in from;
-
-	memset(&clientCtx, 0, sizeof(clientCtx));
-
-	clientCtx.filename = filename;
-	clientCtx.remoteIpStr = remote_ip;
-	clientCtx.remotePort = gSrvPort;
-
-	clientCtx.isFirstDataBlock = 1;
-
-	if (!create_outgoing_con_sock(&clientCtx.clientSock))
-		return 0;
-
-	if (strcmp(operation, "putfile") == 0)
-	{
-		printf("starting TFTP file upload: remote IP %s, port %hu\n", remote_ip, gSrvPort);
-	}
-	else
-	{
-		printf("starting TFTP file download: remote IP %s, port %hu\n", remote_ip, gSrvPort);
-	}
-
-	// select will wait on events for x milliseconds
-	selTimeout.tv_sec = (timeout_ms / 1000);
-	selTimeout.tv_usec = ((timeout_ms % 1000) * 1000);
-
-	if (strcmp(operation, "putfile") == 0)
-		clientCtx.pFile = fopen(clientCtx.filename, "rb");
-
-	if ((strcmp(operation, "putfile") == 0) && (clientCtx.pFile == NULL))
-	{
-		printf("error: failed to open file for reading\n");
-		cl_send_error_pkt(&clientCtx, 1, "error, failed to open file for reading");
-		return 0;
-	}
-
-	send_first_request(&clientCtx, operation, filename);
-
-	UtilTickTimerStart(&connectionTmr, ConTimeout);
-
-	while (!gDone)
-	{
-		// potentially perform other tasks
-
-		// Setup socket sock to be monitored for "read events"
-		FD_ZERO(&readfds);
-		FD_SET(clientCtx.clientSock, &readfds);
-
-		ret = select(clientCtx.clientSock + 1, &readfds, NULL, NULL, &selTimeout);
-
-		if (ret > 0)
-		{
-			if (FD_ISSET(clientCtx.clientSock, &readfds))
-			{
-				// Data is available for reading from the socket
-				// call socket receive function here
-				#ifdef _WIN32
-				int addrlen = sizeof(from);
-					rc = recvfrom(clientCtx.clientSock, (char *)rxbuf, sizeof(rxbuf), 0, ((struct sockaddr *)&from), &addrlen);
-				#else
-				socklen_t addrlen = sizeof(from);
-					rc = recvfrom(clientCtx.clientSock, rxbuf, sizeof(rxbuf), 0, ((struct sockaddr *)&from), &addrlen);
-				#endif
-
-				if (rc > 0)
-				{
-					packetCount ++;
-
-					clientCtx.svrPort = ntohs(from.sin_port);
-
-					init_receive_pkt(&clientCtx.rxInfo);
-
-					//call recieve packet function for all packets that are a multiple of 5
-					if (gDebugDropPacket && ((packetCount % 5) == 0))
-					{
-						printf("%dth packet dropped\n", packetCount);
-					}
-					else if (gDebugDropAllPks && (packetCount < 10))
-					{
-						// data received in rxbuf, length od data returned in rc
-						if (receive_tftp_pkt(&clientCtx.rxInfo, rxbuf, rc))
-						{
-							if (!cl_fsm_event(&clientCtx, EV_CL_PDU_RX))
-								break;
-						}
-						else
-						{
-							printf("receive_tftp_pkt returned 0\n");
-						}
-					}
-					else if (!gDebugDropAllPks)
-					{
-						// data received in rxbuf, length od data returned in rc
-						if (receive_tftp_pkt(&clientCtx.rxInfo, rxbuf, rc))
-						{
-							if (!cl_fsm_event(&clientCtx, EV_CL_PDU_RX))
-								break;
-						}
-						else
-						{
-							printf("receive_tftp_pkt returned 0\n");
-						}
-					}
-				}
-				else if (UtilTickTimerRun(&connectionTmr))
-				{
-					printf("no response from server, closing session\n");
-					gDone = 1;
-				}
-			}
-		}
-
-		if (UtilTickTimerRun(&clientCtx.tmr1))
-			cl_fsm_event(&clientCtx, EV_CL_TIMEOUT);
-	}
-
-	cl_close_file_and_sock(&clientCtx);
-	return 1;
-}
-
-//creates server socket
-//server_sock - created socket
-static int create_svr_sock(SOCKET *server_sock)
-{
-	struct sockaddr_in Addr;
-	SOCKET sock;
-
-	#ifdef _WIN32
-		WSADATA wsaData;
-
-		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
-		{
-			printf("Failed to initialize Winsock\n");
-			return 0;
-		}
-	#endif
-
-	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-
-	if (sock == INVALID_SOCKET)
-	{
-		printf("failed to create outgoing connection socket\n");
-		return 0;
-	}
-
-	#ifndef _WIN32
-		// Set SO_REUSEADDR option
-		int opt = 1;
-
-		if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
-		{
-			perror("setsockopt failed");
-			close_socket(&sock);
-			return 0;
-		}
-	#endif
-
-	//bind socket
-	memset(&Addr, 0, sizeof(struct sockaddr_in));
-	Addr.sin_addr.s_addr = INADDR_ANY;
-	Addr.sin_family = AF_INET;
-	Addr.sin_port = htons(gSrvPort);
-
-	if (bind(sock, (struct sockaddr *)&Addr, sizeof(struct sockaddr_in)) == -1)
-	{
-		printf("failed to bind socket to local udp port (%s)\n", strerror(errno));
-		close_socket(&sock);
-		return 0;
-	}
-
-	*server_sock = sock;
-	return 1;
-}
-
-//runs the server application
-// returns 0 - error occurred
-//returns 1 - user ended session
-static int file_server()
-{
-	fd_set readfds;
-	int ret, rc;
-	uint8_t rxbuf[MAX_RX_BUFF];
-	struct timeval selTimeout;
-	int timeout_ms = 15;
-
-	struct sockaddr_in from;
-
-	memset(&serverCtx, 0, sizeof(serverCtx));
-
-	if(!create_svr_sock(&serverCtx.serverSock))
-		return 0;
-
-	// select will wait on events for x milliseconds
-	selTimeout.tv_sec = (timeout_ms / 1000);
-	selTimeout.tv_usec = ((timeout_ms % 1000) * 1000);
-
-	server_change_state(&serverCtx, SVR_ST_WAIT_FIST_REQUEST);
-
-	printf("server up, waiting for client requests\n");
-
-	while(!gDone)
-	{
-		// Setup socket sock to be monitored for "read events"
-		FD_ZERO(&readfds);
-		FD_SET(serverCtx.serverSock, &readfds);
-
-		ret = select(serverCtx.serverSock + 1, &readfds, NULL, NULL, &selTimeout);
-
-		if (ret > 0)
-		{
-			if (FD_ISSET(serverCtx.serverSock, &readfds))
-			{
-				// Data is available for reading from the socket
-				// call socket receive function here
-				#ifdef _WIN32
-				int addrlen = sizeof(from);
-					rc = recvfrom(serverCtx.serverSock, (char *)rxbuf, sizeof(rxbuf), 0, ((struct sockaddr *)&from), &addrlen);
-				#else
-				socklen_t addrlen = sizeof(from);
-					rc = recvfrom(serverCtx.serverSock, rxbuf, sizeof(rxbuf), 0, ((struct sockaddr *)&from), &addrlen);
-				#endif
-
-				//retieve cleint port number and covert to host byte order
-				serverCtx.client_Port= ntohs(from.sin_port);
-				serverCtx.client_ip = inet_ntoa(from.sin_addr);
-
-				init_receive_pkt(&serverCtx.rxInfo);
-
-				if (rc > 0)
-				{
-					if (receive_tftp_pkt(&serverCtx.rxInfo, rxbuf, rc))
-					{
-						svr_fsm_event(&serverCtx, EV_SVR_PDU_RX);
-					}
-					else
-					{
-						printf("receive_tftp_pkt() returned 0\n");
-					}
-				}
-			}
-		}
-
-		if (UtilTickTimerRun(&serverCtx.tmr1))
-			svr_fsm_event(&serverCtx, EV_SVR_TIMEOUT);
-
-	}
-	svr_close_file_and_sock(&serverCtx);
-	return 1;
-}
-
-// <operating mode> <Server Port Number> <Remote IP Address><Operation> <Filename> <Fsm_debug_on> <DebugDropTxAckOn><max_retransmission_tries> <drop all packes>
-// example: TFTP.exe -m server -p 1234 -r 198.678.0.8 -o putfile -f filename.txt
-int main(int argc, char *argv[])
-{
-	int c, isClient;
-
-	const char * op_mode = NULL;
-	const char* remote_ip_str = NULL;
-	const char * operation_str = NULL;
-	const char* filename = NULL;
-	int Fsm_debug_on = 0;
-	int DebugDropTxPacket = 0;
-
-	static const char *kOptString = "m:p:r:o:f:d:D:M:A:";
-
-	static const struct option kLongOpts[] =
-	{
-		{ "operating mode",  required_argument, NULL, 'm' },
-		{ "Server Port Number",  required_argument, NULL, 'p'},
-		{ "Remote IP Address",  required_argument, NULL, 'r'},
-		{ "Operation",  required_argument, NULL, 'o'},
-		{ "Filename",  required_argument, NULL, 'f'},
-		{ "Fsm_debug_on",  required_argument, NULL, 'd'},
-		{ "DebugDropTxPacket",  required_argument, NULL, 'D'},
-		{"max_retransmission_tries", required_argument, NULL, 'M'},
-		{"drop all packets", required_argument, NULL, 'A'},
-		{ NULL, 0, NULL, 0 }
-	};
-
-	if (argc < 1)
-	{
-		help();
-		return 0;
-	}
-
-	while ((c = getopt_long(argc, argv, kOptString, kLongOpts, NULL)) != -1)
-	{
-		switch (c)
-		{
-			case 'm': op_mode = optarg;break;
-			case 'p': gSrvPort = (uint16_t)atoi(optarg); break;
-			case 'r': remote_ip_str = optarg; break;
-			case 'o' : operation_str = optarg; break;
-			case 'f' : filename = optarg; break;
-			case'd' : Fsm_debug_on = atoi(optarg); break;
-			case 'D' : DebugDropTxPacket = atoi(optarg); break;
-			case 'M' : gMaxNumRetransTries = atoi(optarg); break;
-			case 'A' : gDebugDropAllPks= atoi(optarg); break;
-
-			default : help(); return 0;
-		}
-	}
-
-	isClient = 0;
-
-	if (gSrvPort == 0)
-	{
-		printf("error, invalid port number\n");
-		return 0;
-	}
-
-	if ((strcmp(op_mode, "client") != 0) && (strcmp(op_mode, "server") != 0))
-	{
-		printf("error: invalid operating mode\n");
-		return 0;
-	}
-
-	isClient = (strcmp(op_mode, "client") == 0) ? 1 : 0;
-
-	if ((isClient) && ((strcmp(operation_str, "getfile") != 0) && (strcmp(operation_str, "putfile") != 0)))
-	{
-		printf("error: invalid operation request\n");
-		return 0;
-	}
-
-	if ((isClient == 1) && (strcmp(remote_ip_str, "0.0.0.0") == 0))
-	{
-		printf("error: invalid IP address\n");
-		return 0;
-	}
-
-	#ifdef _WIN32
-		SetConsoleCtrlHandler(signal_handler, TRUE);
-	#else
-		signal(SIGHUP, signal_handler);
-		signal(SIGTERM, signal_handler);
-		signal(SIGINT, signal_handler);
-		signal(SIGQUIT, signal_handler);
-	#endif
-
-	if (Fsm_debug_on > 0)
-		gFsmDebugOn = 1;
-
-	if (DebugDropTxPacket > 0)
-		gDebugDropPacket= 1;
-
-	if (isClient == 0)
-	{
-		file_server();
-	}
-	else
-	{
-		file_client(remote_ip_str,filename, operation_str);
-	}
-
-	return 0;
-}
-
+//
+//TCP command line file transfer program
+//
+
+#define _FILE_OFFSET_BITS 64	//64 bit off_t for files over 2 GB on 32 bit builds
+
+#ifdef __linux__
+	#define _GNU_SOURCE		//recvmmsg, sendmmsg
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <string.h>
+#include <stdlib.h>
+#include "tmr.h"
+#include "evloop.h"
+#include "cache.h"
+#include "iopool.h"
+#include "uring.h"
+#include "writer.h"
+#include "metrics.h"
+#include "impair.h"
+#include "netascii.h"
+#include "digest.h"
+#include <stdbool.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <fcntl.h>
+	#include <errno.h>
+	#include <signal.h>
+	#include <unistd.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <netdb.h>
+	#include <strings.h>
+	#include <sys/resource.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/uio.h>
+	#include <pthread.h>
+	#include <stdatomic.h>
+#endif
+
+#ifdef _WIN32
+#define strcasecmp _stricmp
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+#define PROT_MAX_DATA 			512		//default block size (RFC 1350)
+#define PROT_MIN_BLKSIZE		8		//RFC 2348 block size limits
+#define PROT_MAX_BLKSIZE		65464
+#define DEF_BLKSIZE				1468	//block size offered by the client, fills a 1500 byte MTU
+#define MAX_TX_BUFF				(PROT_MAX_BLKSIZE + 4)
+#define MAX_RX_BUFF				65536
+#define MAX_MODE_BUFF			12
+#define MAX_OPTIONS				8		//options kept from a RRQ/WRQ/OACK
+#define MAX_OPT_LEN				128		//max length of an option name or value
+
+#define DEF_WINDOWSIZE			8		//window size offered by the client
+#define MAX_WINDOWSIZE			64		//default max window size accepted by the server
+
+#define OPT_BLKSIZE				"blksize"
+#define OPT_WINDOWSIZE			"windowsize"
+#define OPT_MULTICAST			"multicast"
+#define OPT_TSIZE				"tsize"
+#define OPT_ROLLOVER			"rollover"	//block number following 65535 (not standardised, used by boot loaders)
+#define OPT_CHECKSUM			"checksum"	//crc32c or sha256 of the data, sent after the last block (not standardised)
+#define OPT_OFFSET				"offset"	//file offset of block 1, resumes a transfer (not standardised)
+#define OPT_OFFSET_SUM			"offsetsum"	//checksum of the RESUME_CHECK_BYTES before the offset (not standardised)
+#define OPT_LENGTH				"length"	//bytes sent from the offset, a byte range of the file (not standardised)
+
+#define RESUME_CHECK_BYTES		(1024 * 1024)	//data before a resume offset compared by checksum
+
+#define MODE_OCTET				"octet"		//files sent as they are
+#define MODE_NETASCII			"netascii"	//text files, CR LF line ends on the wire
+
+#define MCAST_MAX_GROUPS		16		//concurrent multicast transfers, each on its own group port
+#define MCAST_IDLE_SECS			30		//client: a non master client gives up after this long without data
+#define MCAST_BITMAP_SIZE		(65536 / 8)	//one bit per block number
+
+#define ACK_TIMEOUT_SECS			3		//initial and max retransmission timeout
+#define RTO_MIN_MS					10		//lower bound of the measured retransmission timeout
+#define RTO_GRANULARITY_US			1000	//RFC 6298 clock granularity G
+#define RTT_HIST_SUB				16		//histogram buckets per power of two, ~6% resolution
+#define RTT_HIST_BUCKETS			(RTT_HIST_SUB * 30)	//covers any 32 bit microsecond sample
+#define CL_IMPAIR_MCAST				0x10000	//impairment tag of a datagram received on the group socket, the port is below
+#define SEND_DATA_TIMEOUT_SEC		3
+#define PROGRESS_TMR_SEC			3
+#define DEF_TFTP_PORT				69
+
+#define SVR_SESSION_HASH_SIZE		1024	//must be a power of 2
+
+#ifdef __linux__
+	#define SVR_MAX_SESSIONS		65000	//epoll, bounded by RLIMIT_NOFILE
+#else
+	#define SVR_MAX_SESSIONS		(FD_SETSIZE - 8)
+#endif
+
+#define LOOP_MAX_SLEEP_MS			1000	//event loop wakes up at least this often
+
+#define DEF_CACHE_MB				64		//content cache budget, 0 disables the cache
+
+#define SVR_RX_BATCH				32		//datagrams drained from a socket per wakeup
+#define SVR_TX_BATCH				MAX_WINDOWSIZE	//datagrams flushed with one sendmmsg
+#define SVR_TX_COPY_MAX				128		//packets up to this size are copied into the batch
+#define SVR_MAX_WORKERS				256		//server worker threads
+
+#define DEF_IO_THREADS				4		//disk I/O threads, 0 = file I/O inline in the network loop
+#define IO_MAX_WRITES				8		//write jobs in flight per session before its ACKs are held back
+#define DEF_PREFETCH_BLOCKS			32		//blocks of an outgoing file read ahead of the window
+#define MAX_PREFETCH_BLOCKS			4096
+
+#define CL_MAX_STREAMS				64		//client: sessions of a parallel download
+#define CL_MAX_MIRRORS				16		//client: servers a parallel download is spread over
+
+#define URING_ENTRIES				1024	//submission ring of a worker (io_uring engine)
+#define URING_CQ_ENTRIES			8192	//completion ring, multishot receives post many completions per submission
+#define URING_NUM_BUFS				128		//provided receive buffers, must be a power of 2
+#define URING_TX_SLOTS				256		//sends in flight, further packets of a flush are sent with sendmmsg
+
+
+//reading packet machine states
+typedef enum
+{
+	READ_OPT_CODE_1,		//optcode low byte
+	READ_OPT_CODE_2,		//optcode high byte
+	READ_FILENAME,
+	READ_MODE,
+	READ_DATA,
+	READ_BLOCK_NUM_1,
+	READ_BLOCK_NUM_2,
+	READ_ERR_CODE_1,
+	READ_ERR_CODE_2,
+	READ_ERR_MESSAGE
+} prot_st_t;
+
+typedef enum
+{
+	TFTP_RRQ = 1,		// Read Request, getfile
+	TFTP_WRQ  = 2,		// Write Request, putfile
+	TFTP_DATA = 3,		// Data Packet
+	TFTP_ACK = 4,		// Acknowledgment
+	TFTP_ERROR = 5,		// Error Packet
+	TFTP_OACK = 6,		// Option Acknowledgment (RFC 2347)
+	TFTP_DIGEST = 7		// Digest of the data sent (checksum option)
+} tftp_opcode_t;
+
+//option received in a request or option acknowledgment
+typedef struct
+{
+	char name[MAX_OPT_LEN];
+	char value[MAX_OPT_LEN];
+} prot_option_t;
+
+//sliding window of data blocks in flight (RFC 7440)
+//blocks are counted with 64 bit indices, blk_wire gives the block number they carry
+//blocks [base, next) have been sent, blocks [base, filled) are held in buf for retransmission
+//blocks past the window are read into the spare slots ahead of their ACKs (prefetch)
+//a window over a mapped file only keeps the DATA headers, payloads point into the mapping
+typedef struct
+{
+	uint8_t *buf;			//numSlots slots of blksize + 4 bytes, DATA header included
+	uint16_t *len;			//packet length of each slot
+	const uint8_t **data;	//payload of each slot (mapped file)
+	const uint8_t *map;		//file mapping or NULL
+	uint64_t mapLen;
+	uint64_t mapOffset;		//file offset of block 'filled'
+	uint64_t endOffset;		//file offset the data ends at, UINT64_MAX for the end of the file
+	uint16_t blksize;
+	uint16_t windowsize;
+	uint16_t numSlots;		//windowsize plus the blocks read ahead
+	uint16_t baseSlot;		//slot holding block 'base'
+
+	uint64_t base;			//oldest unacknowledged block
+	uint64_t next;			//next block to send
+	uint64_t sent;			//blocks [base, sent) have been sent at least once
+	uint64_t filled;		//next block to read from the file
+	uint64_t reading;		//next block to submit a read for, blocks [filled, reading) are being read (I/O threads)
+	int rollover;			//block number following 65535
+
+	int eof;				//last (short) block has been read
+	uint64_t lastBlock;
+
+	// netascii transfer, the file is read into text and converted into the blocks
+	uint8_t *text;			//blksize bytes of file data, NULL for octet
+	size_t textLen;
+	size_t textPos;			//next byte to convert
+	netascii_t ascii;
+
+	digest_t digest;		//checksum of the blocks read, DIGEST_NONE if not negotiated
+	uint8_t digestPkt[2 + DIGEST_MAX_LEN];	//DIGEST packet, built once the last block was read
+	uint16_t digestPktLen;	//0 until then
+} tx_window_t;
+
+//round trip times of a transfer, log-linear buckets: 1 us wide up to 2 * RTT_HIST_SUB us,
+//then RTT_HIST_SUB buckets per power of two
+typedef struct
+{
+	uint32_t count;
+	uint32_t buckets[RTT_HIST_BUCKETS];
+} rtt_hist_t;
+
+//retransmission timeout estimator (RFC 6298)
+//a measurement runs from sending a packet to receiving the one it provokes (DATA/ACK pair)
+typedef struct
+{
+	uint32_t srtt;			//smoothed round trip time, microseconds
+	uint32_t rttvar;		//round trip time variation, microseconds
+	uint32_t rto;			//retransmission timeout, milliseconds
+	int hasSample;
+
+	int isTiming;			//a measurement is running
+	uint16_t timedBlock;	//block number carried by the timed packet, 0 for RRQ/WRQ/OACK
+	uint64_t tStart;		//microseconds
+
+	rtt_hist_t *hist;		//records every sample, NULL if not recorded
+} rtt_estimator_t;
+
+//result of an ACK applied to the transmit window
+typedef enum
+{
+	TXWIN_IGNORE,			//stale or duplicate ACK
+	TXWIN_SEND,				//window moved or was rewound, send from 'next'
+	TXWIN_DONE,				//last block acknowledged
+} txwin_ack_t;
+
+//recieve protocol structure
+typedef struct
+{
+	uint8_t state;
+
+	uint16_t optcode;
+	uint16_t blocknum;
+	uint16_t errCode;
+
+	uint16_t rxLen;
+
+	const uint8_t *data;	//DATA payload, points into the receive buffer
+	uint16_t dataLen;
+
+	uint8_t filename[PROT_MAX_DATA];
+	uint8_t mode[MAX_MODE_BUFF];
+	uint8_t errMessage[PROT_MAX_DATA];
+
+	prot_option_t options[MAX_OPTIONS];
+	int numOptions;
+
+	uint16_t blksize;	 // negotiated block size, used to detect the last data block
+	int isLastDataBlock; // 1 if id data is less than blksize
+} prot_frame_info_t;
+
+//client session
+typedef struct
+{
+	SOCKET clientSock;
+	SOCKET mcastSock;		//RFC 2090 group socket, INVALID_SOCKET for unicast transfers
+	ev_loop_t ev;			//client and group sockets
+
+	const char* remoteIpStr;
+	uint16_t remotePort;	//69, port to establish session
+	struct sockaddr_in svrAddr;	//server address, its port is the server TID once the first reply arrived
+	int isConnected;		//clientSock is connected to the server TID
+
+	int state;
+	int isOk;				//file transferred completely
+	uint64_t startUs;		//request sent, transfer report
+	uint64_t startCpuUs;
+	rtt_hist_t rttHist;		//round trip times, transfer report
+
+	int isFirstDataBlock;
+
+	tick_timer_t tmr1; //timer waiting for acks or data
+	tick_timer_t tmr2; //timer to print progress
+
+	int num_retrans_tries;
+	rtt_estimator_t rtt;	//adaptive timeout of tmr1
+
+	uint64_t blockNum;				//block index, blk_wire gives the block number
+	uint64_t nextExpectedBlockNum;
+	int rollover;					//block number following 65535, 0 unless negotiated
+
+	prot_frame_info_t rxInfo;
+
+	FILE * pFile;
+	const char* filename;
+
+	uint16_t blksize;	//negotiated block size
+	uint16_t windowsize;	//negotiated window size
+
+	tx_window_t txWin;	//data blocks in flight (PUTFILE session)
+	uint16_t numUnacked;	//blocks received since the last ACK (GETFILE session)
+	int isGapAcked;		//ACK already sent for the current gap in received blocks
+	uint64_t lastRxBlock;	//last DATA block received, in order or not
+
+	// multicast transfer (RFC 2090), blocks arrive in any order
+	int isMcast;
+	int isMaster;			//this client acknowledges the blocks it needs
+	uint8_t *rxMap;			//bitmap of blocks received
+	uint16_t firstMissing;	//lowest block not received yet
+	uint16_t lastBlock;		//last (short) block, 0 until it was received
+	uint64_t fileOffset;	//current write position of pFile
+
+	uint64_t bytesDone;		//file data sent or recieved, progress print
+	uint64_t tsize;			//transfer size (RFC 2349), 0 if unknown
+
+	// checksum of the data, the receiver acknowledges the last block once it matches the sender's
+	int checksum;			//digest_alg_t negotiated, DIGEST_NONE if the server left the option out
+	digest_t rxDigest;		//blocks received (GETFILE session)
+	uint8_t peerDigest[DIGEST_MAX_LEN];	//received DIGEST packet
+	int hasPeerDigest;
+	int isDigestWait;		//last block received, its ACK waits for the DIGEST packet
+
+	// resumed transfer or byte range of a parallel download, block 1 carries the byte at the offset
+	uint64_t offsetAsked;	//offset option sent, 0 if none
+	uint64_t offset;		//offset acknowledged by the server, 0 for the whole file
+	uint64_t rangeLen;		//length of the byte range requested, 0 for the rest of the file
+	int isRangeAcked;		//the server acknowledged offset and length of the range
+	int isProbe;			//only asks for the size of the file (tsize), the transfer ends at the OACK
+
+	// received file written in the background (GETFILE session)
+	file_writer_t writer;
+	io_pool_t io;			//one writer thread, none with -j 0
+	io_done_t ioDone;		//written chunks, polled by the receive path
+	int numIoPending;
+	int isIoError;			//a chunk failed to write
+
+	// simulated network (-N), datagrams pass a delay line in each direction
+	impair_t impairTx;
+	impair_t impairRx;
+	int packetCount;		//datagrams received, debug packet drops
+
+	// file transmit buffer and lenght variables
+	uint8_t txBuf[MAX_TX_BUFF];
+	uint16_t txLen;
+} client_session_t;
+
+//client taking part in a multicast transfer
+typedef struct mcast_member_s
+{
+	struct sockaddr_in addr;
+	int hasBlksize;					//requested the blksize option, acknowledged in its OACKs
+	struct mcast_member_s *next;
+} mcast_member_t;
+
+//multicast transfer (RFC 2090), the file is sent once to a group,
+//one master client at a time acknowledges the blocks it still needs
+typedef struct
+{
+	struct sockaddr_in groupAddr;	//DATA destination
+	int slot;						//group port offset, one per concurrent transfer
+
+	const uint8_t *data;			//file contents (cache entry or mapping)
+	uint64_t size;
+	uint16_t lastBlock;
+
+	mcast_member_t *members;		//first member is the master client
+	int numMembers;
+
+	uint8_t oackBuf[64];			//OACK promoting the master, resent until it ACKs
+	size_t oackLen;
+	int isOackPending;
+} mcast_group_t;
+
+//server session, one per client transfer
+typedef struct server_session_s
+{
+	SOCKET serverSock;		//ephemeral TID socket owned by this session
+
+	struct sockaddr_in clientAddr;		//client address, session table key
+	int isConnected;					//serverSock is connected to clientAddr (unicast transfer)
+
+	// timers
+	wheel_timer_t tmr1; 	//timer waiting for acks or data
+	tick_timer_t tmr2; 		//timer to print progress
+	timer_wheel_t *wheel;	//server timer wheel that tmr1 runs on
+
+	int num_retrans_tries;
+	rtt_estimator_t rtt;	//adaptive timeout of tmr1
+	int state;
+
+	uint64_t blockNum;				//block index, blk_wire gives the block number
+	uint64_t nextExpectedBlockNum;
+	int rollover;					//block number following 65535, 0 unless negotiated
+
+	prot_frame_info_t rxInfo;
+
+	FILE * pFile;
+	const char* filename;
+	uint8_t *map;			//read only mapping of the file served (GETFILE session), only the kernel reads it
+	uint64_t mapLen;
+	int isMapFault;			//a send from the mapping failed, the file was cut while it was served
+	cache_entry_t *cacheEntry;	//cached contents of the file served, used instead of pFile/map
+	mcast_group_t *mcast;		//multicast transfer (GETFILE session), NULL for unicast
+
+	uint16_t blksize;		//negotiated block size
+	uint16_t windowsize;	//negotiated window size
+	int isNetascii;			//netascii mode, text converted to and from CR LF line ends
+
+	tx_window_t txWin;		//data blocks in flight (GETFILE session)
+	uint16_t numUnacked;	//blocks received since the last ACK (PUTFILE session)
+	int isGapAcked;			//ACK already sent for the current gap in received blocks
+	uint64_t lastRxBlock;	//last DATA block received, in order or not
+	uint64_t bytesDone;		//file data sent or recieved, progress print
+	metrics_counters_t stats;	//counters of this transfer, added to the worker totals when it ends
+	uint64_t startMs;		//request received, session throughput
+
+	unsigned ioAffinity;	//I/O thread running the file jobs of the session, keeps them in order
+	int numIoPending;		//file jobs submitted and not completed yet
+	io_job_t *ioJob;		//job completed, valid during EV_SVR_IO_DONE
+	file_writer_t writer;	//received data collected into write jobs (PUTFILE session)
+	uint64_t tsize;			//transfer size (RFC 2349), 0 if unknown
+	int checksum;			//digest_alg_t negotiated, DIGEST_NONE if not requested
+	uint64_t offset;		//file offset of block 1, not 0 when a transfer is resumed
+	uint64_t length;		//bytes sent from the offset (byte range), 0 up to the end of the file
+	digest_t rxDigest;		//blocks received (PUTFILE session)
+	uint8_t peerDigest[DIGEST_MAX_LEN];	//received DIGEST packet (PUTFILE session)
+	int hasPeerDigest;
+	int isAckHeld;			//window ACK waits for the writes to catch up (PUTFILE session)
+	int isClosing;			//transfer over, the session goes once its file jobs and sends completed
+	int isDestroyed;		//removed from the worker, freed after the events of this loop iteration
+	uint64_t ioOffset;		//file offset of the next read job
+	uint64_t adviseEnd;		//file offset the read-ahead hints reach (GETFILE session)
+	io_job_t *ioHeld;		//reads completed ahead of block 'filled' (io_uring engine)
+	unsigned fileSlot;		//fixed file slot of serverSock (io_uring engine)
+	int numTxPending;		//sends submitted and not completed yet (io_uring engine)
+
+	// file transmit buffer and lenght variables
+	uint8_t txBuf[MAX_TX_BUFF];
+	uint16_t txLen;
+
+	struct server_session_s *hashNext;	//next session in the same hash bucket
+	struct server_session_s *next;		//list of all active sessions
+	struct server_session_s *prev;
+	struct server_session_s *destroyedNext;	//list of sessions destroyed in this loop iteration
+	struct server_s *svr;				//server owning this session
+} server_session_t;
+
+//datagrams received from one socket with a single recvmmsg
+typedef struct
+{
+	uint8_t buf[SVR_RX_BATCH][MAX_RX_BUFF];
+	int len[SVR_RX_BATCH];
+	struct sockaddr_in from[SVR_RX_BATCH];
+} rx_batch_t;
+
+//datagrams queued on one socket while a session event runs, sent with a single sendmmsg
+typedef struct
+{
+	SOCKET sock;
+	server_session_t *ctx;				//session owning sock
+	const uint8_t *buf[SVR_TX_BATCH];	//must stay valid until flushed
+	size_t len[SVR_TX_BATCH];
+	uint8_t copy[SVR_TX_BATCH][SVR_TX_COPY_MAX];	//short packets, buf points here
+	const uint8_t *data[SVR_TX_BATCH];	//optional payload sent after buf (mapped file)
+	size_t dataLen[SVR_TX_BATCH];
+	struct sockaddr_in addr[SVR_TX_BATCH];
+	int num;
+} tx_batch_t;
+
+#ifdef URING_SUPPORTED
+//send in flight on the ring, the packet is copied, a payload after it must outlive the session
+typedef struct uring_tx_s
+{
+	struct msghdr msg;
+	struct iovec iov[2];
+	struct sockaddr_in addr;
+	server_session_t *ctx;
+	struct uring_tx_s *next;			//free list
+	uint8_t pkt[MAX_TX_BUFF];
+} uring_tx_t;
+
+//io_uring engine of a worker, sockets sit in fixed file slots, slot 0 is the listening socket
+typedef struct
+{
+	uring_t ring;
+	int isActive;
+	struct msghdr rxMsg;				//multishot recvmsg template, sender address and payload only
+	server_session_t **slotCtx;			//session owning each fixed file slot
+	uint32_t *slotGen;					//bumped when a slot is freed, completions of an older generation are dropped
+	unsigned *freeSlots;
+	unsigned numFreeSlots;
+	unsigned numSlots;
+	uring_tx_t *tx;
+	uring_tx_t *freeTx;
+	int numTxPending;
+} svr_uring_t;
+#endif
+
+//server context, listening socket and table of active sessions
+typedef struct server_s
+{
+	int id;					//worker index
+	SOCKET listenSock;		//well known port (SO_REUSEPORT when there are several workers), receives RRQ/WRQ only
+
+	server_session_t *hashTbl[SVR_SESSION_HASH_SIZE];	//sessions keyed by client (ip, port)
+	server_session_t *sessions;		//list of all active sessions
+	int numSessions;
+	server_session_t *destroyed;	//sessions destroyed, events already returned for them may still be handled
+
+	ev_loop_t ev;					//listening and session sockets
+	timer_wheel_t wheel;			//retransmission timers of all sessions
+	content_cache_t *cache;			//contents of hot files served by GETFILE sessions, shared by all workers
+	io_pool_t *io;					//disk I/O threads, shared by all workers
+	io_done_t ioDone;				//completed file jobs of the sessions of this worker
+	int numIoPending;				//file jobs of this worker not completed yet
+	unsigned ioNext;				//I/O thread affinity of the next session
+	uint32_t mcastSlots;			//group ports of this worker in use by multicast transfers
+
+	prot_frame_info_t rxInfo;		//requests received on the listening socket
+
+	metrics_t *metrics;				//export of the counters, shared by all workers
+	metrics_counters_t stats;		//transfers of this worker that ended
+	metrics_snapshot_t snapshot;	//counters published every METRICS_INTERVAL_MS
+	wheel_timer_t metricsTmr;
+
+	rx_batch_t rxBatch;
+	tx_batch_t txBatch;
+
+#ifdef URING_SUPPORTED
+	svr_uring_t uring;				//io_uring engine, replaces ev and the I/O threads when active
+#endif
+} server_t;
+
+//client protocol machine states
+typedef enum
+{
+	CL_ST_GETFILE_RXDATA,				// Receving normal data (GETFILE session)
+	CL_ST_PUTFILE_TXDATA,				// Sending normal data (PUTFILE session)
+	CL_ST_MCAST_RXDATA,					// Receiving multicast data (GETFILE session)
+}cl_st_t;
+
+//server protocol machine states
+typedef enum
+{
+	SVR_ST_WAIT_FIST_REQUEST,		//wait for getfile or putfile request
+	SVR_ST_GETFILE_TXDATA,				// Sending normal data (GETFILE session)
+	SVR_ST_PUTFILE_RXDATA,				// Recieving normal data (PUTFILE session)
+	SVR_ST_MCAST_TXDATA,				// Sending data to a multicast group (GETFILE session)
+	SVR_ST_PUTFILE_SYNC,				// Last block recieved, waiting for the file writes and the checksum (PUTFILE session)
+}svr_st_t;
+
+//FSM client events
+typedef enum
+{
+	EV_CL_TIMEOUT,			// timeout
+	EV_CL_PDU_RX,			// Full protocol data unit received
+} cl_evt_t;
+
+//FSM server events
+typedef enum
+{
+	EV_SVR_TIMEOUT,				// timeout
+	EV_SVR_PDU_RX,				// Full protocol data unit received
+	EV_SVR_IO_DONE,				// File read or write job completed
+} svr_evt_t;
+
+
+static client_session_t clientCtx;
+
+#ifdef _WIN32
+static volatile int gDone = 0;
+#else
+static atomic_int gDone = 0;	//set by the signal handler, polled by every server worker
+#endif
+static int gFsmDebugOn = 0;
+static int gDebugDropPacket = 0;
+static int gDebugDropAllPks = 0;
+static int gMaxNumRetransTries = 3;
+static uint16_t gSrvPort = DEF_TFTP_PORT;
+static int gBlkSize = -1;	//client: block size to request, 0 = no option; server: max block size
+static int gWindowSize = -1;	//client: window size to request, 1 = no option; server: max window size
+static int gCacheMb = DEF_CACHE_MB;			//server: content cache budget
+static const char *gCacheManifest = NULL;	//server: files loaded into the cache at startup
+static const char *gMcastStr = NULL;		//server: group address:port offered; client: request multicast
+static struct sockaddr_in gMcastAddr;		//server: base group address, sin_family is 0 when not offered
+static const char *gMcastIf = NULL;			//interface address for multicast, default route if NULL
+static int gNumWorkers = 1;					//server: worker threads, each with its own socket, loop and sessions
+static int gNumIoThreads = DEF_IO_THREADS;	//server: disk I/O threads shared by the workers
+static int gUseUring = 0;					//server: io_uring engine instead of epoll and the I/O threads
+static int gDirectIo = 0;					//received files are written with O_DIRECT
+static int gPrefetch = DEF_PREFETCH_BLOCKS;	//server: blocks read ahead of the window of an outgoing file
+static const char *gMetricsPath = NULL;		//server: metrics textfile or unix:<socket path>, NULL = no export
+static const char *gReportPath = NULL;		//client: file the JSON transfer report is appended to, NULL = none
+static const char *gImpairStr = NULL;		//client: simulated network impairment, NULL = none
+static int gRollover = -1;					//client: rollover option to request, -1 = none (block 0 follows 65535)
+static int gNetascii = 0;					//client: transfer in netascii mode instead of octet
+static int gChecksum = DIGEST_NONE;			//client: checksum option to request, digest_alg_t
+static int gResume = 0;						//client: continue a partial download or upload
+static int gStreams = 1;					//client: concurrent sessions a download is split into
+static impair_config_t gImpair;				//client: parsed gImpairStr
+
+//detection of ctrl+c
+#ifdef _WIN32
+	BOOL WINAPI signal_handler(DWORD dwCtrlType)
+	{
+		switch (dwCtrlType)
+		{
+			case CTRL_C_EVENT:
+			case CTRL_BREAK_EVENT:
+			case CTRL_CLOSE_EVENT:
+				gDone = 1;
+				printf("detected Ctrl-C, exiting...\n");
+				return TRUE;
+		}
+
+		return FALSE;
+	}
+#else
+	static void signal_handler(int sig)
+	{
+		switch (sig)
+		{
+			case SIGTERM:
+			case SIGHUP:
+			case SIGINT:
+			case SIGQUIT:
+				gDone= 1;
+				printf("detected Ctrl-C, exiting...\n");
+				break;
+			}
+	}
+#endif
+
+//gets client state name
+//state - client state
+//name - pointer to string buffer that receives the name
+static void client_get_state_name(int state, char *name)
+{
+	switch (state)
+	{
+		case CL_ST_GETFILE_RXDATA:
+			strcpy(name, "CL_ST_GETFILE_RXDATA");
+			break;
+
+		case CL_ST_PUTFILE_TXDATA:
+			strcpy(name, "CL_ST_PUTFILE_TXDATA");
+			break;
+
+		case CL_ST_MCAST_RXDATA:
+			strcpy(name, "CL_ST_MCAST_RXDATA");
+			break;
+
+		default:
+			strcpy(name, "UNKNOWN_ST");
+			break;
+	}
+}
+
+//gets server state name
+//state - server state
+//name - pointer to string buffer that receives the name
+static void server_get_state_name(int state, char *name)
+{
+	switch (state)
+	{
+		case SVR_ST_GETFILE_TXDATA:
+			strcpy(name, "SVR_ST_GETFILE_TXDATA");
+			break;
+
+		case SVR_ST_PUTFILE_RXDATA:
+			strcpy(name, "SVR_ST_PUTFILE_RXDATA");
+			break;
+
+		case SVR_ST_MCAST_TXDATA:
+			strcpy(name, "SVR_ST_MCAST_TXDATA");
+			break;
+
+		case SVR_ST_PUTFILE_SYNC:
+			strcpy(name, "SVR_ST_PUTFILE_SYNC");
+			break;
+
+		case SVR_ST_WAIT_FIST_REQUEST:
+			strcpy(name, "SVR_ST_WAIT_FIST_REQUEST");
+			break;
+
+		default:
+			strcpy(name, "UNKNOWN_ST");
+			break;
+	}
+}
+
+//gets server event name
+//event - server event
+//name - pointer to string buffer that receives the name
+static void server_get_event_name(int event, char *name)
+{
+	switch (event)
+	{
+		case EV_SVR_TIMEOUT:
+			strcpy(name, "EV_SVR_TIMEOUT");
+			break;
+
+		case EV_SVR_PDU_RX:
+			strcpy(name, "EV_SVR_PDU_RX");
+			break;
+
+		case EV_SVR_IO_DONE:
+			strcpy(name, "EV_SVR_IO_DONE");
+			break;
+
+		default:
+			strcpy(name, "UNKNOWN_EV");
+			break;
+	}
+}
+
+//gets client event name
+//event - client event
+//name - pointer to string buffer that receives the name
+static void client_get_event_name(int event, char *name)
+{
+	switch (event)
+	{
+		case EV_CL_TIMEOUT:
+			strcpy(name, "EV_CL_TIMEOUT");
+			break;
+
+		case EV_CL_PDU_RX:
+			strcpy(name, "EV_CL_PDU_RX");
+			break;
+
+		default:
+			strcpy(name, "UNKNOWN_EV");
+			break;
+	}
+}
+
+//changes to a new client state
+//ctx - pointer to client session context
+//newState - state to switch into
+static void client_change_state(client_session_t *ctx, int newState)
+{
+	char stateNameOld[64];
+	char stateNameNew[64];
+
+	if (gFsmDebugOn)
+	{
+		client_get_state_name(ctx->state, stateNameOld);
+		client_get_state_name(newState, stateNameNew);
+
+		printf("%s -> %s\n", stateNameOld, stateNameNew);
+	}
+
+	//change to new state
+	ctx->state = newState;
+}
+
+//changes to a new server state
+//ctx - pointer to server session context
+//newState - state to switch into
+static void server_change_state(server_session_t *ctx, int newState)
+{
+	char stateNameOld[64];
+	char stateNameNew[64];
+
+	if (gFsmDebugOn)
+	{
+		server_get_state_name(ctx->state, stateNameOld);
+		server_get_state_name(newState, stateNameNew);
+
+		printf("%s -> %s\n", stateNameOld, stateNameNew);
+	}
+
+	//change to new state
+	ctx->state = newState;
+}
+
+//send a buffer to a port of the server
+//ctx - pointer to client session context
+//buf - packet to send
+//len - length of packet
+//port - destination port (network order), the server TID or its request port
+// 0 = failed, 1=success
+static int cl_send_raw(client_session_t *ctx, const uint8_t *buf, size_t len, uint16_t port)
+{
+	struct sockaddr_in to = ctx->svrAddr;
+	int rc;
+
+	to.sin_port = port;
+
+	//until the first reply the server is addressed on its request port
+	#ifdef _WIN32
+		if (ctx->isConnected && (port == ctx->svrAddr.sin_port))
+			rc = send(ctx->clientSock, (const char*)buf, (int)len, 0);
+		else
+			rc = sendto(ctx->clientSock, (const char*)buf, (int)len, 0, (struct sockaddr *)&to, sizeof(to));
+	#else
+		if (ctx->isConnected && (port == ctx->svrAddr.sin_port))
+			rc = (int)send(ctx->clientSock, buf, len, 0);
+		else
+			rc = (int)sendto(ctx->clientSock, buf, len, 0, (struct sockaddr *)&to, sizeof(to));
+	#endif
+
+	if (rc < 0)
+	{
+		#ifdef _WIN32
+			int err = WSAGetLastError();
+			printf("sendto failed with error code: %d\n", err);
+		#else
+
+			printf("sendto returns error: rc=%d\n", rc);
+			printf("error code:%d (%s)\n", errno, strerror(errno));
+		#endif
+		return 0;
+	}
+	return 1;
+}
+
+//send a buffer to the server
+//ctx - pointer to client session context
+//buf - packet to send
+//len - length of packet
+// 0 = failed, 1=success
+static int cl_send_buffer(client_session_t *ctx, const uint8_t *buf, size_t len)
+{
+	//the simulated link sends it once it leaves the delay line, a loss looks like a successful send
+	if (gImpairStr != NULL)
+	{
+		ImpairSubmit(&ctx->impairTx, buf, len, ntohs(ctx->svrAddr.sin_port), UtilTimeUs());
+		return 1;
+	}
+
+	return cl_send_raw(ctx, buf, len, ctx->svrAddr.sin_port);
+}
+
+//send the packet buffer to the server
+//ctx - pointer to client session context
+// 0 = failed, 1=success
+static int cl_send_packet_buffer(client_session_t *ctx)
+{
+	return cl_send_buffer(ctx, ctx->txBuf, ctx->txLen);
+}
+
+#ifdef URING_SUPPORTED
+
+#define URING_TAG_RECV				1	//user_data = generation << 32 | fixed file slot << 3 | tag
+#define URING_TAG_SEND				2	//user_data = uring_tx_t pointer | tag
+#define URING_TAG_IO				3	//user_data = io_job_t pointer | tag
+#define URING_TAG_CANCEL			4
+#define URING_TAG_MASK				7
+
+//gets an SQE of the worker ring, submits the prepared ones to make room when the ring is full
+//svr - pointer to server context
+// returns SQE or NULL if the ring stays full
+static struct io_uring_sqe *svr_uring_sqe(server_t *svr)
+{
+	struct io_uring_sqe *sqe = UringGetSqe(&svr->uring.ring);
+
+	if (sqe == NULL)
+	{
+		UringSubmit(&svr->uring.ring);
+		sqe = UringGetSqe(&svr->uring.ring);
+	}
+
+	return sqe;
+}
+
+//queues the datagrams of the transmit batch as linked sendmsg operations on the ring
+//the link keeps the window in order, the whole batch is queued or none of it
+//they are submitted together with everything else prepared before the loop waits again
+//svr - pointer to server context
+// returns number of datagrams queued, 0 leaves the whole batch to the caller
+static int svr_uring_send(server_t *svr)
+{
+	tx_batch_t *b = &svr->txBatch;
+	struct io_uring_sqe *sqe;
+	uring_tx_t *tx;
+	int i;
+
+	for (i = 0, tx = svr->uring.freeTx; (i < b->num) && (tx != NULL); i++)
+		tx = tx->next;
+
+	if (i < b->num)
+		return 0;
+
+	if (UringSqSpace(&svr->uring.ring) < (unsigned)b->num)
+	{
+		UringSubmit(&svr->uring.ring);
+
+		if (UringSqSpace(&svr->uring.ring) < (unsigned)b->num)
+			return 0;
+	}
+
+	for (i = 0; i < b->num; i++)
+	{
+		tx = svr->uring.freeTx;
+		sqe = UringGetSqe(&svr->uring.ring);
+		svr->uring.freeTx = tx->next;
+
+		//headers and packets built in reused buffers are copied, a payload from the mapping or cache is not
+		memcpy(tx->pkt, b->buf[i], b->len[i]);
+		tx->addr = b->addr[i];
+		tx->iov[0].iov_base = tx->pkt;
+		tx->iov[0].iov_len = b->len[i];
+		tx->iov[1].iov_base = (void *)b->data[i];
+		tx->iov[1].iov_len = b->dataLen[i];
+		tx->msg.msg_name = (tx->addr.sin_family != AF_UNSPEC) ? &tx->addr : NULL;
+		tx->msg.msg_namelen = (tx->addr.sin_family != AF_UNSPEC) ? sizeof(tx->addr) : 0;
+		tx->msg.msg_iov = tx->iov;
+		tx->msg.msg_iovlen = (b->dataLen[i] > 0) ? 2 : 1;
+		tx->ctx = b->ctx;
+
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = (int)b->ctx->fileSlot;
+		sqe->flags = IOSQE_FIXED_FILE | ((i + 1 < b->num) ? IOSQE_IO_LINK : 0);
+		sqe->addr = (uint64_t)(uintptr_t)&tx->msg;
+		sqe->len = 1;
+		sqe->user_data = (uint64_t)(uintptr_t)tx | URING_TAG_SEND;
+
+		b->ctx->numTxPending++;
+		svr->uring.numTxPending++;
+	}
+
+	return i;
+}
+
+#endif // URING_SUPPORTED
+
+//sends all datagrams queued by svr_send_buffer
+//svr - pointer to server context
+// 0 = failed, 1=success
+static int svr_flush_tx(server_t *svr)
+{
+	tx_batch_t *b = &svr->txBatch;
+	int i, rc = 0;
+#ifdef __linux__
+	struct mmsghdr msgs[SVR_TX_BATCH];
+	struct iovec iov[2 * SVR_TX_BATCH];	//DATA header and payload
+	int sent;
+#elif !defined(_WIN32)
+	struct msghdr msg;
+	struct iovec iov[2];
+#endif
+
+	if (b->num == 0)
+		return 1;
+
+#ifdef URING_SUPPORTED
+	if (svr->uring.isActive)
+	{
+		if (svr_uring_send(svr) == b->num)
+		{
+			b->num = 0;
+			return 1;
+		}
+
+		//sends of earlier batches still prepared on the ring go out before this one
+		UringSubmit(&svr->uring.ring);
+	}
+#endif
+
+#ifdef __linux__
+	memset(msgs, 0, sizeof(msgs[0]) * b->num);
+
+	for (i = 0; i < b->num; i++)
+	{
+		iov[2 * i].iov_base = (void *)b->buf[i];
+		iov[2 * i].iov_len = b->len[i];
+		iov[2 * i + 1].iov_base = (void *)b->data[i];
+		iov[2 * i + 1].iov_len = b->dataLen[i];
+		if (b->addr[i].sin_family != AF_UNSPEC)
+		{
+			msgs[i].msg_hdr.msg_name = &b->addr[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(b->addr[i]);
+		}
+
+		msgs[i].msg_hdr.msg_iov = &iov[2 * i];
+		msgs[i].msg_hdr.msg_iovlen = (b->dataLen[i] > 0) ? 2 : 1;
+	}
+
+	//sendmmsg may stop early, e.g. when the socket buffer is full
+	sent = 0;
+
+	while (sent < b->num)
+	{
+		rc = sendmmsg(b->sock, &msgs[sent], (unsigned int)(b->num - sent), 0);
+
+		if (rc <= 0)
+			break;
+
+		sent += rc;
+	}
+
+	if (sent < b->num)
+	{
+		printf("sendmmsg returns error: rc=%d (%s)\n", rc, strerror(errno));
+
+		//the payload of a packet is in a mapping that no longer covers it
+		if ((rc < 0) && (errno == EFAULT) && (b->ctx != NULL))
+			b->ctx->isMapFault = 1;
+	}
+
+	rc = (sent == b->num);
+#else
+	rc = 1;
+
+	for (i = 0; i < b->num; i++)
+	{
+	#ifdef _WIN32
+		if (((b->addr[i].sin_family != AF_UNSPEC) ?
+			sendto(b->sock, (const char*)b->buf[i], (int)b->len[i], 0, (struct sockaddr *)&b->addr[i], sizeof(b->addr[i])) :
+			send(b->sock, (const char*)b->buf[i], (int)b->len[i], 0)) < 0)
+	#else
+		memset(&msg, 0, sizeof(msg));
+		iov[0].iov_base = (void *)b->buf[i];
+		iov[0].iov_len = b->len[i];
+		iov[1].iov_base = (void *)b->data[i];
+		iov[1].iov_len = b->dataLen[i];
+		if (b->addr[i].sin_family != AF_UNSPEC)
+		{
+			msg.msg_name = &b->addr[i];
+			msg.msg_namelen = sizeof(b->addr[i]);
+		}
+
+		msg.msg_iov = iov;
+		msg.msg_iovlen = (b->dataLen[i] > 0) ? 2 : 1;
+
+		if (sendmsg(b->sock, &msg, 0) < 0)
+	#endif
+		{
+			printf("sendto returns error\n");
+			rc = 0;
+
+		#ifndef _WIN32
+			if ((errno == EFAULT) && (b->ctx != NULL))
+				b->ctx->isMapFault = 1;
+		#endif
+		}
+	}
+#endif
+
+	b->num = 0;
+	return rc;
+}
+
+//queues a packet on the session socket, sent by svr_flush_tx once the session event completes
+//ctx - pointer to server session context
+//to - destination address, NULL for the peer of a connected socket
+//buf - packet (or packet header) to send, copied when short, otherwise must not change until flushed
+//len - length of buf
+//data - payload sent after buf without being copied, NULL if none
+//dataLen - length of data
+// 0 = failed, 1=success
+static int svr_send_iov_to(server_session_t *ctx, const struct sockaddr_in *to, const uint8_t *buf, size_t len, const uint8_t *data, size_t dataLen)
+{
+	tx_batch_t *b = &ctx->svr->txBatch;
+
+	//a batch holds the packets of one socket
+	if ((b->num == SVR_TX_BATCH) || ((b->num > 0) && (b->sock != ctx->serverSock)))
+		svr_flush_tx(ctx->svr);
+
+	//headers, ACKs and OACKs are built in buffers that are reused before the flush
+	if (len <= SVR_TX_COPY_MAX)
+	{
+		memcpy(b->copy[b->num], buf, len);
+		buf = b->copy[b->num];
+	}
+
+	b->sock = ctx->serverSock;
+	b->ctx = ctx;
+	b->buf[b->num] = buf;
+	b->len[b->num] = len;
+	b->data[b->num] = data;
+	b->dataLen[b->num] = (data != NULL) ? dataLen : 0;
+	b->num++;
+
+	//an unset destination is sent without an address
+	if (to != NULL)
+		b->addr[b->num - 1] = *to;
+	else
+		b->addr[b->num - 1].sin_family = AF_UNSPEC;
+
+	return 1;
+}
+
+//queues a packet to the client, sent by svr_flush_tx once the session event completes
+//ctx - pointer to server session context
+//buf - packet (or packet header) to send
+//len - length of buf
+//data - payload sent after buf without being copied, NULL if none
+//dataLen - length of data
+// 0 = failed, 1=success
+static int svr_send_iov(server_session_t *ctx, const uint8_t *buf, size_t len, const uint8_t *data, size_t dataLen)
+{
+	return svr_send_iov_to(ctx, (ctx->isConnected) ? NULL : &ctx->clientAddr, buf, len, data, dataLen);
+}
+
+//queues a buffer to the client, sent by svr_flush_tx once the session event completes
+//ctx - pointer to server session context
+//buf - packet to send, must not change until flushed
+//len - length of packet
+// 0 = failed, 1=success
+static int svr_send_buffer(server_session_t *ctx, const uint8_t *buf, size_t len)
+{
+	return svr_send_iov(ctx, buf, len, NULL, 0);
+}
+
+//send the packet buffer to the client
+//ctx - pointer to server session context
+// 0 = failed, 1=success
+static int svr_send_packet_buffer(server_session_t *ctx)
+{
+	return svr_send_buffer(ctx, ctx->txBuf, ctx->txLen);
+}
+
+//initiates recieve protocol
+// pf - pointer to protolcol packet structure
+static void init_receive_pkt(prot_frame_info_t *pf)
+{
+	pf->state = READ_OPT_CODE_1;
+	pf->rxLen = 0;
+}
+
+//copies a NUL terminated string out of a received packet
+//pktBuf - pointer to buffer contating the recieved packet
+//pktBufLen - length of recieved buffer
+//n - read position, advanced past the terminating NUL
+//dst - destination buffer
+//dstSize - size of destination buffer
+// Returns 1=success, 0=string not terminated inside the packet or too long
+static int read_pkt_string(const uint8_t *pktBuf, int pktBufLen, int *n, uint8_t *dst, int dstSize)
+{
+	const uint8_t *end;
+	int len;
+
+	if (*n >= pktBufLen)
+		return 0;
+
+	end = memchr(&pktBuf[*n], 0x00, (size_t)(pktBufLen - *n));
+
+	if (end == NULL)
+		return 0;
+
+	len = (int)(end - &pktBuf[*n]);
+
+	if (len >= dstSize)
+		return 0;
+
+	memcpy(dst, &pktBuf[*n], (size_t)len + 1);
+	*n += len + 1;
+	return 1;
+}
+
+//reads the option name/value pairs following a RRQ/WRQ or an OACK opcode
+//pf - pointer to protolcol packet structure
+//pktBuf - pointer to buffer contating the recieved packet
+//pktBufLen - length of recieved buffer
+//n - read position of the first option
+// Returns 1=success, 0=failed (malformed option)
+static int read_pkt_options(prot_frame_info_t *pf, const uint8_t *pktBuf, int pktBufLen, int n)
+{
+	prot_option_t *opt;
+
+	pf->numOptions = 0;
+
+	while ((n < pktBufLen) && (pf->numOptions < MAX_OPTIONS))
+	{
+		opt = &pf->options[pf->numOptions];
+
+		if (!read_pkt_string(pktBuf, pktBufLen, &n, (uint8_t*)opt->name, MAX_OPT_LEN))
+			return 0;
+
+		if (!read_pkt_string(pktBuf, pktBufLen, &n, (uint8_t*)opt->value, MAX_OPT_LEN))
+			return 0;
+
+		pf->numOptions++;
+	}
+
+	return 1;
+}
+
+//looks up an option of a received RRQ/WRQ or OACK
+//pf - pointer to protolcol packet structure
+//name - option name, case insensitive
+// Returns option value, NULL if the option was not received
+static const char *prot_get_option(const prot_frame_info_t *pf, const char *name)
+{
+	int i;
+
+	for (i = 0; i < pf->numOptions; i++)
+	{
+		if (strcasecmp(pf->options[i].name, name) == 0)
+			return pf->options[i].value;
+	}
+
+	return NULL;
+}
+
+//keeps the digest of a received DIGEST packet
+//pf - pointer to the parsed DIGEST packet
+//alg - negotiated checksum
+//digest - DIGEST_MAX_LEN bytes
+// returns 1=digest of the negotiated length, 0=invalid
+static int prot_get_digest(const prot_frame_info_t *pf, int alg, uint8_t *digest)
+{
+	if ((alg == DIGEST_NONE) || (pf->dataLen != DigestLen(alg)))
+		return 0;
+
+	memcpy(digest, pf->data, pf->dataLen);
+	return 1;
+}
+
+//completes the digest of the received data and compares it with the one the sender computed
+//d - digest of the blocks received
+//peer - digest of the DIGEST packet
+//filename - file transferred, printed
+// returns 1=match, 0=mismatch
+static int prot_verify_digest(digest_t *d, const uint8_t *peer, const char *filename)
+{
+	uint8_t digest[DIGEST_MAX_LEN];
+	char hex[2 * DIGEST_MAX_LEN + 1];
+	char peerHex[2 * DIGEST_MAX_LEN + 1];
+	const char *name = DigestName(d->alg);
+	size_t len = DigestFinal(d, digest);
+
+	DigestHex(digest, len, hex);
+
+	if (memcmp(digest, peer, len) != 0)
+	{
+		DigestHex(peer, len, peerHex);
+		printf("error: %s checksum mismatch, %s received %s, sent %s\n", filename, name, hex, peerHex);
+		return 0;
+	}
+
+	printf("%s %s %s verified\n", filename, name, hex);
+	return 1;
+}
+
+//checksum of the data just before a resume offset, RESUME_CHECK_BYTES or less
+//a partial file that is damaged or from another version of the file shows at its end
+//pFile - file, read if data is NULL
+//data - file contents (cache entry or mapping), NULL to read pFile
+//offset - resume offset
+//alg - checksum algorithm
+//hex - 2 * DIGEST_MAX_LEN + 1 bytes
+// returns 1=success, 0=read error or out of memory
+static int resume_digest(FILE *pFile, const uint8_t *data, uint64_t offset, int alg, char *hex)
+{
+	uint64_t start = (offset > RESUME_CHECK_BYTES) ? offset - RESUME_CHECK_BYTES : 0;
+	size_t len = (size_t)(offset - start);
+	uint8_t digest[DIGEST_MAX_LEN];
+	uint8_t *buf = NULL;
+	digest_t d;
+
+	if (data != NULL)
+	{
+		data = &data[start];
+	}
+	else
+	{
+		buf = malloc(RESUME_CHECK_BYTES);
+
+		if ((buf == NULL) || (fseeko(pFile, (off_t)start, SEEK_SET) != 0) || (fread(buf, 1, len, pFile) != len))
+		{
+			free(buf);
+			return 0;
+		}
+
+		data = buf;
+	}
+
+	DigestInit(&d, alg);
+	DigestUpdate(&d, data, len);
+	DigestHex(digest, DigestFinal(&d, digest), hex);
+
+	free(buf);
+	return 1;
+}
+
+//appends an option name/value pair to a packet buffer
+//buf - packet buffer
+//n - current length of packet
+//name - option name
+//value - option value
+// Returns new length of packet
+static size_t prot_put_option(uint8_t *buf, size_t n, const char *name, const char *value)
+{
+	size_t len;
+
+	len = strlen(name) + 1;
+	memcpy(&buf[n], name, len);
+	n += len;
+
+	len = strlen(value) + 1;
+	memcpy(&buf[n], value, len);
+	n += len;
+
+	return n;
+}
+
+//reads a 16 bit big endian field from a received packet
+static uint16_t read_pkt_u16(const uint8_t *pktBuf, int n)
+{
+	return (uint16_t)((pktBuf[n] << 8) | pktBuf[n + 1]);
+}
+
+// parces recieved packet and fills out prot_frame_info_t structure
+// DATA payload is not copied, pf->data points into pktBuf which must outlive the FSM event
+// pf - pointer to protolcol packet structure
+// pktBuf - pointer to buffer contating the recieved packet
+// pktBufLen - length of recieved buffer
+// Returns 1=success, 0=failed (malformed packet)
+static int receive_tftp_pkt(prot_frame_info_t *pf, const uint8_t *pktBuf, int pktBufLen)
+{
+	int dataLen;
+	int n =0;
+	const uint8_t *end;
+
+	if (pktBufLen < 4)
+		return 0;
+
+	if (pktBuf[n++] != 0)
+		return 0;
+
+	pf->optcode = (uint16_t)pktBuf[n++];
+
+	switch (pf->optcode)
+	{
+	case TFTP_DATA:
+		pf->blocknum = read_pkt_u16(pktBuf, n);
+		n += 2;
+
+		dataLen = pktBufLen -4;
+
+		if (dataLen > pf->blksize)
+			return 0;
+
+		if (dataLen < pf->blksize)
+			pf->isLastDataBlock = 1;
+		else
+			pf->isLastDataBlock = 0;
+
+		pf->data = &pktBuf[n];
+		pf->dataLen = (uint16_t)dataLen;
+		break;
+
+	case TFTP_ACK:
+		pf->blocknum = read_pkt_u16(pktBuf, n);
+		break;
+
+	case TFTP_RRQ:
+	case TFTP_WRQ:
+		if (!read_pkt_string(pktBuf, pktBufLen, &n, pf->filename, PROT_MAX_DATA))
+			return 0;
+
+		if (!read_pkt_string(pktBuf, pktBufLen, &n, pf->mode, MAX_MODE_BUFF))
+			return 0;
+
+		if (!read_pkt_options(pf, pktBuf, pktBufLen, n))
+			return 0;
+		break;
+
+	case TFTP_OACK:
+		if (!read_pkt_options(pf, pktBuf, pktBufLen, n))
+			return 0;
+		break;
+
+	case TFTP_DIGEST:
+		dataLen = pktBufLen - 2;
+
+		if (dataLen > DIGEST_MAX_LEN)
+			return 0;
+
+		pf->data = &pktBuf[n];
+		pf->dataLen = (uint16_t)dataLen;
+		break;
+
+	case TFTP_ERROR:
+		pf->errCode = read_pkt_u16(pktBuf, n);
+		n += 2;
+
+		//message ends at its NUL, a peer that left it out is cut at the end of the packet
+		end = memchr(&pktBuf[n], 0x00, (size_t)(pktBufLen - n));
+		dataLen = (end != NULL) ? (int)(end - &pktBuf[n]) : (pktBufLen - n);
+
+		if (dataLen > (PROT_MAX_DATA - 1))
+			dataLen = PROT_MAX_DATA - 1;
+
+		memcpy(pf->errMessage, &pktBuf[n], (size_t)dataLen);
+		pf->errMessage[dataLen] = 0x00;
+		break;
+
+	default:
+		return 0;
+	}
+
+	pf->rxLen =(uint16_t)pktBufLen;
+	return 1;
+}
+
+//block number carried by a block index
+//index - 64 bit block index, block 1 is the first DATA block
+//rollover - block number following 65535: 0 (default) or 1
+static uint16_t blk_wire(uint64_t index, int rollover)
+{
+	if ((rollover == 0) || (index <= 65535))
+		return (uint16_t)index;
+
+	return (uint16_t)(((index - 1) % 65535) + 1);
+}
+
+//block index of a received block number, the one within half a cycle of a reference index
+//ref - index the block is expected near, e.g. the next block expected
+//block - block number received
+//rollover - block number following 65535: 0 (default) or 1
+static uint64_t blk_index(uint64_t ref, uint16_t block, int rollover)
+{
+	uint32_t cycle = (rollover == 0) ? 65536 : 65535;
+	uint32_t ahead, back;
+
+	if (rollover == 0)
+	{
+		ahead = (uint16_t)(block - (uint16_t)ref);
+	}
+	else
+	{
+		//block 0 is used once, by the ACK of the request or OACK
+		if (block == 0)
+			return 0;
+
+		if (ref == 0)
+			return block;
+
+		ahead = ((uint32_t)block + cycle - blk_wire(ref, rollover)) % cycle;
+	}
+
+	back = cycle - ahead;
+
+	if ((ahead >= cycle / 2) && ((ref > back) || ((rollover == 0) && (ref == back))))
+		return ref - back;
+
+	return ref + ahead;
+}
+
+//frees the transmit window
+//w - pointer to transmit window
+static void txwin_free(tx_window_t *w)
+{
+	free(w->buf);
+	free(w->len);
+	free((void *)w->data);
+	free(w->text);
+	w->buf = NULL;
+	w->len = NULL;
+	w->data = NULL;
+	w->text = NULL;
+}
+
+//allocates the transmit window, first block sent is block 1
+//w - pointer to transmit window
+//blksize - negotiated block size
+//windowsize - negotiated window size
+//prefetch - blocks read ahead of the window
+//rollover - block number following 65535
+// returns 1=success, 0=out of memory
+static int txwin_init(tx_window_t *w, uint16_t blksize, uint16_t windowsize, unsigned prefetch, int rollover, const uint8_t *map, uint64_t mapLen)
+{
+	unsigned numSlots = windowsize + prefetch;
+
+	memset(w, 0, sizeof(*w));
+
+	//slot indices are 16 bit
+	if (numSlots > 65535)
+		numSlots = 65535;
+
+	w->map = map;
+	w->mapLen = mapLen;
+	w->endOffset = UINT64_MAX;
+
+	//a mapped file needs room for the DATA headers only
+	w->buf = malloc((size_t)numSlots * ((map != NULL) ? 4 : (blksize + 4)));
+	w->len = calloc(numSlots, sizeof(uint16_t));
+
+	if (map != NULL)
+		w->data = calloc(numSlots, sizeof(w->data[0]));
+
+	if ((w->buf == NULL) || (w->len == NULL) || ((map != NULL) && (w->data == NULL)))
+	{
+		txwin_free(w);
+		return 0;
+	}
+
+	w->blksize = blksize;
+	w->windowsize = windowsize;
+	w->numSlots = (uint16_t)numSlots;
+	w->rollover = rollover;
+	w->base = 1;
+	w->next = 1;
+	w->sent = 1;
+	w->filled = 1;
+	w->reading = 1;
+
+	return 1;
+}
+
+//sends the file of the window in netascii mode, blocks are read through the encoder
+//w - pointer to transmit window, not over a mapped file
+// returns 1=success, 0=out of memory
+static int txwin_set_netascii(tx_window_t *w)
+{
+	w->text = malloc(w->blksize);
+
+	if (w->text == NULL)
+		return 0;
+
+	w->textLen = 0;
+	w->textPos = 0;
+	NetasciiInit(&w->ascii);
+
+	return 1;
+}
+
+//gets the slot holding a block of the window
+//w - pointer to transmit window
+//block - block number, must be in [base, filled]
+// returns pointer to DATA packet of the block
+static uint8_t *txwin_slot(tx_window_t *w, uint64_t block, uint16_t **len)
+{
+	unsigned slot = (w->baseSlot + (unsigned)(block - w->base)) % w->numSlots;
+
+	*len = &w->len[slot];
+	return &w->buf[slot * ((w->map != NULL) ? 4 : ((size_t)w->blksize + 4))];
+}
+
+//gets the payload of a block sent from a mapped file
+//w - pointer to transmit window
+//block - block number, must be in [base, filled]
+// returns pointer into the mapping, NULL if the payload is held in the slot
+static const uint8_t *txwin_slot_data(tx_window_t *w, uint64_t block)
+{
+	if (w->map == NULL)
+		return NULL;
+
+	return w->data[(w->baseSlot + (unsigned)(block - w->base)) % w->numSlots];
+}
+
+//checks if the window has a block to send and room to send it
+//w - pointer to transmit window
+static int txwin_can_send(const tx_window_t *w)
+{
+	if ((w->next - w->base) >= w->windowsize)
+		return 0;
+
+	//everything up to the last block has been sent
+	if (w->eof && (w->next == w->filled))
+		return 0;
+
+	return 1;
+}
+
+//completes the slot of block 'filled' once its payload is in place
+//w - pointer to transmit window
+//bytesRead - payload length
+// returns payload length, bytesRead cut at the end of a byte range
+static size_t txwin_fill_block(tx_window_t *w, size_t bytesRead)
+{
+	uint16_t *len;
+	uint8_t *pkt = txwin_slot(w, w->filled, &len);
+	const uint8_t *data = txwin_slot_data(w, w->filled);
+	uint16_t block = blk_wire(w->filled, w->rollover);
+
+	if (bytesRead > w->endOffset - w->mapOffset)
+		bytesRead = (size_t)(w->endOffset - w->mapOffset);
+
+	//blocks are filled in order, the checksum is computed as they come in
+	DigestUpdate(&w->digest, (data != NULL) ? data : &pkt[4], bytesRead);
+
+	pkt[0] = 0x00;
+	pkt[1] = TFTP_DATA;
+	pkt[2] = (uint8_t)((block >> 8) & 0xff);
+	pkt[3] = (uint8_t)(block & 0xff);
+
+	*len = (uint16_t)(4 + bytesRead);
+	w->mapOffset += bytesRead;
+
+	// a block shorter than blksize (possibly empty) ends the transfer
+	if (bytesRead < w->blksize)
+	{
+		w->eof = 1;
+		w->lastBlock = w->filled;
+
+		if (w->digest.alg != DIGEST_NONE)
+		{
+			w->digestPkt[0] = 0x00;
+			w->digestPkt[1] = TFTP_DIGEST;
+			w->digestPktLen = (uint16_t)(2 + DigestFinal(&w->digest, &w->digestPkt[2]));
+		}
+	}
+
+	w->filled++;
+	return bytesRead;
+}
+
+//reads file data and converts it to netascii until a block is full
+//w - pointer to transmit window
+//pFile - file being sent
+//dst - payload of the block
+// returns number of data bytes, less than blksize at the end of the file
+static size_t txwin_read_netascii(tx_window_t *w, FILE *pFile, uint8_t *dst)
+{
+	size_t n = 0;
+	size_t used;
+
+	while (n < w->blksize)
+	{
+		//a pair split by the end of the last block is completed without reading
+		if ((w->textPos == w->textLen) && !w->ascii.hasCarry)
+		{
+			w->textLen = fread(w->text, 1, w->blksize, pFile);
+			w->textPos = 0;
+
+			if (w->textLen == 0)
+				break;
+		}
+
+		n += NetasciiEncode(&w->ascii, &w->text[w->textPos], w->textLen - w->textPos, &used, &dst[n], w->blksize - n);
+		w->textPos += used;
+	}
+
+	return n;
+}
+
+//reads the next block from the file into its window slot
+//w - pointer to transmit window
+//pFile - file being sent
+// returns number of data bytes read, -1 on read error
+static int txwin_read_block(tx_window_t *w, FILE *pFile)
+{
+	uint16_t *len;
+	uint8_t *pkt = txwin_slot(w, w->filled, &len);
+	size_t bytesRead;
+
+	if (w->map != NULL)
+	{
+		//no copy, the payload is sent straight from the mapping
+		bytesRead = w->blksize;
+
+		if (bytesRead > (w->mapLen - w->mapOffset))
+			bytesRead = (size_t)(w->mapLen - w->mapOffset);
+
+		w->data[(w->baseSlot + (unsigned)(w->filled - w->base)) % w->numSlots] = &w->map[w->mapOffset];
+	}
+	else
+	{
+		if (w->text != NULL)
+			bytesRead = txwin_read_netascii(w, pFile, &pkt[4]);
+		else
+			bytesRead = fread(&pkt[4], 1, w->blksize, pFile);
+
+		if ((bytesRead < w->blksize) && ferror(pFile))
+			return -1;
+	}
+
+	return (int)txwin_fill_block(w, bytesRead);
+}
+
+//applies a received ACK to the transmit window
+//w - pointer to transmit window
+//ack - acknowledged block number
+// returns txwin_ack_t
+static int txwin_ack(tx_window_t *w, uint16_t ack)
+{
+	uint64_t acked = blk_index(w->base - 1, ack, w->rollover);
+	uint64_t inFlight = w->next - w->base;
+	uint64_t numAcked;
+
+	//an ACK from before the window or of blocks not sent yet
+	if ((acked < w->base - 1) || ((acked - (w->base - 1)) > inFlight))
+		return TXWIN_IGNORE;
+
+	numAcked = acked - (w->base - 1);
+
+	//RFC 1123: never retransmit on a duplicate ACK in lock-step mode (Sorcerer's Apprentice)
+	if ((numAcked == 0) && (inFlight > 0) && (w->windowsize == 1))
+		return TXWIN_IGNORE;
+
+	w->base += numAcked;
+	w->baseSlot = (uint16_t)((w->baseSlot + numAcked) % w->numSlots);
+
+	if (w->eof && (numAcked > 0) && (acked == w->lastBlock))
+		return TXWIN_DONE;
+
+	//RFC 7440: an ACK short of the window end reports lost blocks, go back to the first missing one
+	w->next = w->base;
+
+	return TXWIN_SEND;
+}
+
+//bucket of a round trip time
+//us - sample in microseconds
+static int rtt_hist_index(uint32_t us)
+{
+	int e = 0;
+
+	while ((us >> e) >= 2 * RTT_HIST_SUB)
+		e++;
+
+	return (e * RTT_HIST_SUB) + (int)(us >> e);
+}
+
+//lowest round trip time of a bucket, the inverse of rtt_hist_index
+//i - bucket index
+static uint32_t rtt_hist_value(int i)
+{
+	int e = (i < 2 * RTT_HIST_SUB) ? 0 : (i / RTT_HIST_SUB) - 1;
+
+	return (uint32_t)(i - (e * RTT_HIST_SUB)) << e;
+}
+
+//round trip time below which a share of the samples fall
+//h - pointer to histogram
+//percent - 1..100
+// returns microseconds, 0 if there are no samples
+static uint32_t rtt_hist_percentile(const rtt_hist_t *h, int percent)
+{
+	uint64_t rank = ((uint64_t)h->count * (uint64_t)percent + 99) / 100;
+	uint64_t seen = 0;
+	int i;
+
+	if (h->count == 0)
+		return 0;
+
+	for (i = 0; i < RTT_HIST_BUCKETS; i++)
+	{
+		seen += h->buckets[i];
+
+		if (seen >= rank)
+			return rtt_hist_value(i);
+	}
+
+	return rtt_hist_value(RTT_HIST_BUCKETS - 1);
+}
+
+//initialises the estimator, the timeout stays at ACK_TIMEOUT_SECS until the first measurement
+//r - pointer to rtt estimator
+static void rtt_init(rtt_estimator_t *r)
+{
+	memset(r, 0, sizeof(*r));
+	r->rto = ACK_TIMEOUT_SECS * 1000;
+}
+
+//starts a measurement unless one is already running
+//r - pointer to rtt estimator
+//block - block number carried by the packet just sent
+static void rtt_start(rtt_estimator_t *r, uint16_t block)
+{
+	if (r->isTiming)
+		return;
+
+	r->isTiming = 1;
+	r->timedBlock = block;
+	r->tStart = UtilTimeUs();
+}
+
+//abandons the running measurement, Karn's rule: a retransmission makes the next response ambiguous
+//r - pointer to rtt estimator
+static void rtt_cancel(rtt_estimator_t *r)
+{
+	r->isTiming = 0;
+}
+
+//takes a sample when the expected response arrives and derives a new timeout
+//r - pointer to rtt estimator
+//block - block number the response answers: the block of an ACK, the block of a DATA - 1, 0 for an OACK
+static void rtt_sample(rtt_estimator_t *r, uint16_t block)
+{
+	uint32_t rtt, delta;
+	uint64_t rto;
+
+	if ((!r->isTiming) || (block != r->timedBlock))
+		return;
+
+	r->isTiming = 0;
+	rtt = (uint32_t)(UtilTimeUs() - r->tStart);
+
+	if (r->hist != NULL)
+	{
+		r->hist->buckets[rtt_hist_index(rtt)]++;
+		r->hist->count++;
+	}
+
+	if (!r->hasSample)
+	{
+		r->srtt = rtt;
+		r->rttvar = rtt / 2;
+		r->hasSample = 1;
+	}
+	else
+	{
+		delta = (r->srtt > rtt) ? (r->srtt - rtt) : (rtt - r->srtt);
+		r->rttvar = r->rttvar - (r->rttvar / 4) + (delta / 4);
+		r->srtt = r->srtt - (r->srtt / 8) + (rtt / 8);
+	}
+
+	rto = (uint64_t)r->srtt + ((4 * (uint64_t)r->rttvar > RTO_GRANULARITY_US) ? 4 * (uint64_t)r->rttvar : RTO_GRANULARITY_US);
+	rto = (rto + 999) / 1000;
+
+	if (rto < RTO_MIN_MS)
+		rto = RTO_MIN_MS;
+
+	if (rto > ACK_TIMEOUT_SECS * 1000)
+		rto = ACK_TIMEOUT_SECS * 1000;
+
+	r->rto = (uint32_t)rto;
+}
+
+//doubles the timeout after it expired, cancels the running measurement
+//r - pointer to rtt estimator
+// returns 1 if the timeout already was at its ACK_TIMEOUT_SECS ceiling, such timeouts count as retransmission tries
+static int rtt_backoff(rtt_estimator_t *r)
+{
+	int isMax = (r->rto >= ACK_TIMEOUT_SECS * 1000);
+
+	rtt_cancel(r);
+
+	r->rto *= 2;
+
+	if (r->rto > ACK_TIMEOUT_SECS * 1000)
+		r->rto = ACK_TIMEOUT_SECS * 1000;
+
+	return isMax;
+}
+
+//adds the offset option of a resumed transfer to the request in txBuf
+//a download asks for the data after the partial local file (whole writer chunks, the O_DIRECT writes stay aligned),
+//with a checksum the data before the offset is compared with the server's file
+//an upload offers the size of the local file, the server answers with the end of its partial file
+//ctx - pointer to client session context
+//filename - local file
+//isGet - download
+//n - length of the request so far
+// returns length of the request
+static size_t cl_put_resume_option(client_session_t *ctx, const char *filename, int isGet, size_t n)
+{
+	FILE *pFile = (isGet) ? fopen(filename, "rb") : ctx->pFile;
+	char value[24];
+	char hex[2 * DIGEST_MAX_LEN + 1];
+	int64_t size = 0;
+
+	if ((pFile != NULL) && (fseeko(pFile, 0, SEEK_END) == 0) && ((size = (int64_t)ftello(pFile)) < 0))
+		size = 0;
+
+	ctx->offsetAsked = (isGet) ? ((uint64_t)size & ~(uint64_t)(WRITER_ALIGN - 1)) : (uint64_t)size;
+
+	if (ctx->offsetAsked > 0)
+	{
+		snprintf(value, sizeof(value), "%llu", (unsigned long long)ctx->offsetAsked);
+		n = prot_put_option(ctx->txBuf, n, OPT_OFFSET, value);
+
+		if (isGet && (gChecksum != DIGEST_NONE) && resume_digest(pFile, NULL, ctx->offsetAsked, gChecksum, hex))
+			n = prot_put_option(ctx->txBuf, n, OPT_OFFSET_SUM, hex);
+	}
+
+	if (isGet && (pFile != NULL))
+		fclose(pFile);
+
+	return n;
+}
+
+//sends first request to server
+//ctx - pointer to client session context
+//operationStr - pointer to string buffer containing operation request (getfile or putfile)
+//filename - pointer to string buffer containing the filename
+static int send_first_request(client_session_t *ctx, const char* operationStr, const char* filename)
+{
+	size_t n = 0;
+	int rc;
+	int filenameLen;
+	const char *mode = (gNetascii) ? MODE_NETASCII : MODE_OCTET;
+
+	//check buffer overflow
+	if (strlen(filename) > PROT_MAX_DATA)
+		return 0;
+
+	if (strcmp(operationStr, "getfile") == 0)
+	{
+		ctx->txBuf[n++] = 0x00;
+		ctx->txBuf[n++] = TFTP_RRQ;
+		ctx->nextExpectedBlockNum = 1;
+
+		client_change_state(ctx, CL_ST_GETFILE_RXDATA);
+	}
+	else
+	{
+		ctx->txBuf[n++] = 0x00;
+		ctx->txBuf[n++] = TFTP_WRQ;
+		ctx->nextExpectedBlockNum = 0;
+
+		client_change_state(ctx, CL_ST_PUTFILE_TXDATA);
+	}
+
+	UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto); 	//start waitong for ack tmr
+
+	if (!gFsmDebugOn)
+		UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);	//start print progress tmr
+
+	filenameLen = strlen(filename);
+
+	//copy filename into packet buffer
+	memcpy(&ctx->txBuf[n], filename, filenameLen+1);
+	n += (filenameLen + 1);
+
+	memcpy(&ctx->txBuf[n], mode, strlen(mode)+1);
+	n += (strlen(mode) + 1);
+
+	//RFC 2348, ask for a larger block size
+	if (gBlkSize > 0)
+	{
+		char value[16];
+
+		snprintf(value, sizeof(value), "%d", gBlkSize);
+		n = prot_put_option(ctx->txBuf, n, OPT_BLKSIZE, value);
+	}
+
+	//RFC 7440, keep several blocks in flight
+	if (gWindowSize > 1)
+	{
+		char value[16];
+
+		snprintf(value, sizeof(value), "%d", gWindowSize);
+		n = prot_put_option(ctx->txBuf, n, OPT_WINDOWSIZE, value);
+	}
+
+	//the block number following 65535, without the option it is 0
+	if (gRollover >= 0)
+		n = prot_put_option(ctx->txBuf, n, OPT_ROLLOVER, (gRollover == 1) ? "1" : "0");
+
+	//RFC 2090, ask to receive the file from a multicast group
+	if ((gMcastStr != NULL) && (strcmp(operationStr, "getfile") == 0))
+		n = prot_put_option(ctx->txBuf, n, OPT_MULTICAST, "");
+
+	//verify the data with a checksum the sender computes as it goes
+	if (gChecksum != DIGEST_NONE)
+		n = prot_put_option(ctx->txBuf, n, OPT_CHECKSUM, DigestName(gChecksum));
+
+	//byte range of a parallel download, the server must acknowledge it as it is asked for
+	if (ctx->rangeLen > 0)
+	{
+		char value[24];
+
+		snprintf(value, sizeof(value), "%llu", (unsigned long long)ctx->offsetAsked);
+		n = prot_put_option(ctx->txBuf, n, OPT_OFFSET, value);
+
+		snprintf(value, sizeof(value), "%llu", (unsigned long long)ctx->rangeLen);
+		n = prot_put_option(ctx->txBuf, n, OPT_LENGTH, value);
+	}
+
+	//resume, a download continues after the data of the partial local file, an upload after the data
+	//the server kept from an earlier attempt (the size of the local file at most)
+	else if (gResume)
+	{
+		n = cl_put_resume_option(ctx, filename, (strcmp(operationStr, "getfile") == 0), n);
+	}
+
+	//RFC 2349, ask for the size of the file to download, announce the size of an octet file to upload
+	//(a netascii file changes size when it is converted)
+	if (strcmp(operationStr, "getfile") == 0)
+	{
+		n = prot_put_option(ctx->txBuf, n, OPT_TSIZE, "0");
+	}
+	else if ((!gNetascii) && (fseeko(ctx->pFile, 0, SEEK_END) == 0) && (ftello(ctx->pFile) >= 0))
+	{
+		char value[24];
+
+		snprintf(value, sizeof(value), "%llu", (unsigned long long)ftello(ctx->pFile));
+		n = prot_put_option(ctx->txBuf, n, OPT_TSIZE, value);
+	}
+
+	if (ctx->pFile != NULL)
+		fseeko(ctx->pFile, 0, SEEK_SET);
+
+	ctx->txLen = n;
+
+	//the server TID is not known yet, the request goes to its request port
+	rc = cl_send_buffer(ctx, ctx->txBuf, n);
+
+	if (!rc)
+	{
+		printf("failed to send first request\n");
+		return 0;
+	}
+
+	rtt_start(&ctx->rtt, 0);
+
+	return 1;
+}
+
+
+//menu shown to the user if command line input is incorrect
+static void help(void)
+{
+	printf("help:\n");
+	printf("-m <operating mode>\n-p <Server Port Number>\n-r <Remote IP Address>\n-o <Operation>\n-f <filename>\n");
+	printf("-b <blksize> (client: block size to request, server: max block size, 0 = RFC 1350 512 byte blocks)\n");
+	printf("-w <windowsize> (client: window size to request, server: max window size, 1 = lock-step)\n");
+	printf("-c <cache MB> (server: memory budget of the content cache, 0 = disabled, default %d)\n", DEF_CACHE_MB);
+	printf("-l <manifest> (server: file listing paths to load into the cache at startup, one per line)\n");
+	printf("-g <group> (server: offer RFC 2090 multicast on <group address>:<port>, client: any value requests multicast)\n");
+	printf("-I <interface address> (multicast interface, default route if not given)\n");
+	printf("-t <workers> (server: worker threads sharing the port, 0 = one per core, default 1)\n");
+	printf("-j <I/O threads> (server: threads reading and writing files, 0 = file I/O in the network loop, default %d)\n", DEF_IO_THREADS);
+	printf("-e <engine> (server: epoll or uring, io_uring for socket and file I/O, Linux only, default epoll)\n");
+	printf("-O <direct> (1 = write received files with O_DIRECT, Linux only, default 0)\n");
+	printf("-P <blocks> (server: blocks of a file read ahead of the send window, 0 = none, default %d)\n", DEF_PREFETCH_BLOCKS);
+	printf("-x <path> (server: Prometheus metrics, textfile rewritten every second or unix:<socket path> to scrape)\n");
+	printf("-R <path> (client: append a JSON line with throughput, round trip times and CPU time of the transfer)\n");
+	printf("-B <rollover> (client: request the rollover option, block number following 65535 is 0 or 1; without it 0)\n");
+	printf("-C <checksum> (client: crc32c or sha256 of the data, computed while it is sent and verified by the receiver)\n");
+	printf("-s <resume> (client: 1 = continue from the partial local file or the server's partial upload, checked with -C)\n");
+	printf("-n <streams> (client: download in this many byte ranges over concurrent sessions, default 1;\n"
+		"   -r may list mirrors serving the same file, <address>[:<port>],..., the ranges are spread over them)\n");
+	printf("-T <mode> (client: transfer mode, octet or netascii (text, line ends converted), default octet)\n");
+	printf("-N <impairment> (client: simulated network for sent and received datagrams, comma separated:\n"
+		"   loss=P ge=P:R[:LOSSBAD[:LOSSGOOD]] delay=MS jitter=MS reorder=P dup=P rate=BYTES/S limit=PACKETS seed=N,\n"
+		"   P as 0.01 or 1%%, e.g. -N loss=1%%,delay=20,jitter=5,seed=7)\n");
+}
+
+//connects a UDP socket to its peer, datagrams are then sent without an address
+//and the kernel drops the ones from other addresses (other TIDs)
+//sock - socket
+//peer - peer address, NULL dissolves the association
+// 0 = failed, 1=success
+static int connect_udp_sock(SOCKET sock, const struct sockaddr_in *peer)
+{
+	struct sockaddr_in none;
+
+	if (peer == NULL)
+	{
+		memset(&none, 0, sizeof(none));
+
+		#ifdef _WIN32
+			none.sin_family = AF_INET;	//an all zero address disconnects
+		#else
+			none.sin_family = AF_UNSPEC;
+		#endif
+
+		peer = &none;
+	}
+
+	return (connect(sock, (const struct sockaddr *)peer, sizeof(*peer)) == 0);
+}
+
+//sends an error packet to an address that has no session (unknown transfer ID)
+//sock - socket to send from
+//to - destination address
+// errCode - error code
+// errMsg - pointer to string buffer containing error message
+static void send_error_to(SOCKET sock, const struct sockaddr_in *to, uint16_t errCode, const char* errMsg)
+{
+	uint8_t buf[PROT_MAX_DATA + 5];
+	size_t len = strlen(errMsg);
+
+	if (len > PROT_MAX_DATA)
+		return;
+
+	buf[0] = 0x00;
+	buf[1] = TFTP_ERROR;
+	buf[2] = (uint8_t)((errCode >> 8) & 0xff);
+	buf[3] = (uint8_t)(errCode & 0xff);
+	memcpy(&buf[4], errMsg, len + 1);
+
+	#ifdef _WIN32
+		sendto(sock, (const char*)buf, (int)(len + 5), 0, (const struct sockaddr *)to, sizeof(*to));
+	#else
+		sendto(sock, buf, len + 5, 0, (const struct sockaddr *)to, sizeof(*to));
+	#endif
+}
+
+//safely closes socket
+//sock - pointer to socket
+static void close_socket(SOCKET *sock)
+{
+	if (*sock == INVALID_SOCKET)
+		return;
+
+	#ifdef _WIN32
+		closesocket(*sock);
+		WSACleanup();
+	#else
+		close(*sock);
+	#endif
+
+	*sock = INVALID_SOCKET;
+}
+
+//runs the completions of the file writes done so far, waits until at most maxPending are left
+//ctx - pointer to client session context
+//maxPending - writes that may still be running
+// returns 0 - a write failed, 1 - success
+static int cl_io_wait(client_session_t *ctx, int maxPending)
+{
+	io_job_t *job;
+
+	for (;;)
+	{
+		while ((job = IoDonePop(&ctx->ioDone)) != NULL)
+		{
+			if (job->isError)
+				ctx->isIoError = 1;
+
+			ctx->numIoPending--;
+			free(job);
+		}
+
+		if (ctx->numIoPending <= maxPending)
+			break;
+
+		//sleeps until the writer thread posts a completion
+		IoDoneWait(&ctx->ioDone);
+	}
+
+	return !ctx->isIoError;
+}
+
+//collects received data and hands it to the writer thread one WRITER_CHUNK at a time
+//ctx - pointer to client session context
+//data - received payload
+//len - length of payload
+//isLast - last block of the file
+// returns 0 - out of memory or an earlier write failed, 1 - success
+static int cl_io_write(client_session_t *ctx, const uint8_t *data, size_t len, int isLast)
+{
+	io_job_t *job;
+
+	if (!WriterAppend(&ctx->writer, data, len, isLast))
+		return 0;
+
+	while ((job = WriterTake(&ctx->writer)) != NULL)
+	{
+		//the disk is behind the network, the receive path waits for a chunk before queuing more
+		cl_io_wait(ctx, IO_MAX_WRITES - 1);
+
+		job->owner = ctx;
+		job->done = &ctx->ioDone;
+		ctx->numIoPending++;
+
+		IoPoolSubmit(&ctx->io, job, 0);
+	}
+
+	return cl_io_wait(ctx, IO_MAX_WRITES);
+}
+
+//safely closes the socket and file
+//ctx - pointer to client session context
+static void cl_close_file_and_sock(client_session_t*ctx)
+{
+	uint8_t buf[MAX_TX_BUFF];
+	uint32_t tag, ms;
+	int len;
+
+	//datagrams still on the simulated link, e.g. the final ACK, are delivered before the socket closes
+	while ((gImpairStr != NULL) && (!gDone) && (ctx->clientSock != INVALID_SOCKET) &&
+		((ms = ImpairNextMs(&ctx->impairTx, UtilTimeUs())) != UINT32_MAX))
+	{
+		if (ms > 0)
+		{
+			#ifdef _WIN32
+				Sleep(ms);
+			#else
+				usleep(ms * 1000);
+			#endif
+		}
+
+		while ((len = ImpairTake(&ctx->impairTx, UtilTimeUs(), buf, sizeof(buf), &tag)) >= 0)
+			cl_send_raw(ctx, buf, (size_t)len, htons((uint16_t)tag));
+	}
+
+	close_socket(&ctx->clientSock);
+	close_socket(&ctx->mcastSock);
+	txwin_free(&ctx->txWin);
+
+	free(ctx->rxMap);
+	ctx->rxMap = NULL;
+
+	//writes still running use the file
+	cl_io_wait(ctx, 0);
+	WriterFree(&ctx->writer);
+
+	if (ctx->pFile != NULL)
+	{
+		fclose(ctx->pFile);
+		ctx->pFile = NULL;
+	}
+}
+
+//appends the results of the transfer to gReportPath as one JSON object per line (benchmarks)
+//ctx - pointer to client session context
+//operation - getfile or putfile
+static void cl_write_report(client_session_t *ctx, const char *operation)
+{
+	uint64_t elapsedUs = UtilTimeUs() - ctx->startUs;
+	uint64_t cpuUs = UtilCpuTimeUs() - ctx->startCpuUs;
+	uint64_t size = 0;
+	double secs, mb;
+	const char *p;
+	FILE *f;
+
+	//the local file holds all data once the transfer succeeded
+#ifdef _WIN32
+	struct _stati64 st;
+
+	if (_stati64(ctx->filename, &st) == 0)
+		size = (uint64_t)st.st_size;
+#else
+	struct stat st;
+
+	if (stat(ctx->filename, &st) == 0)
+		size = (uint64_t)st.st_size;
+#endif
+
+	f = fopen(gReportPath, "a");
+
+	if (f == NULL)
+	{
+		printf("failed to open report file '%s'\n", gReportPath);
+		return;
+	}
+
+	secs = (elapsedUs > 0) ? (double)elapsedUs / 1e6 : 1e-6;
+	mb = (double)size / (1024.0 * 1024.0);
+
+	fprintf(f, "{\"operation\":\"%s\",\"file\":\"", operation);
+
+	for (p = ctx->filename; *p != '\0'; p++)
+	{
+		if ((*p == '"') || (*p == '\\'))
+			fputc('\\', f);
+
+		if ((unsigned char)*p >= 0x20)
+			fputc(*p, f);
+	}
+
+	fprintf(f, "\",\"ok\":%s,\"bytes\":%llu,\"blksize\":%u,\"windowsize\":%u,"
+		"\"seconds\":%.6f,\"mb_per_sec\":%.3f,"
+		"\"rtt_samples\":%u,\"rtt_p50_us\":%u,\"rtt_p99_us\":%u,"
+		"\"cpu_seconds\":%.6f,\"cpu_seconds_per_gb\":%.6f}\n",
+		ctx->isOk ? "true" : "false", (unsigned long long)size, ctx->blksize, ctx->windowsize,
+		secs, mb / secs,
+		ctx->rttHist.count, rtt_hist_percentile(&ctx->rttHist, 50), rtt_hist_percentile(&ctx->rttHist, 99),
+		(double)cpuUs / 1e6, (size > 0) ? ((double)cpuUs / 1e6) / ((double)size / (1024.0 * 1024.0 * 1024.0)) : 0.0);
+
+	fclose(f);
+}
+
+//maps the file of a GETFILE session so blocks can be sent without reading them
+//the pages are only passed to send calls, a page past the end of a file cut meanwhile fails the send (EFAULT)
+//where a read in this process would raise SIGBUS
+//falls back to fread (ctx->map stays NULL) for empty or non regular files
+//ctx - pointer to server session context
+static void svr_map_file(server_session_t *ctx)
+{
+#ifndef _WIN32
+	struct stat st;
+	void *map;
+
+	//a 32 bit address space cannot map files over 4 GB, they are read instead
+	if ((fstat(fileno(ctx->pFile), &st) != 0) || !S_ISREG(st.st_mode) || (st.st_size == 0) ||
+		((uint64_t)st.st_size > (uint64_t)SIZE_MAX))
+		return;
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fileno(ctx->pFile), 0);
+
+	if (map == MAP_FAILED)
+		return;
+
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	ctx->map = map;
+	ctx->mapLen = (uint64_t)st.st_size;
+#endif
+}
+
+//drops the mapping of a GETFILE session, the file is read instead
+//ctx - pointer to server session context
+static void svr_unmap_file(server_session_t *ctx)
+{
+#ifndef _WIN32
+	if (ctx->map != NULL)
+	{
+		munmap(ctx->map, (size_t)ctx->mapLen);
+		ctx->map = NULL;
+	}
+#endif
+}
+
+//safely closes the socket and file
+//ctx - pointer to server session context
+static void svr_close_file_and_sock(server_session_t*ctx)
+{
+	close_socket(&ctx->serverSock);
+	txwin_free(&ctx->txWin);
+	svr_unmap_file(ctx);
+
+	WriterFree(&ctx->writer);
+
+	if (ctx->cacheEntry != NULL)
+	{
+		CacheRelease(ctx->svr->cache, ctx->cacheEntry);
+		ctx->cacheEntry = NULL;
+	}
+
+	if (ctx->mcast != NULL)
+	{
+		mcast_member_t *m;
+
+		while (ctx->mcast->members != NULL)
+		{
+			m = ctx->mcast->members;
+			ctx->mcast->members = m->next;
+			free(m);
+		}
+
+		ctx->svr->mcastSlots &= ~(1u << ctx->mcast->slot);
+		free(ctx->mcast);
+		ctx->mcast = NULL;
+	}
+
+	if (ctx->pFile != NULL)
+	{
+		fclose(ctx->pFile);
+		ctx->pFile = NULL;
+	}
+}
+
+//send ACK packet from client
+//ctx - pointer to client session context
+// 1 - success, 0 - failure
+static int cl_send_ack(client_session_t *ctx)
+{
+	int n = 0;
+	int rc;
+
+	uint16_t block = blk_wire(ctx->blockNum, ctx->rollover);
+
+	ctx->txBuf[n++] = 0x00;
+	ctx->txBuf[n++] = TFTP_ACK;
+
+	//put block num in network byte order
+	ctx->txBuf[n++] = (block >> 8) & 0xFF;	// High byte
+	ctx->txBuf[n++] = block & 0xFF;			// Low byte
+
+	ctx->txLen = n;
+
+	rc = cl_send_buffer(ctx, ctx->txBuf, n);
+
+	if (!rc)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+//send ACK packet from server
+//ctx - pointer to server session context
+// 1 - success, 0 - failure
+static int svr_send_ack(server_session_t *ctx)
+{
+	int n = 0;
+	int rc;
+
+	uint16_t block = blk_wire(ctx->blockNum, ctx->rollover);
+
+	ctx->txBuf[n++] = 0x00;
+	ctx->txBuf[n++] = TFTP_ACK;
+
+	//put block num in network byte order
+	ctx->txBuf[n++] = (block >> 8) & 0xFF;	// High byte
+	ctx->txBuf[n++] = block & 0xFF;			// Low byte
+
+	ctx->txLen = n;
+
+	//queued with the DATA and OACK packets, svr_session_event flushes them together
+	rc = svr_send_buffer(ctx, ctx->txBuf, n);
+
+	if (!rc)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+//send error packet from client
+//ctx - pointer to client session context
+// errCode - error code
+// errMsg - pointer to string buffer containing error message
+// 1 - success, 0 - failure
+static int cl_send_error_pkt(client_session_t *ctx, uint16_t errCode, const char* errMsg)
+{
+	int n = 0;
+	int rc;
+
+	if (strlen(errMsg) > PROT_MAX_DATA)
+		return 0;
+
+	ctx->txBuf[n++] = 0x00;
+	ctx->txBuf[n++] = TFTP_ERROR;
+
+	ctx->txBuf[n++] = (uint8_t)((errCode>> 8) & 0xff);
+	ctx->txBuf[n++] = (uint8_t)(errCode & 0xff);
+
+	//copy error string into packet buffer
+	memcpy(&ctx->txBuf[n++], errMsg, strlen(errMsg));
+
+	ctx->txLen = 4 + strlen(errMsg);
+
+	//null terminate buffer
+	ctx->txBuf[ctx->txLen++] = 0x00;
+
+	rc = cl_send_buffer(ctx, ctx->txBuf, ctx->txLen);
+
+	if (!rc)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+//send error packet from server
+//ctx - pointer to server session context
+// errCode - error code
+// errMsg - pointer to string buffer containing error message
+// 1 - success, 0 - failure
+static int svr_send_error_pkt(server_session_t *ctx, uint16_t errCode, const char* errMsg)
+{
+	int n = 0;
+	int rc;
+
+	if (strlen(errMsg) > PROT_MAX_DATA)
+		return 0;
+
+	ctx->txBuf[n++] = 0x00;
+	ctx->txBuf[n++] = TFTP_ERROR;
+
+	ctx->txBuf[n++] = (uint8_t)((errCode>> 8) & 0xff);
+	ctx->txBuf[n++] = (uint8_t)(errCode & 0xff);
+
+	//copy error string into packet buffer
+	memcpy(&ctx->txBuf[n++], errMsg, strlen(errMsg));
+
+	ctx->txLen = 4 + strlen(errMsg);
+
+	//null terminate buffer
+	ctx->txBuf[ctx->txLen++] = 0x00;
+
+	ctx->stats.errorsSent[(errCode < METRICS_NUM_ERRORS) ? errCode : 0]++;
+
+	rc = svr_send_buffer(ctx, ctx->txBuf, ctx->txLen);
+
+	if (!rc)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+//joins the multicast group announced by the server (RFC 2090)
+//ctx - pointer to client session context
+//groupIp - group address
+//port - group port
+// 0 = failed, 1=success
+static int cl_mcast_join(client_session_t *ctx, const char *groupIp, uint16_t port)
+{
+	struct sockaddr_in Addr;
+	struct ip_mreq mreq;
+	SOCKET sock;
+	int on = 1;
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sock == INVALID_SOCKET)
+		return 0;
+
+	//several clients on one host share the group port
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+
+	memset(&Addr, 0, sizeof(Addr));
+	Addr.sin_family = AF_INET;
+	Addr.sin_port = htons(port);
+	Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.imr_multiaddr.s_addr = inet_addr(groupIp);
+	mreq.imr_interface.s_addr = (gMcastIf != NULL) ? inet_addr(gMcastIf) : htonl(INADDR_ANY);
+
+	if ((bind(sock, (struct sockaddr *)&Addr, sizeof(Addr)) < 0) ||
+		(setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char *)&mreq, sizeof(mreq)) < 0) ||
+		!EvLoopAdd(&ctx->ev, sock, &ctx->mcastSock))
+	{
+		printf("failed to join multicast group %s:%hu\n", groupIp, port);
+		close_socket(&sock);
+		return 0;
+	}
+
+	ctx->rxMap = calloc(1, MCAST_BITMAP_SIZE);
+
+	if (ctx->rxMap == NULL)
+	{
+		close_socket(&sock);
+		return 0;
+	}
+
+	ctx->mcastSock = sock;
+	ctx->isMcast = 1;
+	ctx->firstMissing = 1;
+
+	printf("joined multicast group %s:%hu\n", groupIp, port);
+	return 1;
+}
+
+//applies the multicast option of an OACK, "<group addr>,<port>,<mc>"
+//the group is only given in the first OACK, later ones make this client the master client
+//ctx - pointer to client session context
+//value - option value
+// 0 = failed, 1=success
+static int cl_mcast_apply(client_session_t *ctx, const char *value)
+{
+	char groupIp[INET_ADDRSTRLEN];
+	const char *p1 = strchr(value, ',');
+	const char *p2 = (p1 != NULL) ? strchr(p1 + 1, ',') : NULL;
+	size_t len;
+
+	if ((p2 == NULL) || (gMcastStr == NULL))
+		return 0;
+
+	len = (size_t)(p1 - value);
+
+	if (!ctx->isMcast)
+	{
+		if ((len == 0) || (len >= sizeof(groupIp)))
+			return 0;
+
+		memcpy(groupIp, value, len);
+		groupIp[len] = '\0';
+
+		if (!cl_mcast_join(ctx, groupIp, (uint16_t)atoi(p1 + 1)))
+			return 0;
+	}
+
+	ctx->isMaster = (atoi(p2 + 1) == 1);
+	return 1;
+}
+
+//applies the options acknowledged by the server
+//ctx - pointer to client session context
+// 1 - success, 0 - server acknowledged an option with a value that was not requested
+static int cl_apply_oack(client_session_t *ctx)
+{
+	const char *value;
+	char hex[2 * DIGEST_MAX_LEN + 1];
+	uint64_t offset;
+	int blksize, windowsize;
+
+	value = prot_get_option(&ctx->rxInfo, OPT_BLKSIZE);
+
+	if (value != NULL)
+	{
+		blksize = atoi(value);
+
+		if ((gBlkSize <= 0) || (blksize < PROT_MIN_BLKSIZE) || (blksize > gBlkSize))
+			return 0;
+
+		ctx->blksize = (uint16_t)blksize;
+		ctx->rxInfo.blksize = ctx->blksize;
+	}
+
+	value = prot_get_option(&ctx->rxInfo, OPT_WINDOWSIZE);
+
+	if (value != NULL)
+	{
+		windowsize = atoi(value);
+
+		if ((windowsize < 1) || (windowsize > gWindowSize))
+			return 0;
+
+		ctx->windowsize = (uint16_t)windowsize;
+	}
+
+	value = prot_get_option(&ctx->rxInfo, OPT_ROLLOVER);
+
+	if (value != NULL)
+	{
+		if ((gRollover < 0) || (atoi(value) != gRollover))
+			return 0;
+
+		ctx->rollover = gRollover;
+	}
+
+	value = prot_get_option(&ctx->rxInfo, OPT_CHECKSUM);
+
+	if (value != NULL)
+	{
+		if ((gChecksum == DIGEST_NONE) || (DigestAlg(value) != gChecksum))
+			return 0;
+
+		ctx->checksum = gChecksum;
+	}
+
+	//a download resumes at the offset asked for or starts over, an upload where the server's partial file ends
+	value = prot_get_option(&ctx->rxInfo, OPT_OFFSET);
+
+	if (value != NULL)
+	{
+		offset = strtoull(value, NULL, 10);
+
+		if ((!gResume) && (ctx->rangeLen == 0))
+			return 0;
+
+		if ((offset > ctx->offsetAsked) || ((ctx->rangeLen == 0) && ((offset % WRITER_ALIGN) != 0)))
+			return 0;
+
+		ctx->offset = offset;
+	}
+
+	//a byte range is sent as it was asked for or not at all
+	value = prot_get_option(&ctx->rxInfo, OPT_LENGTH);
+
+	if (value != NULL)
+	{
+		if ((ctx->rangeLen == 0) || (strtoull(value, NULL, 10) != ctx->rangeLen) || (ctx->offset != ctx->offsetAsked))
+			return 0;
+
+		ctx->isRangeAcked = 1;
+	}
+
+	//the partial file on the server must hold the same data as the local file
+	value = prot_get_option(&ctx->rxInfo, OPT_OFFSET_SUM);
+
+	if ((value != NULL) && (ctx->offset > 0) && (ctx->pFile != NULL))
+	{
+		if ((ctx->checksum == DIGEST_NONE) || !resume_digest(ctx->pFile, NULL, ctx->offset, ctx->checksum, hex) ||
+			(strcasecmp(hex, value) != 0))
+		{
+			printf("error: the partial copy of %s on the server differs from the local file, upload it without resuming\n", ctx->filename);
+			return 0;
+		}
+	}
+
+	value = prot_get_option(&ctx->rxInfo, OPT_MULTICAST);
+
+	if ((value != NULL) && !cl_mcast_apply(ctx, value))
+		return 0;
+
+	value = prot_get_option(&ctx->rxInfo, OPT_TSIZE);
+
+	if (value != NULL)
+		ctx->tsize = strtoull(value, NULL, 10);
+
+	return 1;
+}
+
+//checks if the file of a session is read and written by the I/O threads or the ring
+//ctx - pointer to server session context
+static int svr_io_async(const server_session_t *ctx)
+{
+#ifdef URING_SUPPORTED
+	if (ctx->svr->uring.isActive)
+		return 1;
+#endif
+
+	return (ctx->svr->io->numThreads > 0);
+}
+
+//checks if the blocks of an outgoing file are read by the I/O threads or the ring
+//mapped files need no reads, netascii files are converted by the network loop as they are read
+//ctx - pointer to server session context
+static int svr_read_async(const server_session_t *ctx)
+{
+	return (ctx->txWin.map == NULL) && (ctx->txWin.text == NULL) && svr_io_async(ctx);
+}
+
+//hands a file job to the I/O thread of the session, its completion raises EV_SVR_IO_DONE
+//ctx - pointer to server session context
+//job - job to run
+static void svr_io_submit(server_session_t *ctx, io_job_t *job)
+{
+	job->pFile = ctx->pFile;
+	job->owner = ctx;
+	job->done = &ctx->svr->ioDone;
+
+	ctx->numIoPending++;
+	ctx->svr->numIoPending++;
+
+#ifdef URING_SUPPORTED
+	struct io_uring_sqe *sqe;
+
+	//positioned read or write of the file descriptor, the stream position is not used
+	if (ctx->svr->uring.isActive && ((sqe = svr_uring_sqe(ctx->svr)) != NULL))
+	{
+		sqe->opcode = (job->op == IO_OP_READ) ? IORING_OP_READ : IORING_OP_WRITE;
+		sqe->fd = fileno(job->pFile);
+		sqe->addr = (uint64_t)(uintptr_t)job->buf;
+		sqe->len = (uint32_t)job->len;
+		sqe->off = job->offset;
+		sqe->user_data = (uint64_t)(uintptr_t)job | URING_TAG_IO;
+		return;
+	}
+
+	//ring full, the job runs inline at its offset, the worker picks up its completion
+	if (ctx->svr->uring.isActive)
+	{
+		io_pool_t inlinePool;
+
+		memset(&inlinePool, 0, sizeof(inlinePool));
+		fseeko(job->pFile, (off_t)job->offset, SEEK_SET);
+		IoPoolSubmit(&inlinePool, job, 0);
+		return;
+	}
+#endif
+
+	IoPoolSubmit(ctx->svr->io, job, ctx->ioAffinity);
+}
+
+//submits reads for the free slots of the transmit window, the window and the blocks prefetched after it
+//ctx - pointer to server session context
+// 0 = out of memory, 1=success
+static int svr_io_read_ahead(server_session_t *ctx)
+{
+	tx_window_t *w = &ctx->txWin;
+	io_job_t *job;
+	uint16_t *len;
+
+	//reads past the end of the file come back empty and are dropped
+	while ((!w->eof) && ((w->reading - w->base) < w->numSlots))
+	{
+		job = calloc(1, sizeof(*job));
+
+		if (job == NULL)
+			return 0;
+
+		job->op = IO_OP_READ;
+		job->buf = txwin_slot(w, w->reading, &len) + 4;
+		job->len = w->blksize;
+		job->block = w->reading++;
+		job->offset = ctx->ioOffset;
+		ctx->ioOffset += w->blksize;
+
+		svr_io_submit(ctx, job);
+	}
+
+	return 1;
+}
+
+//collects received data and writes it one WRITER_CHUNK at a time
+//ctx - pointer to server session context
+//data - received payload
+//len - length of payload
+//isLast - last block of the file, the collected data is written now
+// 0 = out of memory or write error, 1=success
+static int svr_io_write(server_session_t *ctx, const uint8_t *data, size_t len, int isLast)
+{
+	io_job_t *job;
+	int rc = 1;
+
+	//the payload points into the receive buffer, it is copied before the next datagram
+	if (!WriterAppend(&ctx->writer, data, len, isLast))
+		return 0;
+
+	while ((job = WriterTake(&ctx->writer)) != NULL)
+	{
+		if (svr_io_async(ctx))
+		{
+			svr_io_submit(ctx, job);
+			continue;
+		}
+
+		//no I/O threads, the chunk is written by the network loop
+		IoJobRun(job);
+
+		if (job->isError)
+			rc = 0;
+
+		free(job);
+	}
+
+	return rc;
+}
+
+//sends the data blocks the window has room for, starting at the send position
+//ctx - pointer to client session context
+// returns number of new data bytes read from the file, -1 on error
+static int cl_send_window(client_session_t *ctx)
+{
+	tx_window_t *w = &ctx->txWin;
+	uint16_t *len;
+	uint8_t *pkt;
+	int bytesRead = 0;
+	int isReTransmit = 0;
+	int rc;
+
+	while (txwin_can_send(w))
+	{
+		if (w->next == w->filled)
+		{
+			rc = txwin_read_block(w, ctx->pFile);
+
+			if (rc < 0)
+				return -1;
+
+			bytesRead += rc;
+		}
+		else
+		{
+			isReTransmit = 1;
+		}
+
+		pkt = txwin_slot(w, w->next, &len);
+
+		if (!cl_send_buffer(ctx, pkt, *len))
+			return -1;
+
+		w->next++;
+
+		//the checksum follows the last block, it is resent with it
+		if ((w->digestPktLen > 0) && (w->next - 1 == w->lastBlock) && !cl_send_buffer(ctx, w->digestPkt, w->digestPktLen))
+			return -1;
+	}
+
+	//time the ACK of the last block sent, unless it was sent before (Karn's rule)
+	if (isReTransmit)
+		rtt_cancel(&ctx->rtt);
+	else if (w->next != w->base)
+		rtt_start(&ctx->rtt, blk_wire(w->next - 1, w->rollover));
+
+	return bytesRead;
+}
+
+//prints the checksum of an upload the server verified before it acknowledged the last block
+//ctx - pointer to client session context
+//digest - digest of the data sent
+static void cl_print_checksum(const client_session_t *ctx, const uint8_t *digest)
+{
+	char hex[2 * DIGEST_MAX_LEN + 1];
+
+	if (ctx->checksum != DIGEST_NONE)
+	{
+		DigestHex(digest, DigestLen(ctx->checksum), hex);
+		printf("%s %s %s verified by the server\n", ctx->filename, DigestName(ctx->checksum), hex);
+	}
+	else if (gChecksum != DIGEST_NONE)
+	{
+		printf("warning: the server does not support the checksum option, %s was not verified\n", ctx->filename);
+	}
+}
+
+//completes a download once the last block and the checksum of the server were received,
+//the last block is acknowledged if the checksum matches
+//ctx - pointer to client session context
+// returns 0, the session is closed
+static int cl_getfile_done(client_session_t *ctx)
+{
+	int isMatch = 1;
+
+	if (ctx->checksum != DIGEST_NONE)
+		isMatch = prot_verify_digest(&ctx->rxDigest, ctx->peerDigest, ctx->filename);
+	else if (gChecksum != DIGEST_NONE)
+		printf("warning: the server does not support the checksum option, %s was not verified\n", ctx->filename);
+
+	//the file is completed before the last block is acknowledged, the server learns of a failed write
+	if (!cl_io_wait(ctx, 0) || !WriterFinish(&ctx->writer))
+	{
+		printf("error writing file data\n");
+		cl_send_error_pkt(ctx, 0, "error writing file data");
+	}
+	else if (!isMatch)
+	{
+		cl_send_error_pkt(ctx, 0, "checksum mismatch");
+	}
+	else
+	{
+		cl_send_ack(ctx);
+
+		//a byte range ends early if the file on the server is shorter than the size it reported
+		if ((ctx->rangeLen > 0) && (ctx->writer.size != ctx->offset + ctx->rangeLen))
+		{
+			printf("error: bytes %llu-%llu of %s incomplete, the file changed on the server\n", (unsigned long long)ctx->offset,
+				(unsigned long long)(ctx->offset + ctx->rangeLen - 1), ctx->filename);
+		}
+		else if (ctx->rangeLen > 0)
+		{
+			printf("bytes %llu-%llu of %s successfully downloaded, closing connection\n", (unsigned long long)ctx->offset,
+				(unsigned long long)(ctx->offset + ctx->rangeLen - 1), ctx->filename);
+			ctx->isOk = 1;
+		}
+		else
+		{
+			printf("%s successfully downloaded, closing connection\n", ctx->filename);
+			ctx->isOk = 1;
+		}
+	}
+
+	cl_close_file_and_sock(ctx);
+	return 0;
+}
+
+//sends data to server
+//ctx - pointer to client session context
+// ev - client event
+static int cl_putfile_txData(client_session_t *ctx, int ev)
+{
+	uint64_t base;
+	int rc;
+
+	switch(ev)
+	{
+	case EV_CL_TIMEOUT:
+		//resend ack and increment retransmission tries, and break
+		if (rtt_backoff(&ctx->rtt))
+			ctx->num_retrans_tries++;
+
+		//close socket if we reach ,ax retransissions and return 0;
+		if (ctx->num_retrans_tries == gMaxNumRetransTries)
+		{
+			ctx->num_retrans_tries = 0;
+
+			printf("reached max number of timeouts, closing session\n");
+			cl_send_error_pkt(ctx, 0, "timeout waiting for ack, closing connection\n");
+			cl_close_file_and_sock(ctx);
+			gDone = 1;
+			return 0;
+		}
+
+		if ((ctx->txWin.buf == NULL) || (ctx->txWin.next == ctx->txWin.base))
+		{
+			//resend request
+			cl_send_packet_buffer(ctx);
+		}
+		else
+		{
+			//resend all blocks in flight
+			ctx->txWin.next = ctx->txWin.base;
+			cl_send_window(ctx);
+		}
+
+		UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+		break;
+
+	case EV_CL_PDU_RX:
+		switch (ctx->rxInfo.optcode)
+		{
+		case TFTP_OACK:
+			//OACK takes the place of the ACK for block 0
+			if (ctx->txWin.buf != NULL)
+				break;
+
+			if (!cl_apply_oack(ctx))
+			{
+				printf("error: invalid option acknowledgment, closing connection\n");
+				cl_send_error_pkt(ctx, 8, "invalid option acknowledgment");
+				cl_close_file_and_sock(ctx);
+				return 0;
+			}
+
+			ctx->rxInfo.blocknum = 0;
+			/* fall through */
+
+		case TFTP_ACK:
+			//ACK of block 0 starts the data transfer with the negotiated options
+			if (ctx->txWin.buf == NULL)
+			{
+				if (ctx->rxInfo.blocknum != 0)
+					break;
+
+				if (!txwin_init(&ctx->txWin, ctx->blksize, ctx->windowsize, 0, ctx->rollover, NULL, 0) ||
+					(gNetascii && !txwin_set_netascii(&ctx->txWin)))
+				{
+					printf("error: out of memory, closing connection\n");
+					cl_send_error_pkt(ctx, 0, "out of memory");
+					cl_close_file_and_sock(ctx);
+					return 0;
+				}
+
+				DigestInit(&ctx->txWin.digest, ctx->checksum);
+
+				//a resumed upload sends the data after the server's partial file, block 1 carries the byte at the offset
+				if (ctx->offset > 0)
+				{
+					if (fseeko(ctx->pFile, (off_t)ctx->offset, SEEK_SET) != 0)
+					{
+						printf("error: failed to read %s, closing connection\n", ctx->filename);
+						cl_send_error_pkt(ctx, 0, "error reading file");
+						cl_close_file_and_sock(ctx);
+						return 0;
+					}
+
+					printf("resuming upload of %s at byte %llu\n", ctx->filename, (unsigned long long)ctx->offset);
+				}
+			}
+
+			rtt_sample(&ctx->rtt, ctx->rxInfo.blocknum);
+
+			base = ctx->txWin.base;
+			rc = txwin_ack(&ctx->txWin, ctx->rxInfo.blocknum);
+
+			if (rc == TXWIN_IGNORE)
+				break;
+
+			if (rc == TXWIN_DONE)
+			{
+				// last data block was shorter than blksize
+				// close connection, success
+				cl_print_checksum(ctx, &ctx->txWin.digestPkt[2]);
+				printf("%s successfully uploaded, closing connection\n", ctx->filename);
+				ctx->isOk = 1;
+				return 0;
+			}
+
+			if (ctx->txWin.base != base)
+				ctx->num_retrans_tries = 0;
+
+			//send data
+			rc = cl_send_window(ctx);
+
+			if (rc < 0)
+			{
+				printf("error sending data packet, closing connection\n");
+				cl_send_error_pkt(ctx,0, "error sending data packet, closing connection");
+
+				cl_close_file_and_sock(ctx);
+				return 0;
+			}
+
+			ctx->bytesDone += (uint64_t)rc;
+
+			if((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
+			{
+				printf("bytes sent: %llu\n", (unsigned long long)ctx->bytesDone);
+				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
+			}
+
+			//restart tmr
+			UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+
+			return 1;
+
+		case TFTP_ERROR:
+			//parse error packet and print to console
+
+			printf("error code: %hu\n", ctx->rxInfo.errCode);
+
+			printf("%s\n", ctx->rxInfo.errMessage);
+			cl_close_file_and_sock(ctx);
+			return 0;
+
+		default:
+			printf("error unexpected optcode recieved, closing connection\n");
+
+			cl_send_error_pkt(ctx, 0, "error unexpected optcode recieved");
+
+			cl_close_file_and_sock(ctx);
+			return 0;
+		}
+		break;
+	}
+	return 1;
+}
+
+//recieves data from server
+//ctx - pointer to client session context
+// ev - client event
+static int cl_getfile_rxData(client_session_t *ctx, int ev)
+{
+	uint64_t rxBlock;
+
+	switch (ev)
+	{
+		case EV_CL_TIMEOUT:
+			//resend ack and incremt retransmission tries, and break
+			if (rtt_backoff(&ctx->rtt))
+				ctx->num_retrans_tries++;
+
+			//close socket if we reach ,ax retransissions and return 0;
+			if (ctx->num_retrans_tries == gMaxNumRetransTries)
+			{
+				printf("reached max number of timouts, closing session\n");
+				ctx->num_retrans_tries = 0;
+
+				cl_send_error_pkt(ctx, 0, "timeout waiting for data, closing connection");
+				cl_close_file_and_sock(ctx);
+				gDone = 1;
+				return 0;
+			}
+
+			//the last block is not acknowledged yet, the server resends it and its checksum on its own timeout
+			if (ctx->isDigestWait)
+			{
+				UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+				break;
+			}
+
+			if (ctx->numUnacked > 0)
+			{
+				//RFC 7440: acknowledge the blocks received so far in the window
+				ctx->blockNum = ctx->nextExpectedBlockNum - 1;
+				ctx->numUnacked = 0;
+				cl_send_ack(ctx);
+			}
+			else
+			{
+				//send last buffer
+				cl_send_packet_buffer(ctx);
+			}
+
+			UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+			break;
+
+		case EV_CL_PDU_RX:
+			switch (ctx->rxInfo.optcode)
+			{
+			case TFTP_OACK:
+				//options accepted, acknowledge with block 0 and wait for block 1
+				if ((!ctx->isFirstDataBlock) || (ctx->nextExpectedBlockNum != 1))
+					break;
+
+				if (!cl_apply_oack(ctx))
+				{
+					printf("error: invalid option acknowledgment, closing connection\n");
+					cl_send_error_pkt(ctx, 8, "invalid option acknowledgment");
+					cl_close_file_and_sock(ctx);
+					return 0;
+				}
+
+				//RFC 2349: the size of the file is known, the probe of a parallel download ends the transfer
+				if (ctx->isProbe)
+				{
+					ctx->isOk = (prot_get_option(&ctx->rxInfo, OPT_TSIZE) != NULL);
+					cl_send_error_pkt(ctx, 0, "transfer size probe");
+					cl_close_file_and_sock(ctx);
+					return 0;
+				}
+
+				rtt_sample(&ctx->rtt, 0);
+
+				ctx->num_retrans_tries = 0;
+
+				//RFC 2090: blocks come from the group, only the master client acknowledges
+				if (ctx->isMcast)
+				{
+					client_change_state(ctx, CL_ST_MCAST_RXDATA);
+
+					if (!ctx->isMaster)
+					{
+						UtilTickTimerStart(&ctx->tmr1, MCAST_IDLE_SECS);
+						return 1;
+					}
+				}
+
+				cl_send_ack(ctx);
+				rtt_start(&ctx->rtt, 0);
+
+				UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+				return 1;
+
+			case TFTP_DATA:
+				rxBlock = blk_index(ctx->nextExpectedBlockNum, ctx->rxInfo.blocknum, ctx->rollover);
+
+				//compare received block no with expected block no
+				//If they mismatch, ignore the packet and break;
+				if (rxBlock != ctx->nextExpectedBlockNum)
+				{
+					//a block older than the previous one, the sender went back to resend the gap
+					if (rxBlock < ctx->lastRxBlock)
+						ctx->isGapAcked = 0;
+
+					ctx->lastRxBlock = rxBlock;
+
+					//RFC 7440: a block from further ahead means blocks were lost,
+					//acknowledge the last block received in order once per gap
+					if ((ctx->windowsize > 1) && (!ctx->isGapAcked) && (rxBlock > ctx->nextExpectedBlockNum))
+					{
+						ctx->blockNum = ctx->nextExpectedBlockNum - 1;
+						ctx->numUnacked = 0;
+						ctx->isGapAcked = 1;
+						cl_send_ack(ctx);
+						rtt_cancel(&ctx->rtt);
+					}
+					break;
+				}
+
+				// If they match - proceed
+				// Increment next expeted block number
+				rtt_sample(&ctx->rtt, blk_wire(rxBlock - 1, ctx->rollover));
+				ctx->nextExpectedBlockNum++;
+				ctx->isGapAcked = 0;
+				ctx->lastRxBlock = rxBlock;
+
+				if (ctx->isFirstDataBlock)
+				{
+					//a server without options sends the whole file right away
+					if (ctx->isProbe || ((ctx->rangeLen > 0) && !ctx->isRangeAcked))
+					{
+						printf("error: the server does not support byte ranges, closing connection\n");
+						cl_send_error_pkt(ctx, 8, "byte range not supported");
+						cl_close_file_and_sock(ctx);
+						return 0;
+					}
+
+					DigestInit(&ctx->rxDigest, ctx->checksum);
+
+					//open file for writing, a resumed download keeps the data before the offset,
+					//a byte range the other ranges of the preallocated file
+					ctx->pFile = fopen(ctx->filename, ((ctx->offset > 0) || (ctx->rangeLen > 0)) ? "r+b" : "wb");
+
+					if (ctx->pFile == NULL)
+					{
+						printf("error: failed to open file for writing\n");
+						cl_send_error_pkt(ctx, 1, "error, failed to open file for writing");
+
+						return 0;
+					}
+					ctx->isFirstDataBlock = 0;
+
+					if (ctx->rangeLen > 0)
+						WriterInitRange(&ctx->writer, ctx->pFile, ctx->offset);
+
+					//the size acknowledged by the server is reserved up front
+					else if (!WriterInit(&ctx->writer, ctx->pFile, ctx->offset, ctx->tsize, gDirectIo, gNetascii))
+					{
+						printf("error: not enough space for %llu bytes\n", (unsigned long long)ctx->tsize);
+						cl_send_error_pkt(ctx, 3, "disk full or allocation exceeded");
+						cl_close_file_and_sock(ctx);
+						return 0;
+					}
+
+					if ((ctx->offset > 0) && (ctx->rangeLen == 0))
+						printf("resuming download of %s at byte %llu\n", ctx->filename, (unsigned long long)ctx->offset);
+				}
+
+				ctx->num_retrans_tries = 0;
+
+				DigestUpdate(&ctx->rxDigest, ctx->rxInfo.data, ctx->rxInfo.dataLen);
+
+				//recieve packet from client and write payload contents into file, in the background
+				if (!cl_io_write(ctx, ctx->rxInfo.data, ctx->rxInfo.dataLen, ctx->rxInfo.isLastDataBlock))
+				{
+					//send error packet
+					printf("error writing file data, closing connection\n");
+
+					cl_send_error_pkt(ctx, 0, "error writing file data, closing connection");
+
+					//close connection
+					cl_close_file_and_sock(ctx);
+					return 0;
+				}
+
+				//check if this id the last data packet
+				if (ctx->rxInfo.isLastDataBlock)
+				{
+					ctx->blockNum++;
+
+					//the server resends the last block and its checksum until the checksum arrived
+					if ((ctx->checksum != DIGEST_NONE) && !ctx->hasPeerDigest)
+					{
+						ctx->isDigestWait = 1;
+						UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+						return 1;
+					}
+
+					return cl_getfile_done(ctx);
+				}
+
+				ctx->bytesDone += ctx->rxInfo.dataLen;
+
+				if ((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
+				{
+					printf("bytes recieved: %llu\n", (unsigned long long)ctx->bytesDone);
+					UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
+				}
+
+				//send ack at the end of each window
+				ctx->blockNum++;
+
+				if (++ctx->numUnacked >= ctx->windowsize)
+				{
+					ctx->numUnacked = 0;
+					cl_send_ack(ctx);
+					rtt_start(&ctx->rtt, blk_wire(ctx->blockNum, ctx->rollover));
+				}
+
+				UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+				return 1;
+
+			case TFTP_DIGEST:
+				//sent right after the last block, it may overtake it
+				if (!prot_get_digest(&ctx->rxInfo, ctx->checksum, ctx->peerDigest))
+					break;
+
+				ctx->hasPeerDigest = 1;
+
+				if (ctx->isDigestWait)
+					return cl_getfile_done(ctx);
+				break;
+
+			case TFTP_ERROR:
+				//parse error packet and print to console
+
+				printf("error code: %hu\n", ctx->rxInfo.errCode);
+
+				printf("%s\n", ctx->rxInfo.errMessage);
+
+				cl_close_file_and_sock(ctx);
+				return 0;
+
+			default:
+				printf("error unexpected optcode recieved, closing connection\n");
+
+				cl_send_error_pkt(ctx, 0, "error unexpected optcode recieved");
+
+				//close socket
+				cl_close_file_and_sock(ctx);
+				return 0;
+			}
+
+			break;
+	}
+
+	return 1;
+}
+
+//acknowledges the block before the first one still missing, the server sends that one next
+//ctx - pointer to client session context
+static void cl_mcast_ack(client_session_t *ctx)
+{
+	ctx->blockNum = (uint16_t)(ctx->firstMissing - 1);
+	cl_send_ack(ctx);
+	rtt_start(&ctx->rtt, (uint16_t)ctx->blockNum);
+}
+
+//writes a block received from the multicast group at its place in the file
+//ctx - pointer to client session context
+// 0 = transfer finished or failed, 1 = continue
+static int cl_mcast_rx_block(client_session_t *ctx)
+{
+	uint16_t block = ctx->rxInfo.blocknum;
+	uint64_t offset = (uint64_t)(block - 1) * ctx->blksize;
+	size_t bytesWritten;
+
+	if ((block == 0) || ((ctx->lastBlock != 0) && (block > ctx->lastBlock)))
+		return 1;
+
+	if (!(ctx->rxMap[block >> 3] & (1 << (block & 7))))
+	{
+		if (ctx->pFile == NULL)
+		{
+			ctx->pFile = fopen(ctx->filename, "wb");
+
+			if (ctx->pFile == NULL)
+			{
+				printf("error: failed to open file for writing\n");
+				cl_send_error_pkt(ctx, 1, "error, failed to open file for writing");
+				cl_close_file_and_sock(ctx);
+				return 0;
+			}
+
+			ctx->fileOffset = 0;
+		}
+
+		//blocks missed before joining leave a hole that a later master turn fills
+		if ((ctx->fileOffset != offset) && (fseeko(ctx->pFile, (off_t)offset, SEEK_SET) != 0))
+			bytesWritten = 0;
+		else
+			bytesWritten = fwrite(ctx->rxInfo.data, 1, ctx->rxInfo.dataLen, ctx->pFile);
+
+		if (bytesWritten != ctx->rxInfo.dataLen)
+		{
+			printf("error writing file data, closing connection\n");
+			cl_send_error_pkt(ctx, 0, "error writing file data, closing connection");
+			cl_close_file_and_sock(ctx);
+			return 0;
+		}
+
+		ctx->fileOffset = offset + bytesWritten;
+		ctx->rxMap[block >> 3] |= (uint8_t)(1 << (block & 7));
+
+		if (ctx->rxInfo.isLastDataBlock)
+			ctx->lastBlock = block;
+
+		while ((ctx->firstMissing != 0) && (ctx->rxMap[ctx->firstMissing >> 3] & (1 << (ctx->firstMissing & 7))))
+			ctx->firstMissing++;
+	}
+
+	if ((ctx->lastBlock != 0) && ((ctx->firstMissing == 0) || (ctx->firstMissing > ctx->lastBlock)))
+	{
+		//every member reports completion, the server then moves on to the next master client
+		printf("%s successfully downloaded, closing connection\n", ctx->filename);
+		ctx->isOk = 1;
+		ctx->blockNum = ctx->lastBlock;
+		cl_send_ack(ctx);
+		cl_close_file_and_sock(ctx);
+		return 0;
+	}
+
+	if (ctx->isMaster)
+	{
+		ctx->num_retrans_tries = 0;
+		cl_mcast_ack(ctx);
+		UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+	}
+	else
+	{
+		UtilTickTimerStart(&ctx->tmr1, MCAST_IDLE_SECS);
+	}
+
+	return 1;
+}
+
+//recieves the blocks of a multicast transfer (RFC 2090)
+//ctx - pointer to client session context
+// ev - client event
+static int cl_mcast_rxData(client_session_t *ctx, int ev)
+{
+	switch (ev)
+	{
+		case EV_CL_TIMEOUT:
+			if (!ctx->isMaster)
+			{
+				printf("no multicast data received, closing session\n");
+				cl_close_file_and_sock(ctx);
+				gDone = 1;
+				return 0;
+			}
+
+			if (rtt_backoff(&ctx->rtt))
+				ctx->num_retrans_tries++;
+
+			if (ctx->num_retrans_tries == gMaxNumRetransTries)
+			{
+				printf("reached max number of timouts, closing session\n");
+
+				cl_send_error_pkt(ctx, 0, "timeout waiting for data, closing connection");
+				cl_close_file_and_sock(ctx);
+				gDone = 1;
+				return 0;
+			}
+
+			rtt_cancel(&ctx->rtt);
+			ctx->blockNum = (uint16_t)(ctx->firstMissing - 1);
+			cl_send_ack(ctx);
+
+			UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+			break;
+
+		case EV_CL_PDU_RX:
+			switch (ctx->rxInfo.optcode)
+			{
+			case TFTP_OACK:
+				//server made this client the master client
+				if (!cl_apply_oack(ctx))
+				{
+					printf("error: invalid option acknowledgment, closing connection\n");
+					cl_send_error_pkt(ctx, 8, "invalid option acknowledgment");
+					cl_close_file_and_sock(ctx);
+					return 0;
+				}
+
+				if (ctx->isMaster)
+				{
+					ctx->num_retrans_tries = 0;
+					cl_mcast_ack(ctx);
+					UtilTickTimerStartMs(&ctx->tmr1, ctx->rtt.rto);
+				}
+				return 1;
+
+			case TFTP_DATA:
+				rtt_sample(&ctx->rtt, (uint16_t)(ctx->rxInfo.blocknum - 1));
+				return cl_mcast_rx_block(ctx);
+
+			case TFTP_ERROR:
+				printf("error code: %hu\n", ctx->rxInfo.errCode);
+				printf("%s\n", ctx->rxInfo.errMessage);
+
+				cl_close_file_and_sock(ctx);
+				return 0;
+
+			default:
+				break;
+			}
+			break;
+	}
+
+	return 1;
+}
+
+//client finite state machine
+//ctx - pointer to client session context
+// ev - client event
+static int cl_fsm_event(client_session_t *ctx, int ev)
+{
+	if (gFsmDebugOn)
+	{
+		char stateName[64];
+		char eventName[64];
+
+		client_get_state_name(ctx->state, stateName);
+		client_get_event_name(ev, eventName);
+
+		printf("CL FSM: ev [%s] <-- %s\n",
+			stateName, eventName);
+	}
+
+	switch (ctx->state)
+	{
+	case CL_ST_GETFILE_RXDATA:
+		if (!cl_getfile_rxData(ctx, ev))
+			return 0;
+		break;
+
+	case CL_ST_PUTFILE_TXDATA:
+		if (!cl_putfile_txData(ctx, ev))
+			return 0;
+		break;
+
+	case CL_ST_MCAST_RXDATA:
+		if (!cl_mcast_rxData(ctx, ev))
+			return 0;
+		break;
+	}
+	return 1;
+}
+
+//gets the size of the file served by a GETFILE session
+//ctx - pointer to server session context
+static uint64_t svr_file_size(server_session_t *ctx)
+{
+	int64_t size;
+
+	if (ctx->cacheEntry != NULL)
+		return ctx->cacheEntry->size;
+
+	if (ctx->map != NULL)
+		return ctx->mapLen;
+
+	//nothing has been read yet
+	if ((fseeko(ctx->pFile, 0, SEEK_END) != 0) || ((size = (int64_t)ftello(ctx->pFile)) < 0))
+		size = 0;
+
+	fseeko(ctx->pFile, 0, SEEK_SET);
+	return (uint64_t)size;
+}
+
+//offset a resumed transfer continues from
+//RRQ: the offset the client asked for, 0 (whole file) if the file is shorter or the data before the offset
+//differs from the client's partial file
+//WRQ: the end of the partial file left by an earlier upload, the size of the client's file at most
+//ctx - pointer to server session context
+//requested - value of the offset option
+// returns file offset of block 1
+static uint64_t svr_resume_offset(server_session_t *ctx, uint64_t requested)
+{
+	const char *sum = prot_get_option(&ctx->rxInfo, OPT_OFFSET_SUM);
+	const uint8_t *data = (ctx->cacheEntry != NULL) ? ctx->cacheEntry->data : NULL;	//a mapping is not read here
+	char hex[2 * DIGEST_MAX_LEN + 1];
+	uint64_t size = svr_file_size(ctx);
+
+	if (ctx->rxInfo.optcode == TFTP_WRQ)
+	{
+		//whole writer chunks, the O_DIRECT writes after it stay aligned
+		if (size > requested)
+			size = requested;
+
+		return size & ~(uint64_t)(WRITER_ALIGN - 1);
+	}
+
+	if (requested > size)
+		return 0;
+
+	if ((requested > 0) && (sum != NULL) && (ctx->checksum != DIGEST_NONE) &&
+		(!resume_digest(ctx->pFile, data, requested, ctx->checksum, hex) || (strcasecmp(hex, sum) != 0)))
+	{
+		printf("the partial copy of %s differs from the file, sending the whole file\n", (char*)ctx->rxInfo.filename);
+		return 0;
+	}
+
+	return requested;
+}
+
+//negotiates the options of a RRQ/WRQ and builds the OACK into txBuf
+//ctx - pointer to server session context
+// returns number of acknowledged options, 0 - answer the request without OACK
+static int svr_negotiate_options(server_session_t *ctx)
+{
+	const char *value;
+	char str[24];
+	char hex[2 * DIGEST_MAX_LEN + 1];
+	int numAcked = 0;
+	int blksize, windowsize;
+	size_t n = 0;
+
+	ctx->blksize = PROT_MAX_DATA;
+	ctx->windowsize = 1;
+	ctx->rollover = 0;
+	ctx->checksum = DIGEST_NONE;
+	ctx->offset = 0;
+	ctx->length = 0;
+
+	ctx->txBuf[n++] = 0x00;
+	ctx->txBuf[n++] = TFTP_OACK;
+
+	//RFC 2348, options the server does not support are left out of the OACK
+	value = prot_get_option(&ctx->rxInfo, OPT_BLKSIZE);
+
+	if ((value != NULL) && (gBlkSize > 0))
+	{
+		blksize = atoi(value);
+
+		if (blksize >= PROT_MIN_BLKSIZE)
+		{
+			if (blksize > gBlkSize)
+				blksize = gBlkSize;
+
+			ctx->blksize = (uint16_t)blksize;
+
+			snprintf(str, sizeof(str), "%d", blksize);
+			n = prot_put_option(ctx->txBuf, n, OPT_BLKSIZE, str);
+			numAcked++;
+		}
+	}
+
+	//RFC 7440
+	value = prot_get_option(&ctx->rxInfo, OPT_WINDOWSIZE);
+
+	if ((value != NULL) && (gWindowSize > 1))
+	{
+		windowsize = atoi(value);
+
+		if ((windowsize >= 1) && (windowsize <= 65535))
+		{
+			if (windowsize > gWindowSize)
+				windowsize = gWindowSize;
+
+			ctx->windowsize = (uint16_t)windowsize;
+
+			snprintf(str, sizeof(str), "%d", windowsize);
+			n = prot_put_option(ctx->txBuf, n, OPT_WINDOWSIZE, str);
+			numAcked++;
+		}
+	}
+
+	//block number following 65535, 0 is the default
+	value = prot_get_option(&ctx->rxInfo, OPT_ROLLOVER);
+
+	if ((value != NULL) && ((strcmp(value, "0") == 0) || (strcmp(value, "1") == 0)))
+	{
+		ctx->rollover = atoi(value);
+
+		n = prot_put_option(ctx->txBuf, n, OPT_ROLLOVER, value);
+		numAcked++;
+	}
+
+	//checksum of the data sent after the last block, the algorithm is echoed
+	value = prot_get_option(&ctx->rxInfo, OPT_CHECKSUM);
+
+	if ((value != NULL) && (DigestAlg(value) != DIGEST_NONE))
+	{
+		ctx->checksum = DigestAlg(value);
+
+		n = prot_put_option(ctx->txBuf, n, OPT_CHECKSUM, DigestName(ctx->checksum));
+		numAcked++;
+	}
+
+	//resume, a RRQ names the offset of the data the client has, a WRQ the size of the client's file
+	value = prot_get_option(&ctx->rxInfo, OPT_OFFSET);
+
+	if (value != NULL)
+	{
+		ctx->offset = svr_resume_offset(ctx, strtoull(value, NULL, 10));
+
+		snprintf(str, sizeof(str), "%llu", (unsigned long long)ctx->offset);
+		n = prot_put_option(ctx->txBuf, n, OPT_OFFSET, str);
+		numAcked++;
+
+		//the client compares the data before the offset with its file before it continues the upload
+		if ((ctx->rxInfo.optcode == TFTP_WRQ) && (ctx->offset > 0) && (ctx->checksum != DIGEST_NONE) &&
+			resume_digest(ctx->pFile, NULL, ctx->offset, ctx->checksum, hex))
+			n = prot_put_option(ctx->txBuf, n, OPT_OFFSET_SUM, hex);
+	}
+
+	//byte range, the transfer ends length bytes after the offset (parallel download in several sessions)
+	//the range of a netascii file would be counted in converted bytes, it is not supported
+	value = prot_get_option(&ctx->rxInfo, OPT_LENGTH);
+
+	if ((value != NULL) && (ctx->rxInfo.optcode == TFTP_RRQ) && !ctx->isNetascii && (strtoull(value, NULL, 10) > 0))
+	{
+		ctx->length = strtoull(value, NULL, 10);
+
+		snprintf(str, sizeof(str), "%llu", (unsigned long long)ctx->length);
+		n = prot_put_option(ctx->txBuf, n, OPT_LENGTH, str);
+		numAcked++;
+	}
+
+	//RFC 2349, a RRQ asks for the size of the file, a WRQ announces it
+	value = prot_get_option(&ctx->rxInfo, OPT_TSIZE);
+
+	//the size of a file sent in netascii is only known once it has been converted, the option is not acknowledged
+	if ((value != NULL) && !((ctx->rxInfo.optcode == TFTP_RRQ) && ctx->isNetascii))
+	{
+		ctx->tsize = strtoull(value, NULL, 10);
+
+		if (ctx->rxInfo.optcode == TFTP_RRQ)
+			ctx->tsize = svr_file_size(ctx);
+
+		snprintf(str, sizeof(str), "%llu", (unsigned long long)ctx->tsize);
+		n = prot_put_option(ctx->txBuf, n, OPT_TSIZE, str);
+		numAcked++;
+	}
+
+	ctx->rxInfo.blksize = ctx->blksize;
+	ctx->txLen = (uint16_t)n;
+
+	return numAcked;
+}
+
+//asks the kernel to read the file range after the blocks in memory into the page cache
+//ctx - pointer to server session context
+static void svr_prefetch_advise(server_session_t *ctx)
+{
+#ifdef __linux__
+	tx_window_t *w = &ctx->txWin;
+	uint64_t ahead = (uint64_t)gPrefetch * w->blksize;
+	uint64_t start = ctx->adviseEnd;
+	uint64_t end;
+
+	//cached files are in memory, unmapped files read by the I/O threads are prefetched by their read jobs
+	if ((ahead == 0) || w->eof || (ctx->cacheEntry != NULL) || svr_read_async(ctx))
+		return;
+
+	//the hint is renewed once half of it has been sent
+	if (start > (w->mapOffset + (ahead / 2)))
+		return;
+
+	if (start < w->mapOffset)
+		start = w->mapOffset;
+
+	end = w->mapOffset + ahead;
+
+	if (w->map != NULL)
+	{
+		if (end > w->mapLen)
+			end = w->mapLen;
+
+		start &= ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+
+		if (end > start)
+			madvise((void *)&w->map[start], (size_t)(end - start), MADV_WILLNEED);
+	}
+	else
+	{
+		posix_fadvise(fileno(ctx->pFile), (off_t)start, (off_t)(end - start), POSIX_FADV_WILLNEED);
+	}
+
+	ctx->adviseEnd = end;
+#else
+	(void)ctx;
+#endif
+}
+
+//sends the data blocks the window has room for, starting at the send position
+//blocks past the window are then read ahead, so the next ones go out as soon as their ACK arrives
+//ctx - pointer to server session context
+// returns number of new data bytes read from the file, -1 on error
+static int svr_send_window(server_session_t *ctx)
+{
+	tx_window_t *w = &ctx->txWin;
+	uint16_t *len;
+	uint8_t *pkt;
+	int bytesRead = 0;
+	int isReTransmit = 0;
+	const uint8_t *data;
+	int rc;
+
+	if (ctx->isMapFault)
+	{
+		printf("'%s' was truncated while it was sent\n", ctx->filename);
+		return -1;
+	}
+
+	//unmapped files are read ahead by the I/O threads, sending stops at the first block not in yet
+	if (svr_read_async(ctx) && !svr_io_read_ahead(ctx))
+		return -1;
+
+	while (txwin_can_send(w))
+	{
+		if ((w->next == w->filled) && svr_read_async(ctx))
+			break;
+
+		if (w->next == w->filled)
+		{
+			rc = txwin_read_block(w, ctx->pFile);
+
+			if (rc < 0)
+				return -1;
+
+			bytesRead += rc;
+		}
+
+		pkt = txwin_slot(w, w->next, &len);
+		data = txwin_slot_data(w, w->next);
+
+		//blocks read ahead are sent for the first time
+		if (w->next < w->sent)
+		{
+			isReTransmit = 1;
+			ctx->stats.retransmits++;
+		}
+		else
+		{
+			ctx->stats.bytesSent += (uint64_t)(*len - 4);
+		}
+
+		ctx->stats.blocksSent++;
+
+		//a mapped block goes out as header + payload, retransmits need no re-read
+		if (data != NULL)
+			rc = svr_send_iov(ctx, pkt, 4, data, (size_t)(*len - 4));
+		else
+			rc = svr_send_buffer(ctx, pkt, *len);
+
+		if (!rc)
+			return -1;
+
+		w->next++;
+
+		if (w->next > w->sent)
+			w->sent = w->next;
+
+		//the checksum follows the last block, it is resent with it
+		if ((w->digestPktLen > 0) && (w->next - 1 == w->lastBlock) && !svr_send_buffer(ctx, w->digestPkt, w->digestPktLen))
+			return -1;
+	}
+
+	//read inline, the blocks after the window are read now and not when their turn to be sent comes
+	if ((w->map == NULL) && !svr_read_async(ctx))
+	{
+		while ((!w->eof) && ((w->filled - w->base) < w->numSlots))
+		{
+			rc = txwin_read_block(w, ctx->pFile);
+
+			if (rc < 0)
+				return -1;
+
+			bytesRead += rc;
+		}
+	}
+
+	svr_prefetch_advise(ctx);
+
+	//time the ACK of the last block sent, unless it was sent before (Karn's rule)
+	if (isReTransmit)
+		rtt_cancel(&ctx->rtt);
+	else if (w->next != w->base)
+		rtt_start(&ctx->rtt, blk_wire(w->next - 1, w->rollover));
+
+	return bytesRead;
+}
+
+//builds the OACK of a multicast transfer into buf
+//ctx - pointer to server session context
+//hasBlksize - acknowledge the blksize option
+//isMaster - 1 makes the receiving client the master client
+// returns length of the OACK
+static size_t svr_mcast_build_oack(server_session_t *ctx, uint8_t *buf, int hasBlksize, int isMaster)
+{
+	char str[48];
+	size_t n = 0;
+
+	buf[n++] = 0x00;
+	buf[n++] = TFTP_OACK;
+
+	if (hasBlksize)
+	{
+		snprintf(str, sizeof(str), "%hu", ctx->blksize);
+		n = prot_put_option(buf, n, OPT_BLKSIZE, str);
+	}
+
+	//RFC 2090: "<group addr>,<port>,<mc>"
+	snprintf(str, sizeof(str), "%s,%hu,%d", inet_ntoa(ctx->mcast->groupAddr.sin_addr),
+		ntohs(ctx->mcast->groupAddr.sin_port), isMaster);
+
+	return prot_put_option(buf, n, OPT_MULTICAST, str);
+}
+
+//sends an OACK to a member of the multicast transfer
+//ctx - pointer to server session context
+//m - receiving member
+//isMaster - 1 makes the member the master client, the OACK is then resent until it ACKs
+// 0 = failed, 1=success
+static int svr_mcast_send_oack(server_session_t *ctx, const mcast_member_t *m, int isMaster)
+{
+	mcast_group_t *g = ctx->mcast;
+	uint8_t buf[sizeof(g->oackBuf)];
+	size_t n = svr_mcast_build_oack(ctx, buf, m->hasBlksize, isMaster);
+
+	if (isMaster)
+	{
+		memcpy(g->oackBuf, buf, n);
+		g->oackLen = n;
+		g->isOackPending = 1;
+	}
+
+	return svr_send_iov_to(ctx, &m->addr, buf, n, NULL, 0);
+}
+
+//sends a data block to the multicast group
+//ctx - pointer to server session context
+//block - block number
+// 0 = failed, 1=success
+static int svr_mcast_send_block(server_session_t *ctx, uint16_t block)
+{
+	mcast_group_t *g = ctx->mcast;
+	uint64_t offset = (uint64_t)(block - 1) * ctx->blksize;
+	uint8_t hdr[4];
+	size_t len = (size_t)(g->size - offset);
+
+	if (len > ctx->blksize)
+		len = ctx->blksize;
+
+	hdr[0] = 0x00;
+	hdr[1] = TFTP_DATA;
+	hdr[2] = (uint8_t)(block >> 8);
+	hdr[3] = (uint8_t)(block & 0xff);
+
+	//the block in flight is sent again when the master client missed it
+	if (block == ctx->blockNum)
+		ctx->stats.retransmits++;
+	else
+		ctx->stats.bytesSent += len;
+
+	ctx->stats.blocksSent++;
+	ctx->blockNum = block;
+
+	return svr_send_iov_to(ctx, &g->groupAddr, hdr, sizeof(hdr), g->data + offset, len);
+}
+
+//the master client is done or gone, the next member becomes the master client
+//ctx - pointer to server session context
+// returns 1 - new master client, 0 - no members left
+static int svr_mcast_next_master(server_session_t *ctx)
+{
+	mcast_group_t *g = ctx->mcast;
+	mcast_member_t *m = g->members;
+
+	g->members = m->next;
+	g->numMembers--;
+	free(m);
+
+	if (g->members == NULL)
+		return 0;
+
+	ctx->num_retrans_tries = 0;
+	rtt_cancel(&ctx->rtt);
+
+	svr_mcast_send_oack(ctx, g->members, 1);
+	rtt_start(&ctx->rtt, 0);
+
+	UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+	return 1;
+}
+
+//starts a multicast transfer (RFC 2090) if the client asked for one and the server offers it
+//ctx - pointer to server session context, file contents already cached or mapped
+// returns 1 - transfer started, 0 - transfer is served by unicast
+static int svr_mcast_start(server_session_t *ctx)
+{
+	const uint8_t *data = (ctx->cacheEntry != NULL) ? ctx->cacheEntry->data : ctx->map;
+	uint64_t size = (ctx->cacheEntry != NULL) ? ctx->cacheEntry->size : ctx->mapLen;
+	mcast_group_t *g;
+	struct in_addr ifAddr;
+	int slot;
+
+	if ((prot_get_option(&ctx->rxInfo, OPT_MULTICAST) == NULL) || (gMcastAddr.sin_family != AF_INET) || (data == NULL))
+		return 0;
+
+	svr_negotiate_options(ctx);
+	ctx->windowsize = 1;
+	ctx->checksum = DIGEST_NONE;	//the group OACK carries no checksum
+	ctx->offset = 0;				//nor a resume offset or a range, the group gets the whole file
+	ctx->length = 0;
+
+	//block numbers of a group transfer must not wrap
+	if (size / ctx->blksize + 1 > 65535)
+		return 0;
+
+	for (slot = 0; slot < MCAST_MAX_GROUPS; slot++)
+	{
+		if (!(ctx->svr->mcastSlots & (1u << slot)))
+			break;
+	}
+
+	if (slot == MCAST_MAX_GROUPS)
+		return 0;
+
+	g = calloc(1, sizeof(*g));
+
+	if (g == NULL)
+		return 0;
+
+	g->members = calloc(1, sizeof(*g->members));
+
+	if (g->members == NULL)
+	{
+		free(g);
+		return 0;
+	}
+
+	if (gMcastIf != NULL)
+	{
+		ifAddr.s_addr = inet_addr(gMcastIf);
+		setsockopt(ctx->serverSock, IPPROTO_IP, IP_MULTICAST_IF, (const char *)&ifAddr, sizeof(ifAddr));
+	}
+
+	//each concurrent transfer has its own group port, workers use separate port ranges
+	g->groupAddr = gMcastAddr;
+	g->groupAddr.sin_port = htons((uint16_t)(ntohs(gMcastAddr.sin_port) + (ctx->svr->id * MCAST_MAX_GROUPS) + slot));
+	g->slot = slot;
+	g->data = data;
+	g->size = size;
+	g->lastBlock = (uint16_t)(size / ctx->blksize + 1);
+
+	g->members->addr = ctx->clientAddr;
+	g->members->hasBlksize = (prot_get_option(&ctx->rxInfo, OPT_BLKSIZE) != NULL) && (ctx->blksize != PROT_MAX_DATA);
+	g->numMembers = 1;
+
+	//the other group members send their ACKs to this socket too
+	if (ctx->isConnected)
+		ctx->isConnected = !connect_udp_sock(ctx->serverSock, NULL);
+
+	ctx->svr->mcastSlots |= (1u << slot);
+	ctx->mcast = g;
+
+	printf("multicast transfer of '%s' to %s:%hu\n", ctx->filename,
+		inet_ntoa(g->groupAddr.sin_addr), ntohs(g->groupAddr.sin_port));
+
+	svr_mcast_send_oack(ctx, g->members, 1);
+	rtt_start(&ctx->rtt, 0);
+
+	UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+
+	if (!gFsmDebugOn)
+		UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);	//start print progress tmr
+
+	return 1;
+}
+
+//waits for first request from client
+//ctx - pointer to sevrer session context
+// ev - server event
+static void svr_wait_first_request(server_session_t *ctx, int ev)
+{
+	int numOptions;
+	int rc;
+
+	switch(ev)
+	{
+	case EV_SVR_PDU_RX:
+		//octet files are sent as they are, netascii files are converted to and from CR LF line ends
+		ctx->isNetascii = (strcasecmp((char*)ctx->rxInfo.mode, MODE_NETASCII) == 0);
+
+		if (((ctx->rxInfo.optcode == TFTP_WRQ) || (ctx->rxInfo.optcode == TFTP_RRQ)) &&
+			(!ctx->isNetascii) && (strcasecmp((char*)ctx->rxInfo.mode, MODE_OCTET) != 0))
+		{
+			printf("error, unsupported transfer mode '%s'\n", (char*)ctx->rxInfo.mode);
+			svr_send_error_pkt(ctx, 0, "unsupported transfer mode");
+			break;
+		}
+
+		switch(ctx->rxInfo.optcode)
+		{
+		//putfile request, recieving data
+		case TFTP_WRQ:
+			//get filename, open for writing
+			//a resumed upload keeps the partial file, it is truncated to the offset acknowledged
+			if (prot_get_option(&ctx->rxInfo, OPT_OFFSET) != NULL)
+				ctx->pFile = fopen((char*)ctx->rxInfo.filename, "r+b");
+
+			if (ctx->pFile == NULL)
+				ctx->pFile = fopen((char*)ctx->rxInfo.filename, "wb");
+
+			if (ctx->pFile == NULL)
+			{
+				printf("error, failed to open file\n");
+				svr_send_error_pkt(ctx, 1, "file not found");
+				break;
+			}
+
+			ctx->filename = (char*)ctx->rxInfo.filename;
+
+			printf("recieved request to write data to file '%s'\n", ctx->filename);
+
+			//send OACK or first ack with block num = 0;
+			ctx->blockNum = 0;
+			ctx->nextExpectedBlockNum = 1;
+
+			numOptions = svr_negotiate_options(ctx);
+
+			DigestInit(&ctx->rxDigest, ctx->checksum);
+			ctx->hasPeerDigest = 0;
+
+			//space for the announced size is reserved before the first block is acknowledged
+			if (!WriterInit(&ctx->writer, ctx->pFile, ctx->offset, ctx->tsize, gDirectIo, ctx->isNetascii))
+			{
+				printf("error, not enough space for '%s' (%llu bytes)\n", ctx->filename, (unsigned long long)ctx->tsize);
+				svr_send_error_pkt(ctx, 3, "disk full or allocation exceeded");
+				break;
+			}
+
+			if (ctx->offset > 0)
+				printf("resuming upload of '%s' at byte %llu\n", ctx->filename, (unsigned long long)ctx->offset);
+
+			if (numOptions)
+				svr_send_packet_buffer(ctx);
+			else
+				svr_send_ack(ctx);
+
+			rtt_start(&ctx->rtt, 0);
+
+			//start timer
+			UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+
+			if (!gFsmDebugOn)
+				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);	//start print progress tmr
+
+			server_change_state(ctx, SVR_ST_PUTFILE_RXDATA);
+			break;
+
+		//getfile request, sending data
+		case TFTP_RRQ:
+			//hot files are served from the content cache, others are opened for reading
+			//a netascii file is converted as it is read, it is never served from the cache or a mapping
+			if (!ctx->isNetascii)
+				ctx->cacheEntry = CacheAcquire(ctx->svr->cache, (char*)ctx->rxInfo.filename);
+
+			if (ctx->cacheEntry == NULL)
+				ctx->pFile = fopen((char*)ctx->rxInfo.filename, "rb");
+
+			if ((ctx->cacheEntry == NULL) && (ctx->pFile == NULL))
+			{
+				printf("error, failed to open file\n");
+				svr_send_error_pkt(ctx, 1, "file not found");
+				break;
+			}
+
+			ctx->filename = (char*)ctx->rxInfo.filename;
+
+			printf("recieved request to read data from file '%s'\n", ctx->filename);
+
+			if ((ctx->cacheEntry == NULL) && !ctx->isNetascii)
+				svr_map_file(ctx);
+
+#ifdef __linux__
+			//files not mapped are read front to back
+			if ((ctx->cacheEntry == NULL) && (ctx->map == NULL))
+				posix_fadvise(fileno(ctx->pFile), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+			if (svr_mcast_start(ctx))
+			{
+				server_change_state(ctx, SVR_ST_MCAST_TXDATA);
+				break;
+			}
+
+			numOptions = svr_negotiate_options(ctx);
+
+			//the checksum reads every block in this process, a mapped file is read into the window instead
+			if ((ctx->checksum != DIGEST_NONE) && (ctx->map != NULL))
+				svr_unmap_file(ctx);
+
+			if (ctx->cacheEntry != NULL)
+				rc = txwin_init(&ctx->txWin, ctx->blksize, ctx->windowsize, 0, ctx->rollover, ctx->cacheEntry->data, ctx->cacheEntry->size);
+			else if (ctx->map != NULL)
+				rc = txwin_init(&ctx->txWin, ctx->blksize, ctx->windowsize, 0, ctx->rollover, ctx->map, ctx->mapLen);
+			else
+				rc = txwin_init(&ctx->txWin, ctx->blksize, ctx->windowsize, (unsigned)gPrefetch, ctx->rollover, NULL, 0);
+
+			if (rc && ctx->isNetascii)
+				rc = txwin_set_netascii(&ctx->txWin);
+
+			DigestInit(&ctx->txWin.digest, ctx->checksum);
+
+			//a resumed download or a byte range starts at the offset acknowledged, block 1 carries the byte at the offset
+			ctx->txWin.mapOffset = ctx->offset;
+			ctx->ioOffset = ctx->offset;
+
+			if (ctx->length > 0)
+				ctx->txWin.endOffset = ctx->offset + ctx->length;
+
+			//the size and the resume check may have read the file
+			if (rc && (ctx->pFile != NULL))
+				fseeko(ctx->pFile, (off_t)ctx->offset, SEEK_SET);
+
+			if (rc && (ctx->length > 0))
+			{
+				printf("sending bytes %llu-%llu of '%s'\n", (unsigned long long)ctx->offset,
+					(unsigned long long)(ctx->offset + ctx->length - 1), ctx->filename);
+			}
+			else if (rc && (ctx->offset > 0))
+			{
+				printf("resuming download of '%s' at byte %llu\n", ctx->filename, (unsigned long long)ctx->offset);
+			}
+
+			if (!rc)
+			{
+				printf("error, out of memory\n");
+				svr_send_error_pkt(ctx, 0, "out of memory");
+				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+				break;
+			}
+
+			if (numOptions)
+			{
+				//data starts once the client acknowledged the OACK with block 0
+				rc = svr_send_packet_buffer(ctx);
+				rtt_start(&ctx->rtt, 0);
+			}
+			else
+			{
+				//send first data with block num = 1
+				rc = (svr_send_window(ctx) >= 0);
+			}
+
+			//data block, if timeout occurs exit and send error
+			if (!rc)
+			{
+				printf("error sending data packet\n");
+
+				svr_send_error_pkt(ctx,0, "error sending data packet");
+
+				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+				break;
+			}
+
+			//start timer
+			UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+
+			if (!gFsmDebugOn)
+				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);	//start print progress tmr
+
+			server_change_state(ctx, SVR_ST_GETFILE_TXDATA);
+			break;
+
+		default:
+
+			printf("error sending data packet\n");
+			svr_send_error_pkt(ctx,0, "error sending data packet");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+
+		}
+		break;
+
+	default:
+
+		server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+		break;
+
+	}
+}
+
+//sends data to client
+//ctx - pointer to server session context
+// ev - server event
+static void svr_getfile_txData(server_session_t *ctx, int ev)
+{
+	uint64_t base;
+	int rc;
+	io_job_t *job;
+	switch (ev)
+	{
+	case EV_SVR_TIMEOUT:
+		//nothing sent yet, the first blocks are still being read from the file
+		if ((ctx->numIoPending > 0) && (ctx->txWin.next == ctx->txWin.base) && (ctx->txWin.next == ctx->txWin.filled))
+		{
+			UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+			break;
+		}
+
+		//resend ack and incremt retransmission tries, and break
+		ctx->stats.timeouts++;
+
+		if (rtt_backoff(&ctx->rtt))
+			ctx->num_retrans_tries++;
+
+		//close socket if we reach ,ax retransissions and return 0;
+		if (ctx->num_retrans_tries == gMaxNumRetransTries)
+		{
+			ctx->num_retrans_tries = 0;
+
+			printf("reached max number of timouts\n");
+			svr_send_error_pkt(ctx, 0, "timeout waiting for ACK, closing connection\n");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+		}
+
+		if (ctx->txWin.next == ctx->txWin.base)
+		{
+			//resend OACK
+			svr_send_packet_buffer(ctx);
+			ctx->stats.retransmits++;
+		}
+		else
+		{
+			//resend all blocks in flight
+			ctx->txWin.next = ctx->txWin.base;
+
+			if (svr_send_window(ctx) < 0)
+			{
+				svr_send_error_pkt(ctx, 0, "error sending data packet, closing connection");
+
+				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+				break;
+			}
+		}
+
+		UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+		break;
+
+	case EV_SVR_IO_DONE:
+		job = ctx->ioJob;
+
+		//read past the last block
+		if (ctx->txWin.eof)
+			break;
+
+		if (job->isError)
+		{
+			printf("error reading file data, closing connection\n");
+			svr_send_error_pkt(ctx, 0, "error reading file data, closing connection");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+		}
+
+		//reads complete in order, the block fills the next slot
+		ctx->bytesDone += txwin_fill_block(&ctx->txWin, job->result);
+
+		if (svr_send_window(ctx) < 0)
+		{
+			svr_send_error_pkt(ctx,0, "error sending data packet, closing connection");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+		}
+		break;
+
+	case EV_SVR_PDU_RX:
+		//check optcodes
+		switch (ctx->rxInfo.optcode)
+		{
+		case TFTP_ACK:
+			//send next data blocks from file
+			//check block num
+				rtt_sample(&ctx->rtt, ctx->rxInfo.blocknum);
+
+				base = ctx->txWin.base;
+				rc = txwin_ack(&ctx->txWin, ctx->rxInfo.blocknum);
+
+				//an ACK that acknowledges nothing new, the ACK of the OACK (block 0) aside
+				if ((ctx->txWin.base == base) && (ctx->rxInfo.blocknum != 0))
+					ctx->stats.duplicates++;
+
+				if (rc == TXWIN_IGNORE)
+					break;
+
+				// last data block sent was shorter than blksize and is now acknowledged
+				if (rc == TXWIN_DONE)
+				{
+					// close connection, success
+					printf("%s successfully uploaded\nwaiting for next request\n", ctx->filename);
+					ctx->stats.transfersOk = 1;
+
+					server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+					break;
+				}
+
+				if (ctx->txWin.base != base)
+					ctx->num_retrans_tries = 0;
+
+				// send data blocks
+				rc = svr_send_window(ctx);
+
+				if (rc < 0)
+				{
+					svr_send_error_pkt(ctx,0, "error sending data packet, closing connection");
+
+					server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+					break;
+				}
+
+				ctx->bytesDone += (uint64_t)rc;
+
+				if((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
+				{
+					printf("bytes sent: %llu\n", (unsigned long long)ctx->bytesDone);
+					UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
+				}
+
+				//restart tmr
+				UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+
+			break;
+		case TFTP_ERROR:
+			//get error message;
+			printf("error code: %hu\n", ctx->rxInfo.errCode);
+			printf("%s\n", ctx->rxInfo.errMessage);
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+
+		default:
+			printf("error, unexpected optcode\n");
+			svr_send_error_pkt(ctx, 0, "error, unexpected optcode");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+		}
+		break;
+	}
+}
+
+//checks if the last block waits for the checksum of the client
+//ctx - pointer to server session context
+static int svr_digest_pending(const server_session_t *ctx)
+{
+	return (ctx->checksum != DIGEST_NONE) && !ctx->hasPeerDigest;
+}
+
+//completes the file once all of it is written and acknowledges the last block if its checksum matches
+//ctx - pointer to server session context
+static void svr_putfile_done(server_session_t *ctx)
+{
+	if (!WriterFinish(&ctx->writer))
+	{
+		printf("error writing file data, closing connection\n");
+		svr_send_error_pkt(ctx, 0, "error writing file data, closing connection");
+	}
+	else if ((ctx->checksum != DIGEST_NONE) && !prot_verify_digest(&ctx->rxDigest, ctx->peerDigest, ctx->filename))
+	{
+		//the client learns of the corrupt file instead of the final ACK
+		svr_send_error_pkt(ctx, 0, "checksum mismatch");
+	}
+	else
+	{
+		printf("%s has been successfully downloaded\nwaiting for next request\n", ctx->filename);
+		ctx->stats.transfersOk = 1;
+		svr_send_ack(ctx);
+	}
+
+	server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+}
+
+//recieves data from client
+//ctx - pointer to server session context
+// ev - server event
+static void svr_putfile_rxData(server_session_t *ctx, int ev)
+{
+	size_t bytesWritten;
+	uint64_t rxBlock;
+	switch (ev)
+	{
+	case EV_SVR_TIMEOUT:
+		//the client waits for the held ACK, it is sent once the writes caught up
+		if (ctx->isAckHeld)
+		{
+			UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+			break;
+		}
+
+		//resend ack and incremt retransmission tries, and break
+		ctx->stats.timeouts++;
+
+		if (rtt_backoff(&ctx->rtt))
+			ctx->num_retrans_tries++;
+
+		//close socket if we reach ,ax retransissions and return 0;
+		if (ctx->num_retrans_tries == gMaxNumRetransTries)
+		{
+			printf("reached ,max number of timouts\n");
+			svr_send_error_pkt(ctx, 0, "timeout waiting for ACK, closing connection\n");
+
+			ctx->num_retrans_tries = 0;
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+		}
+
+		if (ctx->numUnacked > 0)
+		{
+			//RFC 7440: acknowledge the blocks received so far in the window
+			ctx->blockNum = ctx->nextExpectedBlockNum - 1;
+			ctx->numUnacked = 0;
+			svr_send_ack(ctx);
+		}
+		else
+		{
+			//resend buffer
+			svr_send_packet_buffer(ctx);
+			ctx->stats.retransmits++;
+		}
+
+		UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+		break;
+
+	case EV_SVR_IO_DONE:
+		if (ctx->ioJob->isError)
+		{
+			printf("error writing file data, closing connection\n");
+			svr_send_error_pkt(ctx, 0, "error writing file data, closing connection");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+		}
+
+		if (ctx->isAckHeld && (ctx->numIoPending < IO_MAX_WRITES))
+		{
+			ctx->isAckHeld = 0;
+			svr_send_ack(ctx);
+			rtt_start(&ctx->rtt, blk_wire(ctx->blockNum, ctx->rollover));
+
+			UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+		}
+		break;
+
+	case EV_SVR_PDU_RX:
+
+		switch (ctx->rxInfo.optcode)
+		{
+		case TFTP_DATA:
+			rxBlock = blk_index(ctx->nextExpectedBlockNum, ctx->rxInfo.blocknum, ctx->rollover);
+
+			//compare received block no with expected block no
+			//If they mismatch, ignore the packet and break;
+			if (rxBlock != ctx->nextExpectedBlockNum)
+			{
+				if (rxBlock < ctx->nextExpectedBlockNum)
+					ctx->stats.duplicates++;
+				else
+					ctx->stats.outOfOrder++;
+
+				//a block older than the previous one, the sender went back to resend the gap
+				if (rxBlock < ctx->lastRxBlock)
+					ctx->isGapAcked = 0;
+
+				ctx->lastRxBlock = rxBlock;
+
+				//RFC 7440: a block from further ahead means blocks were lost,
+				//acknowledge the last block received in order once per gap
+				if ((ctx->windowsize > 1) && (!ctx->isGapAcked) && (rxBlock > ctx->nextExpectedBlockNum))
+				{
+					ctx->blockNum = ctx->nextExpectedBlockNum - 1;
+					ctx->numUnacked = 0;
+					ctx->isGapAcked = 1;
+					svr_send_ack(ctx);
+					rtt_cancel(&ctx->rtt);
+				}
+				break;
+			}
+
+			// If they match - proceed
+			// Increment next expeted block number
+			rtt_sample(&ctx->rtt, blk_wire(rxBlock - 1, ctx->rollover));
+			ctx->nextExpectedBlockNum++;
+			ctx->isGapAcked = 0;
+			ctx->lastRxBlock = rxBlock;
+			ctx->num_retrans_tries = 0;
+			ctx->stats.blocksReceived++;
+			ctx->stats.bytesReceived += ctx->rxInfo.dataLen;
+
+			DigestUpdate(&ctx->rxDigest, ctx->rxInfo.data, ctx->rxInfo.dataLen);
+
+			//recieve packet from client and write payload contents into file
+			if (svr_io_write(ctx, ctx->rxInfo.data, ctx->rxInfo.dataLen, ctx->rxInfo.isLastDataBlock))
+				bytesWritten = ctx->rxInfo.dataLen;
+			else
+				bytesWritten = 0;
+
+			if (bytesWritten != ctx->rxInfo.dataLen)
+			{
+				//send error packet
+				printf("error writing file data, closing connection, bytesWritten = %d (%u)\n", (int)bytesWritten, ctx->rxInfo.dataLen);
+
+				svr_send_error_pkt(ctx, 0, "error writing file data, closing connection");
+
+				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+				break;
+			}
+
+			//check if this id the last data packet
+			if (ctx->rxInfo.isLastDataBlock)
+			{
+				ctx->blockNum++;
+
+				//the last block is acknowledged once the whole file is written and its checksum arrived,
+				//the client resends the last block and the checksum until then
+				if ((ctx->numIoPending > 0) || svr_digest_pending(ctx))
+				{
+					if (svr_digest_pending(ctx))
+						UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+					else
+						UtilWheelTimerStop(ctx->wheel, &ctx->tmr1);
+
+					server_change_state(ctx, SVR_ST_PUTFILE_SYNC);
+					break;
+				}
+
+				svr_putfile_done(ctx);
+				break;
+			}
+
+			ctx->bytesDone += bytesWritten;
+
+			if ((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
+			{
+				printf("bytes recieved: %llu\n", (unsigned long long)ctx->bytesDone);
+				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
+			}
+
+			//send ack at the end of each window
+			ctx->blockNum++;
+
+			if (++ctx->numUnacked >= ctx->windowsize)
+			{
+				ctx->numUnacked = 0;
+
+				//the disk is behind the network, holding the ACK back slows the client down
+				if (ctx->numIoPending >= IO_MAX_WRITES)
+				{
+					ctx->isAckHeld = 1;
+				}
+				else
+				{
+					svr_send_ack(ctx);
+					rtt_start(&ctx->rtt, blk_wire(ctx->blockNum, ctx->rollover));
+				}
+			}
+
+			UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+			break;
+
+		case TFTP_DIGEST:
+			//sent right after the last block, it may overtake it
+			if (prot_get_digest(&ctx->rxInfo, ctx->checksum, ctx->peerDigest))
+				ctx->hasPeerDigest = 1;
+			break;
+
+		case TFTP_ERROR:
+			//get error message;
+			printf("error code: %hu\n", ctx->rxInfo.errCode);
+			printf("%s\n", ctx->rxInfo.errMessage);
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+
+		default:
+			printf("error, unexpected optcode\n");
+			svr_send_error_pkt(ctx, 0, "error, unexpected optcode");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+		}
+		break;
+	}
+}
+
+//waits for the file writes to complete and the checksum to arrive before the last block is acknowledged
+//ctx - pointer to server session context
+// ev - server event
+static void svr_putfile_sync(server_session_t *ctx, int ev)
+{
+	switch (ev)
+	{
+	case EV_SVR_IO_DONE:
+		if (ctx->ioJob->isError)
+		{
+			printf("error writing file data, closing connection\n");
+			svr_send_error_pkt(ctx, 0, "error writing file data, closing connection");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			return;
+		}
+		break;
+
+	case EV_SVR_PDU_RX:
+		//a retransmitted last block is answered by the final ACK once the file is written
+		if ((ctx->rxInfo.optcode != TFTP_DIGEST) || !prot_get_digest(&ctx->rxInfo, ctx->checksum, ctx->peerDigest))
+			return;
+
+		ctx->hasPeerDigest = 1;
+		UtilWheelTimerStop(ctx->wheel, &ctx->tmr1);
+		break;
+
+	case EV_SVR_TIMEOUT:
+		if (!svr_digest_pending(ctx))
+			return;
+
+		ctx->stats.timeouts++;
+
+		if (rtt_backoff(&ctx->rtt))
+			ctx->num_retrans_tries++;
+
+		if (ctx->num_retrans_tries == gMaxNumRetransTries)
+		{
+			printf("reached max number of timouts waiting for the checksum\n");
+			svr_send_error_pkt(ctx, 0, "timeout waiting for the checksum, closing connection");
+
+			server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			return;
+		}
+
+		UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+		return;
+
+	default:
+		return;
+	}
+
+	if ((ctx->numIoPending > 0) || svr_digest_pending(ctx))
+		return;
+
+	svr_putfile_done(ctx);
+}
+
+//sends the blocks the master client asks for to the multicast group
+//ctx - pointer to server session context
+// ev - server event
+static void svr_mcast_txData(server_session_t *ctx, int ev)
+{
+	mcast_group_t *g = ctx->mcast;
+	uint16_t ack;
+
+	//the file was cut while it was sent, the group transfer ends
+	if (ctx->isMapFault)
+	{
+		printf("'%s' was truncated while it was sent\n", ctx->filename);
+		server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+		return;
+	}
+
+	switch (ev)
+	{
+	case EV_SVR_TIMEOUT:
+		ctx->stats.timeouts++;
+
+		if (rtt_backoff(&ctx->rtt))
+			ctx->num_retrans_tries++;
+
+		//master client gone, the next member takes over
+		if (ctx->num_retrans_tries == gMaxNumRetransTries)
+		{
+			printf("reached max number of timouts, dropping master client %s:%hu\n",
+				inet_ntoa(g->members->addr.sin_addr), ntohs(g->members->addr.sin_port));
+
+			if (!svr_mcast_next_master(ctx))
+				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+		}
+
+		if (g->isOackPending)
+		{
+			svr_send_iov_to(ctx, &g->members->addr, g->oackBuf, g->oackLen, NULL, 0);
+			ctx->stats.retransmits++;
+		}
+		else
+		{
+			svr_mcast_send_block(ctx, (uint16_t)ctx->blockNum);
+		}
+
+		UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+		break;
+
+	case EV_SVR_PDU_RX:
+		switch (ctx->rxInfo.optcode)
+		{
+		case TFTP_ACK:
+			ack = ctx->rxInfo.blocknum;
+
+			//duplicate ACK of the block before the one in flight (Sorcerer's Apprentice)
+			if ((!g->isOackPending) && (ack == (uint16_t)(ctx->blockNum - 1)))
+				break;
+
+			if (ack > g->lastBlock)
+				break;
+
+			rtt_sample(&ctx->rtt, g->isOackPending ? 0 : ack);
+			g->isOackPending = 0;
+			ctx->num_retrans_tries = 0;
+
+			if (ack == g->lastBlock)
+			{
+				printf("%s:%hu has all of '%s'\n", inet_ntoa(g->members->addr.sin_addr),
+					ntohs(g->members->addr.sin_port), ctx->filename);
+
+				if (!svr_mcast_next_master(ctx))
+				{
+					printf("%s successfully multicast\nwaiting for next request\n", ctx->filename);
+					ctx->stats.transfersOk = 1;
+					server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+				}
+				break;
+			}
+
+			svr_mcast_send_block(ctx, (uint16_t)(ack + 1));
+			rtt_start(&ctx->rtt, (uint16_t)(ack + 1));
+
+			if ((!gFsmDebugOn) && (UtilTickTimerRun(&ctx->tmr2)))
+			{
+				printf("block sent: %hu of %hu, %d clients\n", (uint16_t)ctx->blockNum, g->lastBlock, g->numMembers);
+				UtilTickTimerStart(&ctx->tmr2, PROGRESS_TMR_SEC);
+			}
+
+			UtilWheelTimerStartMs(ctx->wheel, &ctx->tmr1, ctx->rtt.rto);
+			break;
+
+		case TFTP_ERROR:
+			printf("error code: %hu\n", ctx->rxInfo.errCode);
+			printf("%s\n", ctx->rxInfo.errMessage);
+
+			if (!svr_mcast_next_master(ctx))
+				server_change_state(ctx, SVR_ST_WAIT_FIST_REQUEST);
+			break;
+
+		default:
+			break;
+		}
+		break;
+	}
+}
+
+// server finite state machine
+//ctx - pointer to server session context
+// ev - server event
+static void svr_fsm_event(server_session_t *ctx, int ev)
+{
+	if (gFsmDebugOn)
+	{
+		char stateName[64];
+		char eventName[64];
+
+		server_get_state_name(ctx->state, stateName);
+		server_get_event_name(ev, eventName);
+
+		printf("SVR FSM: ev [%s] <-- %s\n",stateName, eventName);
+	}
+
+	switch (ctx->state)
+	{
+	case SVR_ST_GETFILE_TXDATA:
+		svr_getfile_txData(ctx, ev);
+		break;
+
+	case SVR_ST_PUTFILE_RXDATA:
+		svr_putfile_rxData(ctx, ev);
+		break;
+
+	case SVR_ST_MCAST_TXDATA:
+		svr_mcast_txData(ctx, ev);
+		break;
+
+	case SVR_ST_PUTFILE_SYNC:
+		svr_putfile_sync(ctx, ev);
+		break;
+
+	case SVR_ST_WAIT_FIST_REQUEST:
+		svr_wait_first_request(ctx, ev);
+		break;
+	}
+}
+
+//creates client socket
+//client_sock - created socket
+static int create_outgoing_con_sock(SOCKET *client_sock)
+{
+	struct sockaddr_in Addr;
+	SOCKET sock;
+
+	#ifdef _WIN32
+		WSADATA wsaData;
+
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		{
+			printf("Failed to initialize Winsock\n");
+			return 0;
+		}
+	#endif
+
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (sock == INVALID_SOCKET)
+	{
+		printf("failed to create outgoing connection socket\n");
+		return 0;
+	}
+
+	//bind socket
+	memset(&Addr, 0, sizeof(struct sockaddr_in));
+	Addr.sin_addr.s_addr = INADDR_ANY;
+	Addr.sin_family = AF_INET;
+	Addr.sin_port = htons(0);
+
+	if (bind(sock, (struct sockaddr *)&Addr, sizeof(struct sockaddr_in)) == -1)
+	{
+		printf("failed to bind socket to local udp port\n");
+		close_socket(&sock);
+		return 0;
+	}
+
+	*client_sock = sock;
+	return 1;
+}
+
+//runs the client application
+// remote_ip - remote IP address
+//filename - pointer to string buffer containing filename
+//operation - operate request (getfile or putfile)
+// returns 0 - error occured, 1 - session ended normally
+//processes a datagram received from the server
+//ctx - pointer to client session context
+//sock - socket it arrived on, the client socket or the multicast group socket
+//buf, len - datagram
+//from - sender address
+// returns 0 - session ended, 1 - session continues
+static int cl_rx_datagram(client_session_t *ctx, SOCKET sock, const uint8_t *buf, int len, const struct sockaddr_in *from)
+{
+	ctx->packetCount++;
+
+	//the first reply comes from the server TID, the socket only exchanges datagrams with it from now on
+	if ((!ctx->isConnected) && (sock == ctx->clientSock))
+	{
+		//another host is not the server asked, it gets an error and the session keeps waiting (RFC 1350 section 4)
+		if (from->sin_addr.s_addr != ctx->svrAddr.sin_addr.s_addr)
+		{
+			printf("packet from %s:%hu ignored, not the server\n", inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+			send_error_to(ctx->clientSock, from, 5, "unknown transfer ID");
+			return 1;
+		}
+
+		ctx->svrAddr.sin_port = from->sin_port;
+		ctx->isConnected = connect_udp_sock(ctx->clientSock, &ctx->svrAddr);
+	}
+
+	init_receive_pkt(&ctx->rxInfo);
+
+	//call recieve packet function for all packets that are a multiple of 5
+	if (gDebugDropPacket && ((ctx->packetCount % 5) == 0))
+	{
+		printf("%dth packet dropped\n", ctx->packetCount);
+	}
+	else if ((!gDebugDropAllPks) || (ctx->packetCount < 10))
+	{
+		// data received in buf, length od data returned in len
+		if (receive_tftp_pkt(&ctx->rxInfo, buf, len))
+		{
+			if (!cl_fsm_event(ctx, EV_CL_PDU_RX))
+				return 0;
+		}
+		else
+		{
+			printf("receive_tftp_pkt returned 0\n");
+		}
+	}
+
+	return 1;
+}
+
+//milliseconds until the simulated link delivers the next datagram in either direction
+//ctx - pointer to client session context
+static uint32_t cl_impair_next_ms(client_session_t *ctx)
+{
+	uint64_t now = UtilTimeUs();
+	uint32_t tx = ImpairNextMs(&ctx->impairTx, now);
+	uint32_t rx = ImpairNextMs(&ctx->impairRx, now);
+
+	return (tx < rx) ? tx : rx;
+}
+
+//delivers the datagrams that left the delay lines: sends the outgoing ones, processes the received ones
+//ctx - pointer to client session context
+//buf, size - scratch buffer for one datagram
+// returns 0 - session ended, 1 - session continues
+static int cl_impair_run(client_session_t *ctx, uint8_t *buf, size_t size)
+{
+	struct sockaddr_in from;
+	uint32_t tag;
+	int len;
+
+	while ((len = ImpairTake(&ctx->impairTx, UtilTimeUs(), buf, size, &tag)) >= 0)
+		cl_send_raw(ctx, buf, (size_t)len, htons((uint16_t)tag));
+
+	while ((len = ImpairTake(&ctx->impairRx, UtilTimeUs(), buf, size, &tag)) >= 0)
+	{
+		SOCKET sock = (tag & CL_IMPAIR_MCAST) ? ctx->mcastSock : ctx->clientSock;
+
+		//the group was left while the datagram was on its way
+		if (sock == INVALID_SOCKET)
+			continue;
+
+		from = ctx->svrAddr;
+		from.sin_port = htons((uint16_t)tag);
+
+		if (!cl_rx_datagram(ctx, sock, buf, len, &from))
+			return 0;
+	}
+
+	return 1;
+}
+
+//prepares a client session: its socket, event loop and writer thread
+//ctx - pointer to client session context, zeroed
+//remote_ip - server address
+//port - server request port
+//filename - pointer to string buffer containing the filename
+// returns 1=success, 0=failed
+static int cl_session_init(client_session_t *ctx, const char *remote_ip, uint16_t port, const char *filename)
+{
+	ctx->filename = filename;
+	ctx->remoteIpStr = remote_ip;
+	ctx->remotePort = port;
+
+	//resolved once, replies then only change the port
+	ctx->svrAddr.sin_family = AF_INET;
+	ctx->svrAddr.sin_port = htons(port);
+	ctx->svrAddr.sin_addr.s_addr = inet_addr(remote_ip);
+
+	ctx->isFirstDataBlock = 1;
+
+	ctx->blksize = PROT_MAX_DATA;
+	ctx->rxInfo.blksize = PROT_MAX_DATA;
+	ctx->windowsize = 1;
+	ctx->mcastSock = INVALID_SOCKET;
+	rtt_init(&ctx->rtt);
+
+	if (gReportPath != NULL)
+		ctx->rtt.hist = &ctx->rttHist;
+
+	//both directions of the simulated link, different random sequences from the same seed
+	if (gImpairStr != NULL)
+	{
+		ImpairInit(&ctx->impairTx, &gImpair, 0);
+		ImpairInit(&ctx->impairRx, &gImpair, 1);
+	}
+
+	if (!create_outgoing_con_sock(&ctx->clientSock))
+		return 0;
+
+	if (!EvLoopCreate(&ctx->ev) || !EvLoopAdd(&ctx->ev, ctx->clientSock, ctx))
+	{
+		cl_close_file_and_sock(ctx);
+		return 0;
+	}
+
+	//downloaded data is written by a thread, the receive path takes its completions and sleeps on the wakeup fd when it has to wait
+	if (!IoPoolCreate(&ctx->io, (gNumIoThreads > 0) ? 1 : 0) || !IoDoneInit(&ctx->ioDone, &ctx->io))
+	{
+		IoPoolDestroy(&ctx->io);
+		EvLoopDestroy(&ctx->ev);
+		cl_close_file_and_sock(ctx);
+		return 0;
+	}
+
+	return 1;
+}
+
+//sends the request of a session and runs it until the transfer ended, then frees it
+//ctx - pointer to client session context, prepared by cl_session_init
+//operation - getfile or putfile
+static void cl_session_run(client_session_t *ctx, const char *operation)
+{
+	ev_event_t events[2];
+	SOCKET sock;
+	int ret, rc, i;
+	int isActive = 1;
+	uint8_t rxbuf[MAX_RX_BUFF];
+	uint32_t timeout_ms, impair_ms;
+
+	tick_timer_t connectionTmr;	//waitng for connection timer
+	uint32_t ConTimeout = 5;	//seconds
+
+	struct sockaddr_in from;
+
+	ctx->startUs = UtilTimeUs();
+	ctx->startCpuUs = UtilCpuTimeUs();
+
+	send_first_request(ctx, operation, ctx->filename);
+
+	UtilTickTimerStart(&connectionTmr, ConTimeout);
+
+	while (!gDone && isActive)
+	{
+		// potentially perform other tasks
+
+		// sleep until the socket is readable or the retransmission timer expires
+		timeout_ms = UtilTickTimerRemainingMs(&ctx->tmr1);
+
+		if (timeout_ms > LOOP_MAX_SLEEP_MS)
+			timeout_ms = LOOP_MAX_SLEEP_MS;
+
+		//or until the simulated link delivers the next datagram
+		if (gImpairStr != NULL)
+		{
+			impair_ms = cl_impair_next_ms(ctx);
+
+			if (impair_ms < timeout_ms)
+				timeout_ms = impair_ms;
+		}
+
+		ret = EvLoopWait(&ctx->ev, events, 2, (int)timeout_ms);
+
+		for (i = 0; i < ret; i++)
+		{
+			//the multicast group socket is registered with a pointer to it
+			sock = (events[i].ptr == ctx) ? ctx->clientSock : ctx->mcastSock;
+
+			if (sock == INVALID_SOCKET)
+				break;
+
+			// Data is available for reading from the socket
+			// call socket receive function here
+			#ifdef _WIN32
+			int addrlen = sizeof(from);
+				rc = recvfrom(sock, (char *)rxbuf, sizeof(rxbuf), 0, ((struct sockaddr *)&from), &addrlen);
+			#else
+			socklen_t addrlen = sizeof(from);
+				rc = recvfrom(sock, rxbuf, sizeof(rxbuf), 0, ((struct sockaddr *)&from), &addrlen);
+			#endif
+
+			//other senders may use the same group
+			if ((rc > 0) && (sock == ctx->mcastSock) &&
+				((from.sin_addr.s_addr != ctx->svrAddr.sin_addr.s_addr) || (from.sin_port != ctx->svrAddr.sin_port)))
+				continue;
+
+			if (rc > 0)
+			{
+				//the datagram passes the simulated link first, it is processed once it leaves the delay line
+				if (gImpairStr != NULL)
+				{
+					ImpairSubmit(&ctx->impairRx, rxbuf, (size_t)rc,
+						((sock == ctx->mcastSock) ? CL_IMPAIR_MCAST : 0) | ntohs(from.sin_port), UtilTimeUs());
+				}
+				else if (!cl_rx_datagram(ctx, sock, rxbuf, rc, &from))
+				{
+					isActive = 0;
+					break;
+				}
+			}
+			else if (UtilTickTimerRun(&connectionTmr))
+			{
+				printf("no response from server, closing session\n");
+				gDone = 1;
+			}
+		}
+
+		if (isActive && (gImpairStr != NULL) && !cl_impair_run(ctx, rxbuf, sizeof(rxbuf)))
+			isActive = 0;
+
+		if (isActive && UtilTickTimerRun(&ctx->tmr1))
+			cl_fsm_event(ctx, EV_CL_TIMEOUT);
+	}
+
+	cl_close_file_and_sock(ctx);
+
+	if (gImpairStr != NULL)
+	{
+		printf("impairment sent: %llu submitted, %llu dropped, %llu duplicated, %llu reordered\n",
+			(unsigned long long)ctx->impairTx.numSubmitted, (unsigned long long)ctx->impairTx.numDropped,
+			(unsigned long long)ctx->impairTx.numDuplicated, (unsigned long long)ctx->impairTx.numReordered);
+		printf("impairment received: %llu submitted, %llu dropped, %llu duplicated, %llu reordered\n",
+			(unsigned long long)ctx->impairRx.numSubmitted, (unsigned long long)ctx->impairRx.numDropped,
+			(unsigned long long)ctx->impairRx.numDuplicated, (unsigned long long)ctx->impairRx.numReordered);
+
+		ImpairFree(&ctx->impairTx);
+		ImpairFree(&ctx->impairRx);
+	}
+
+	IoDoneDestroy(&ctx->ioDone);
+	IoPoolDestroy(&ctx->io);
+	EvLoopDestroy(&ctx->ev);
+}
+
+static int file_client(const char *remote_ip, const char *filename, const char* operation)
+{
+	memset(&clientCtx, 0, sizeof(clientCtx));
+
+	if (!cl_session_init(&clientCtx, remote_ip, gSrvPort, filename))
+		return 0;
+
+	if (strcmp(operation, "putfile") == 0)
+	{
+		printf("starting TFTP file upload: remote IP %s, port %hu\n", remote_ip, gSrvPort);
+	}
+	else
+	{
+		printf("starting TFTP file download: remote IP %s, port %hu\n", remote_ip, gSrvPort);
+	}
+
+	if (strcmp(operation, "putfile") == 0)
+		clientCtx.pFile = fopen(clientCtx.filename, "rb");
+
+	if ((strcmp(operation, "putfile") == 0) && (clientCtx.pFile == NULL))
+	{
+		printf("error: failed to open file for reading\n");
+		cl_send_error_pkt(&clientCtx, 1, "error, failed to open file for reading");
+		cl_close_file_and_sock(&clientCtx);
+		IoDoneDestroy(&clientCtx.ioDone);
+		IoPoolDestroy(&clientCtx.io);
+		EvLoopDestroy(&clientCtx.ev);
+		return 0;
+	}
+
+	cl_session_run(&clientCtx, operation);
+
+	if (gReportPath != NULL)
+		cl_write_report(&clientCtx, operation);
+
+	return 1;
+}
+
+#ifndef _WIN32
+//runs the session of one byte range of a parallel download
+static void *cl_range_thread(void *arg)
+{
+	cl_session_run((client_session_t *)arg, "getfile");
+	return NULL;
+}
+#endif
+
+//downloads a file in gStreams byte ranges over as many concurrent sessions, one lock-step session
+//cannot fill a path with a large bandwidth-delay product; the sessions are spread over the mirrors round robin
+//a first request only learns the size of the file (tsize), the local file is then preallocated
+//and every session writes its range in place, each in its own thread
+//remote_ips - server addresses separated by commas, mirrors serving the same file, <address>:<port> if not on gSrvPort
+//filename - pointer to string buffer containing the filename
+// returns 1=success, 0=failed
+static int file_client_ranges(const char *remote_ips, const char *filename)
+{
+	char ips[CL_MAX_MIRRORS][INET_ADDRSTRLEN];
+	uint16_t ports[CL_MAX_MIRRORS];
+	client_session_t *streams[CL_MAX_STREAMS];
+	client_session_t *ctx;
+	uint64_t size, rangeLen, startUs, startCpuUs;
+	int numIps = 0;
+	int numStreams = 0;
+	int isOk = 1;
+	int i, b;
+	const char *p = remote_ips;
+	size_t len, ipLen;
+	FILE *pFile;
+
+	//mirror list
+	while ((*p != '\0') && (numIps < CL_MAX_MIRRORS))
+	{
+		len = strcspn(p, ",");
+		ipLen = strcspn(p, ",:");
+
+		if ((ipLen == 0) || (ipLen >= INET_ADDRSTRLEN) || ((ipLen < len) && ((atoi(&p[ipLen + 1]) <= 0) || (atoi(&p[ipLen + 1]) > 65535))))
+		{
+			printf("error: invalid IP address\n");
+			return 0;
+		}
+
+		memcpy(ips[numIps], p, ipLen);
+		ips[numIps][ipLen] = '\0';
+		ports[numIps++] = (ipLen < len) ? (uint16_t)atoi(&p[ipLen + 1]) : gSrvPort;
+		p += len + ((p[len] == ',') ? 1 : 0);
+	}
+
+	startUs = UtilTimeUs();
+	startCpuUs = UtilCpuTimeUs();
+
+	//RFC 2349: the size of the file, from the first mirror
+	ctx = calloc(1, sizeof(*ctx));
+
+	if ((ctx == NULL) || !cl_session_init(ctx, ips[0], ports[0], filename))
+	{
+		free(ctx);
+		return 0;
+	}
+
+	ctx->isProbe = 1;
+	cl_session_run(ctx, "getfile");
+
+	size = ctx->tsize;
+	isOk = ctx->isOk;
+	free(ctx);
+
+	if (!isOk)
+	{
+		printf("error: the size of %s is not known, it cannot be split into ranges\n", filename);
+		return 0;
+	}
+
+	pFile = fopen(filename, "wb");
+
+	if ((pFile == NULL) || !WriterPreallocate(pFile, size))
+	{
+		printf("error: not enough space for %llu bytes\n", (unsigned long long)size);
+
+		if (pFile != NULL)
+			fclose(pFile);
+
+		return 0;
+	}
+
+	fclose(pFile);
+
+	//whole pages per range, the last range is shorter
+	rangeLen = (size + (uint64_t)gStreams - 1) / (uint64_t)gStreams;
+	rangeLen = (rangeLen + WRITER_ALIGN - 1) & ~(uint64_t)(WRITER_ALIGN - 1);
+
+	printf("starting TFTP file download of %llu bytes in %d ranges from %d servers\n",
+		(unsigned long long)size, (int)((size + rangeLen - 1) / ((rangeLen > 0) ? rangeLen : 1)), numIps);
+
+	for (i = 0; (uint64_t)i * rangeLen < size; i++)
+	{
+		ctx = calloc(1, sizeof(*ctx));
+
+		if ((ctx == NULL) || !cl_session_init(ctx, ips[i % numIps], ports[i % numIps], filename))
+		{
+			free(ctx);
+			isOk = 0;
+			break;
+		}
+
+		ctx->offsetAsked = (uint64_t)i * rangeLen;
+		ctx->rangeLen = (size - ctx->offsetAsked < rangeLen) ? size - ctx->offsetAsked : rangeLen;
+		streams[numStreams++] = ctx;
+	}
+
+#ifndef _WIN32
+	pthread_t threads[CL_MAX_STREAMS];
+	sigset_t mask, oldMask;
+
+	//signals are left to the main thread, it runs the first range
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGHUP);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGQUIT);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+
+	for (i = 1; isOk && (i < numStreams); i++)
+	{
+		if (pthread_create(&threads[i], NULL, cl_range_thread, streams[i]) != 0)
+		{
+			printf("failed to start the session of range %d\n", i);
+			break;
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+	//a range that fails stops the others
+	if ((numStreams > 0) && (!isOk || (i < numStreams)))
+		gDone = 1;
+
+	if (numStreams > 0)
+		cl_session_run(streams[0], "getfile");
+
+	while (--i > 0)
+		pthread_join(threads[i], NULL);
+#else
+	//no threads, the ranges are downloaded one after the other
+	for (i = 0; isOk && (i < numStreams); i++)
+		cl_session_run(streams[i], "getfile");
+#endif
+
+	for (i = 0; i < numStreams; i++)
+		isOk = isOk && streams[i]->isOk;
+
+	if (isOk)
+		printf("%s successfully downloaded in %d ranges\n", filename, numStreams);
+	else
+		printf("error: %s incomplete, download it again\n", filename);
+
+	//one report for the whole file, the round trip times of all sessions together
+	if ((gReportPath != NULL) && (numStreams > 0))
+	{
+		ctx = streams[0];
+
+		for (i = 1; i < numStreams; i++)
+		{
+			ctx->rttHist.count += streams[i]->rttHist.count;
+
+			for (b = 0; b < RTT_HIST_BUCKETS; b++)
+				ctx->rttHist.buckets[b] += streams[i]->rttHist.buckets[b];
+		}
+
+		ctx->isOk = isOk;
+		ctx->startUs = startUs;
+		ctx->startCpuUs = startCpuUs;
+		cl_write_report(ctx, "getfile");
+	}
+
+	for (i = 0; i < numStreams; i++)
+		free(streams[i]);
+
+	return isOk;
+}
+
+//creates server socket
+//server_sock - created socket
+static int create_svr_sock(SOCKET *server_sock)
+{
+	struct sockaddr_in Addr;
+	SOCKET sock;
+
+	#ifdef _WIN32
+		WSADATA wsaData;
+
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		{
+			printf("Failed to initialize Winsock\n");
+			return 0;
+		}
+	#endif
+
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (sock == INVALID_SOCKET)
+	{
+		printf("failed to create outgoing connection socket\n");
+		return 0;
+	}
+
+	#ifndef _WIN32
+		// Set SO_REUSEADDR option
+		int opt = 1;
+
+		if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+		{
+			perror("setsockopt failed");
+			close_socket(&sock);
+			return 0;
+		}
+	#endif
+
+	#ifdef __linux__
+		//every worker binds its own socket to the port, the kernel spreads requests across them
+		if ((gNumWorkers > 1) && (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0))
+		{
+			perror("setsockopt(SO_REUSEPORT) failed");
+			close_socket(&sock);
+			return 0;
+		}
+	#endif
+
+	//bind socket
+	memset(&Addr, 0, sizeof(struct sockaddr_in));
+	Addr.sin_addr.s_addr = INADDR_ANY;
+	Addr.sin_family = AF_INET;
+	Addr.sin_port = htons(gSrvPort);
+
+	if (bind(sock, (struct sockaddr *)&Addr, sizeof(struct sockaddr_in)) == -1)
+	{
+		printf("failed to bind socket to local udp port (%s)\n", strerror(errno));
+		close_socket(&sock);
+		return 0;
+	}
+
+	*server_sock = sock;
+	return 1;
+}
+
+//drains up to SVR_RX_BATCH datagrams from a readable socket
+//sock - socket to read from
+//b - receive batch
+// returns number of datagrams received
+static int recv_batch(SOCKET sock, rx_batch_t *b)
+{
+#ifdef __linux__
+	struct mmsghdr msgs[SVR_RX_BATCH];
+	struct iovec iov[SVR_RX_BATCH];
+	int i, n;
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (i = 0; i < SVR_RX_BATCH; i++)
+	{
+		iov[i].iov_base = b->buf[i];
+		iov[i].iov_len = MAX_RX_BUFF;
+		msgs[i].msg_hdr.msg_name = &b->from[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(b->from[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	//the socket is blocking, only take what is already queued
+	n = recvmmsg(sock, msgs, SVR_RX_BATCH, MSG_DONTWAIT, NULL);
+
+	if (n < 0)
+		return 0;
+
+	for (i = 0; i < n; i++)
+		b->len[i] = (int)msgs[i].msg_len;
+
+	return n;
+#elif defined(_WIN32)
+	int addrlen = sizeof(b->from[0]);
+
+	b->len[0] = recvfrom(sock, (char *)b->buf[0], MAX_RX_BUFF, 0, (struct sockaddr *)&b->from[0], &addrlen);
+
+	return (b->len[0] > 0) ? 1 : 0;
+#else
+	socklen_t addrlen = sizeof(b->from[0]);
+
+	b->len[0] = (int)recvfrom(sock, b->buf[0], MAX_RX_BUFF, 0, (struct sockaddr *)&b->from[0], &addrlen);
+
+	return (b->len[0] > 0) ? 1 : 0;
+#endif
+}
+
+//hashes client ip and port into the session table
+//addr - client address
+static unsigned svr_session_hash(const struct sockaddr_in *addr)
+{
+	uint32_t h = (uint32_t)addr->sin_addr.s_addr ^ ((uint32_t)addr->sin_port * 0x9E3779B1u);
+
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+
+	return h & (SVR_SESSION_HASH_SIZE - 1);
+}
+
+//looks up the session belonging to a client
+//svr - pointer to server context
+//addr - client address
+// returns session or NULL if there is none
+static server_session_t *svr_find_session(server_t *svr, const struct sockaddr_in *addr)
+{
+	server_session_t *ctx = svr->hashTbl[svr_session_hash(addr)];
+
+	while (ctx != NULL)
+	{
+		if ((ctx->clientAddr.sin_addr.s_addr == addr->sin_addr.s_addr) &&
+			(ctx->clientAddr.sin_port == addr->sin_port))
+			return ctx;
+
+		ctx = ctx->hashNext;
+	}
+
+	return NULL;
+}
+
+static void svr_session_timeout(void *arg);
+
+#ifdef URING_SUPPORTED
+
+//arms the multishot receive of a fixed file slot, each datagram lands in a provided buffer
+//svr - pointer to server context
+//slot - fixed file slot of the socket
+// 0 = failed, 1=success
+static int svr_uring_arm_recv(server_t *svr, unsigned slot)
+{
+	struct io_uring_sqe *sqe = svr_uring_sqe(svr);
+
+	if (sqe == NULL)
+		return 0;
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = (int)slot;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->addr = (uint64_t)(uintptr_t)&svr->uring.rxMsg;
+	sqe->len = 1;
+	sqe->buf_group = svr->uring.ring.bufGroup;
+	sqe->user_data = ((uint64_t)svr->uring.slotGen[slot] << 32) | ((uint64_t)slot << 3) | URING_TAG_RECV;
+
+	return 1;
+}
+
+//puts a session socket into a free fixed file slot and starts receiving on it
+//svr - pointer to server context
+//ctx - pointer to server session context
+// 0 = failed, 1=success
+static int svr_uring_add_session(server_t *svr, server_session_t *ctx)
+{
+	svr_uring_t *u = &svr->uring;
+	unsigned slot;
+
+	if (u->numFreeSlots == 0)
+		return 0;
+
+	slot = u->freeSlots[u->numFreeSlots - 1];
+
+	if (!UringUpdateFile(&u->ring, slot, ctx->serverSock) || !svr_uring_arm_recv(svr, slot))
+	{
+		UringUpdateFile(&u->ring, slot, -1);
+		return 0;
+	}
+
+	u->numFreeSlots--;
+	u->slotCtx[slot] = ctx;
+	ctx->fileSlot = slot;
+
+	return 1;
+}
+
+//cancels the receive of a session socket and frees its fixed file slot
+//svr - pointer to server context
+//ctx - pointer to server session context
+static void svr_uring_del_session(server_t *svr, server_session_t *ctx)
+{
+	svr_uring_t *u = &svr->uring;
+	unsigned slot = ctx->fileSlot;
+	struct io_uring_sqe *sqe = svr_uring_sqe(svr);
+
+	if (sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = ((uint64_t)u->slotGen[slot] << 32) | ((uint64_t)slot << 3) | URING_TAG_RECV;
+		sqe->user_data = URING_TAG_CANCEL;
+	}
+
+	//completions still posted for the old generation are dropped
+	u->slotGen[slot]++;
+	u->slotCtx[slot] = NULL;
+	UringUpdateFile(&u->ring, slot, -1);
+	u->freeSlots[u->numFreeSlots++] = slot;
+}
+
+#endif // URING_SUPPORTED
+
+//creates a new session with its own TID socket and adds it to the session table
+//svr - pointer to server context
+//addr - client address
+// returns session or NULL on failure
+static server_session_t *svr_create_session(server_t *svr, const struct sockaddr_in *addr)
+{
+	server_session_t *ctx;
+	unsigned h;
+	int rc;
+
+	if (svr->numSessions >= SVR_MAX_SESSIONS)
+		return NULL;
+
+	ctx = calloc(1, sizeof(*ctx));
+
+	if (ctx == NULL)
+		return NULL;
+
+	//RFC 1350: every transfer is served from a newly chosen port (TID)
+	if (!create_outgoing_con_sock(&ctx->serverSock))
+	{
+		free(ctx);
+		return NULL;
+	}
+
+	ctx->svr = svr;
+
+#ifdef URING_SUPPORTED
+	if (svr->uring.isActive)
+		rc = svr_uring_add_session(svr, ctx);
+	else
+#endif
+		rc = EvLoopAdd(&svr->ev, ctx->serverSock, ctx);
+
+	if (!rc)
+	{
+		close_socket(&ctx->serverSock);
+		free(ctx);
+		return NULL;
+	}
+
+	ctx->wheel = &svr->wheel;
+	ctx->ioAffinity = (unsigned)svr->id + (svr->ioNext++ * (unsigned)gNumWorkers);
+	UtilWheelTimerInit(&ctx->tmr1, svr_session_timeout, ctx);
+
+	ctx->clientAddr = *addr;
+	ctx->startMs = UtilTimeMs();
+	rtt_init(&ctx->rtt);
+
+	//a unicast transfer only talks to the client TID, a multicast transfer dissolves this again
+	ctx->isConnected = connect_udp_sock(ctx->serverSock, addr);
+	ctx->state = SVR_ST_WAIT_FIST_REQUEST;
+
+	h = svr_session_hash(addr);
+	ctx->hashNext = svr->hashTbl[h];
+	svr->hashTbl[h] = ctx;
+
+	ctx->next = svr->sessions;
+	if (svr->sessions != NULL)
+		svr->sessions->prev = ctx;
+	svr->sessions = ctx;
+
+	svr->numSessions++;
+	return ctx;
+}
+
+//removes a session from the session table, closes its file and socket
+//the memory is freed by svr_free_destroyed once the events of the loop iteration are handled
+//svr - pointer to server context
+//ctx - pointer to server session context
+static void svr_destroy_session(server_t *svr, server_session_t *ctx)
+{
+	server_session_t **pp = &svr->hashTbl[svr_session_hash(&ctx->clientAddr)];
+
+	while (*pp != ctx)
+		pp = &(*pp)->hashNext;
+
+	*pp = ctx->hashNext;
+
+	if (ctx->prev != NULL)
+		ctx->prev->next = ctx->next;
+	else
+		svr->sessions = ctx->next;
+
+	if (ctx->next != NULL)
+		ctx->next->prev = ctx->prev;
+
+	UtilWheelTimerStop(&svr->wheel, &ctx->tmr1);
+
+#ifdef URING_SUPPORTED
+	if (svr->uring.isActive)
+		svr_uring_del_session(svr, ctx);
+	else
+#endif
+		EvLoopDel(&svr->ev, ctx->serverSock);
+
+	//a transfer that did not complete failed, timed out or was cut off by a shutdown
+	if (!ctx->stats.transfersOk)
+		ctx->stats.transfersFailed = 1;
+
+	MetricsAdd(&svr->stats, &ctx->stats);
+
+	svr_close_file_and_sock(ctx);
+
+	//an event of the same wait (e.g. a datagram after the completion that ended the transfer) still points to it
+	ctx->isDestroyed = 1;
+	ctx->destroyedNext = svr->destroyed;
+	svr->destroyed = ctx;
+
+	svr->numSessions--;
+}
+
+//frees the sessions destroyed since the last call, no event refers to them any more
+//svr - pointer to server context
+static void svr_free_destroyed(server_t *svr)
+{
+	server_session_t *ctx;
+
+	while (svr->destroyed != NULL)
+	{
+		ctx = svr->destroyed;
+		svr->destroyed = ctx->destroyedNext;
+		free(ctx);
+	}
+}
+
+//publishes the counters of the worker and of its active sessions
+//svr - pointer to server context
+static void svr_metrics_publish(server_t *svr)
+{
+	metrics_snapshot_t *snap = &svr->snapshot;
+	metrics_session_t *ms;
+	server_session_t *ctx;
+	uint64_t now = UtilTimeMs();
+	size_t n;
+
+	snap->total = svr->stats;
+	snap->numSessions = (uint32_t)svr->numSessions;
+	snap->numListed = 0;
+
+	for (ctx = svr->sessions; ctx != NULL; ctx = ctx->next)
+	{
+		MetricsAdd(&snap->total, &ctx->stats);
+
+		if (snap->numListed == METRICS_MAX_SESSIONS)
+			continue;
+
+		ms = &snap->sessions[snap->numListed++];
+
+		inet_ntop(AF_INET, &ctx->clientAddr.sin_addr, ms->peer, sizeof(ms->peer));
+		n = strlen(ms->peer);
+		snprintf(&ms->peer[n], sizeof(ms->peer) - n, ":%hu", ntohs(ctx->clientAddr.sin_port));
+		ms->isUpload = (ctx->state == SVR_ST_PUTFILE_RXDATA) || (ctx->state == SVR_ST_PUTFILE_SYNC);
+		ms->elapsedMs = now - ctx->startMs;
+		ms->c = ctx->stats;
+	}
+
+	MetricsPublish(svr->metrics, svr->id, snap);
+}
+
+//timer wheel callback, publishes the counters once per METRICS_INTERVAL_MS
+//arg - pointer to server context
+static void svr_metrics_timeout(void *arg)
+{
+	server_t *svr = (server_t *)arg;
+
+	svr_metrics_publish(svr);
+	UtilWheelTimerStartMs(&svr->wheel, &svr->metricsTmr, METRICS_INTERVAL_MS);
+}
+
+//runs a server session event, reaps the session once its transfer is over
+//svr - pointer to server context
+//ctx - pointer to server session context
+// ev - server event
+// returns 1 - session still active, 0 - session destroyed
+static int svr_session_event(server_t *svr, server_session_t *ctx, int ev)
+{
+	svr_fsm_event(ctx, ev);
+
+	//everything the event produced goes out in one batch, before the socket can be closed
+	svr_flush_tx(svr);
+
+	//the FSM falls back to waiting for a request when the transfer ends or fails
+	if (ctx->state == SVR_ST_WAIT_FIST_REQUEST)
+	{
+		//file jobs and sends still running use the file, the window and the mapping, the session goes once they completed
+		if ((ctx->numIoPending > 0) || (ctx->numTxPending > 0))
+		{
+			ctx->isClosing = 1;
+			UtilWheelTimerStop(&svr->wheel, &ctx->tmr1);
+			return 1;
+		}
+
+		svr_destroy_session(svr, ctx);
+		return 0;
+	}
+
+	return 1;
+}
+
+//runs the completion of a file job in the session that submitted it
+//svr - pointer to server context
+//job - completed job
+static void svr_io_complete(server_t *svr, io_job_t *job)
+{
+	server_session_t *ctx = (server_session_t *)job->owner;
+
+	ctx->numIoPending--;
+	svr->numIoPending--;
+
+	if (!ctx->isClosing)
+	{
+		ctx->ioJob = job;
+		svr_session_event(svr, ctx, EV_SVR_IO_DONE);
+	}
+	else if ((ctx->numIoPending == 0) && (ctx->numTxPending == 0))
+	{
+		svr_destroy_session(svr, ctx);
+	}
+
+	free(job);
+}
+
+//runs the completions of all file jobs completed so far
+//svr - pointer to server context
+static void svr_io_drain(server_t *svr)
+{
+	io_job_t *job;
+
+	IoDoneAck(&svr->ioDone);
+
+	while ((job = IoDonePop(&svr->ioDone)) != NULL)
+		svr_io_complete(svr, job);
+}
+
+//timer wheel callback, retransmission timer of a session expired
+//arg - pointer to session
+static void svr_session_timeout(void *arg)
+{
+	server_session_t *ctx = (server_session_t *)arg;
+
+	svr_session_event(ctx->svr, ctx, EV_SVR_TIMEOUT);
+}
+
+//adds a client asking for a file that is already being multicast to that transfer
+//svr - pointer to server context
+//from - client address
+// returns 1 - client joined, 0 - request is served by its own session
+static int svr_mcast_join(server_t *svr, const struct sockaddr_in *from)
+{
+	server_session_t *ctx;
+	mcast_member_t *m, **pp;
+	const char *value;
+	int blksize;
+
+	if ((svr->rxInfo.optcode != TFTP_RRQ) || (prot_get_option(&svr->rxInfo, OPT_MULTICAST) == NULL))
+		return 0;
+
+	for (ctx = svr->sessions; ctx != NULL; ctx = ctx->next)
+	{
+		if ((ctx->mcast != NULL) && (strcmp(ctx->filename, (const char *)svr->rxInfo.filename) == 0))
+			break;
+	}
+
+	if (ctx == NULL)
+		return 0;
+
+	//all members receive the same blocks, a client can't take part if it can't take the group block size
+	value = prot_get_option(&svr->rxInfo, OPT_BLKSIZE);
+	blksize = (value != NULL) ? atoi(value) : PROT_MAX_DATA;
+
+	if ((blksize < ctx->blksize) || ((value == NULL) && (ctx->blksize != PROT_MAX_DATA)))
+		return 0;
+
+	for (pp = &ctx->mcast->members; *pp != NULL; pp = &(*pp)->next)
+	{
+		//retransmitted request, answer it again
+		if (((*pp)->addr.sin_addr.s_addr == from->sin_addr.s_addr) && ((*pp)->addr.sin_port == from->sin_port))
+		{
+			svr_mcast_send_oack(ctx, *pp, pp == &ctx->mcast->members);
+			svr_flush_tx(svr);
+			return 1;
+		}
+	}
+
+	m = calloc(1, sizeof(*m));
+
+	if (m == NULL)
+		return 0;
+
+	m->addr = *from;
+	m->hasBlksize = (value != NULL) && (ctx->blksize != PROT_MAX_DATA);
+	*pp = m;
+	ctx->mcast->numMembers++;
+
+	printf("%s:%hu joined multicast transfer of '%s'\n", inet_ntoa(from->sin_addr), ntohs(from->sin_port), ctx->filename);
+
+	svr_mcast_send_oack(ctx, m, 0);
+	svr_flush_tx(svr);
+	return 1;
+}
+
+//handles a datagram of a multicast transfer, only the master client drives the transfer
+//svr - pointer to server context
+//ctx - pointer to server session context
+//from - sender address
+// returns 1 - session still active, 0 - session destroyed
+static int svr_mcast_rx(server_t *svr, server_session_t *ctx, const struct sockaddr_in *from)
+{
+	mcast_group_t *g = ctx->mcast;
+	mcast_member_t *m, **pp;
+
+	for (pp = &g->members; *pp != NULL; pp = &(*pp)->next)
+	{
+		if (((*pp)->addr.sin_addr.s_addr == from->sin_addr.s_addr) && ((*pp)->addr.sin_port == from->sin_port))
+			break;
+	}
+
+	if (*pp == NULL)
+	{
+		send_error_to(ctx->serverSock, from, 5, "unknown transfer ID");
+		ctx->stats.errorsSent[5]++;
+		return 1;
+	}
+
+	if (pp == &g->members)
+		return svr_session_event(svr, ctx, EV_SVR_PDU_RX);
+
+	//other members only report that they are done or gone
+	if ((ctx->rxInfo.optcode == TFTP_ERROR) ||
+		((ctx->rxInfo.optcode == TFTP_ACK) && (ctx->rxInfo.blocknum == g->lastBlock)))
+	{
+		m = *pp;
+		*pp = m->next;
+		g->numMembers--;
+		free(m);
+	}
+
+	return 1;
+}
+
+//handles a datagram received on the listening socket
+//svr - pointer to server context
+//rxbuf - received datagram
+//len - length of received datagram
+//from - sender address
+static void svr_listen_rx(server_t *svr, uint8_t *rxbuf, int len, const struct sockaddr_in *from)
+{
+	server_session_t *ctx;
+
+	init_receive_pkt(&svr->rxInfo);
+
+	if (!receive_tftp_pkt(&svr->rxInfo, rxbuf, len))
+	{
+		printf("receive_tftp_pkt() returned 0\n");
+		return;
+	}
+
+	if ((svr->rxInfo.optcode != TFTP_RRQ) && (svr->rxInfo.optcode != TFTP_WRQ))
+	{
+		send_error_to(svr->listenSock, from, 5, "unknown transfer ID");
+		return;
+	}
+
+	//retransmitted request, the session already answers it
+	if (svr_find_session(svr, from) != NULL)
+		return;
+
+	if (svr_mcast_join(svr, from))
+		return;
+
+	ctx = svr_create_session(svr, from);
+
+	if (ctx == NULL)
+	{
+		printf("failed to create session for %s:%hu\n", inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+		send_error_to(svr->listenSock, from, 0, "server busy");
+		return;
+	}
+
+	ctx->rxInfo = svr->rxInfo;
+	svr_session_event(svr, ctx, EV_SVR_PDU_RX);
+}
+
+//handles a datagram received on a session TID socket
+//svr - pointer to server context
+//ctx - pointer to server session context
+//rxbuf - received datagram
+//len - length of received datagram
+//from - sender address
+// returns 1 - session still active, 0 - session destroyed
+static int svr_session_rx(server_t *svr, server_session_t *ctx, uint8_t *rxbuf, int len, const struct sockaddr_in *from)
+{
+	//transfer over, waiting for its file jobs
+	if (ctx->isClosing)
+		return 1;
+
+	if ((ctx->mcast == NULL) &&
+		((from->sin_addr.s_addr != ctx->clientAddr.sin_addr.s_addr) ||
+		(from->sin_port != ctx->clientAddr.sin_port)))
+	{
+		send_error_to(ctx->serverSock, from, 5, "unknown transfer ID");
+		ctx->stats.errorsSent[5]++;
+		return 1;
+	}
+
+	init_receive_pkt(&ctx->rxInfo);
+
+	if (receive_tftp_pkt(&ctx->rxInfo, rxbuf, len))
+	{
+		if (ctx->rxInfo.optcode == TFTP_ERROR)
+			ctx->stats.errorsReceived[(ctx->rxInfo.errCode < METRICS_NUM_ERRORS) ? ctx->rxInfo.errCode : 0]++;
+
+		return (ctx->mcast != NULL) ? svr_mcast_rx(svr, ctx, from) : svr_session_event(svr, ctx, EV_SVR_PDU_RX);
+	}
+
+	printf("receive_tftp_pkt() returned 0\n");
+	return 1;
+}
+
+#ifdef URING_SUPPORTED
+
+//runs the completion of a file job read or written on the ring
+//reads can complete out of order, they are handed to the session in block order
+//svr - pointer to server context
+//job - completed job
+static void svr_uring_io_done(server_t *svr, io_job_t *job)
+{
+	server_session_t *ctx = (server_session_t *)job->owner;
+	io_job_t *prev;
+	int isLast;
+
+	if ((job->op == IO_OP_READ) && (!ctx->isClosing) && (!ctx->txWin.eof) && (job->block != ctx->txWin.filled))
+	{
+		job->next = ctx->ioHeld;
+		ctx->ioHeld = job;
+		return;
+	}
+
+	for (;;)
+	{
+		//held reads are still pending, the session can't go before the last job completed
+		isLast = (ctx->numIoPending == 1);
+		svr_io_complete(svr, job);
+
+		if (isLast)
+			return;
+
+		for (prev = NULL, job = ctx->ioHeld; job != NULL; prev = job, job = job->next)
+		{
+			if (ctx->isClosing || ctx->txWin.eof || (job->block == ctx->txWin.filled))
+				break;
+		}
+
+		if (job == NULL)
+			return;
+
+		if (prev == NULL)
+			ctx->ioHeld = job->next;
+		else
+			prev->next = job->next;
+	}
+}
+
+//handles a receive completion, a datagram for the listening socket (slot 0) or a session socket
+//svr - pointer to server context
+//cqe - completion
+static void svr_uring_rx(server_t *svr, const struct io_uring_cqe *cqe)
+{
+	svr_uring_t *u = &svr->uring;
+	unsigned slot = (unsigned)((cqe->user_data & 0xffffffff) >> 3);
+	uint32_t gen = (uint32_t)(cqe->user_data >> 32);
+	struct io_uring_recvmsg_out *out;
+	struct sockaddr_in *from;
+	uint8_t *payload;
+	uint16_t bid;
+
+	if (cqe->flags & IORING_CQE_F_BUFFER)
+	{
+		bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+		out = (struct io_uring_recvmsg_out *)UringBuf(&u->ring, bid);
+
+		//buffer: header, sender address (msg_namelen bytes), payload
+		from = (struct sockaddr_in *)(out + 1);
+		payload = (uint8_t *)(out + 1) + u->rxMsg.msg_namelen;
+
+		//datagrams are dropped once the server stops, the remaining jobs are only drained
+		if ((gen == u->slotGen[slot]) && (!gDone) && (cqe->res >= (int)(sizeof(*out) + u->rxMsg.msg_namelen)) &&
+			(out->namelen == sizeof(*from)) && !(out->flags & MSG_TRUNC))
+		{
+			if (slot == 0)
+				svr_listen_rx(svr, payload, (int)out->payloadlen, from);
+			else if (out->payloadlen > 0)
+				svr_session_rx(svr, u->slotCtx[slot], payload, (int)out->payloadlen, from);
+		}
+
+		UringBufRecycle(&u->ring, bid);
+	}
+
+	//a multishot receive ends on errors and when the buffers ran out, it goes on while the slot is in use
+	if ((!(cqe->flags & IORING_CQE_F_MORE)) && (gen == u->slotGen[slot]) && ((slot == 0) || (u->slotCtx[slot] != NULL)))
+		svr_uring_arm_recv(svr, slot);
+}
+
+//dispatches a completion of the worker ring
+//svr - pointer to server context
+//cqe - completion
+static void svr_uring_complete(server_t *svr, const struct io_uring_cqe *cqe)
+{
+	void *ptr = (void *)(uintptr_t)(cqe->user_data & ~(uint64_t)URING_TAG_MASK);
+	server_session_t *ctx;
+	uring_tx_t *tx;
+	io_job_t *job;
+
+	switch (cqe->user_data & URING_TAG_MASK)
+	{
+	case URING_TAG_RECV:
+		svr_uring_rx(svr, cqe);
+		break;
+
+	case URING_TAG_SEND:
+		tx = (uring_tx_t *)ptr;
+		ctx = tx->ctx;
+
+		if (cqe->res < 0)
+			printf("sendmsg returns error (%s)\n", strerror(-cqe->res));
+
+		if (cqe->res == -EFAULT)
+			ctx->isMapFault = 1;
+
+		tx->next = svr->uring.freeTx;
+		svr->uring.freeTx = tx;
+		svr->uring.numTxPending--;
+		ctx->numTxPending--;
+
+		if (ctx->isClosing && (ctx->numTxPending == 0) && (ctx->numIoPending == 0))
+			svr_destroy_session(svr, ctx);
+		break;
+
+	case URING_TAG_IO:
+		job = (io_job_t *)ptr;
+
+		//a short read is the end of the file, a short write an error like with the I/O threads
+		job->result = (cqe->res > 0) ? (size_t)cqe->res : 0;
+		job->isError = (cqe->res < 0) || ((job->op == IO_OP_WRITE) && (job->result != job->len));
+
+		svr_uring_io_done(svr, job);
+		break;
+
+	default:
+		break;
+	}
+}
+
+//runs all completions posted so far, including jobs run inline while the ring was full
+//svr - pointer to server context
+static void svr_uring_reap(server_t *svr)
+{
+	struct io_uring_cqe *cqe;
+	struct io_uring_cqe c;
+	io_job_t *job;
+
+	for (;;)
+	{
+		cqe = UringPeekCqe(&svr->uring.ring);
+
+		if (cqe != NULL)
+		{
+			//handlers prepare new SQEs, the completion is copied before its entry is released
+			c = *cqe;
+			UringCqeSeen(&svr->uring.ring);
+			svr_uring_complete(svr, &c);
+		}
+		else if ((job = IoDonePop(&svr->ioDone)) != NULL)
+		{
+			svr_uring_io_done(svr, job);
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+//frees the io_uring engine of a worker
+//svr - pointer to server context
+static void svr_uring_free(server_t *svr)
+{
+	svr_uring_t *u = &svr->uring;
+
+	UringDestroy(&u->ring);
+
+	free(u->slotCtx);
+	free(u->slotGen);
+	free(u->freeSlots);
+	free(u->tx);
+
+	memset(u, 0, sizeof(*u));
+}
+
+//sets up the io_uring engine of a worker: ring, fixed file table, receive buffers, send slots
+//svr - pointer to server context, the listening socket is open
+// returns 1=success, 0=io_uring not available
+static int svr_uring_init(server_t *svr)
+{
+	svr_uring_t *u = &svr->uring;
+	unsigned i;
+
+	memset(u, 0, sizeof(*u));
+
+	if (!UringInit(&u->ring, URING_ENTRIES, URING_CQ_ENTRIES))
+		return 0;
+
+	//one slot per session socket and the listening socket, fewer if the open file limit is lower
+	for (u->numSlots = SVR_MAX_SESSIONS + 1; u->numSlots >= 64; u->numSlots /= 2)
+	{
+		if (UringRegisterFiles(&u->ring, u->numSlots))
+			break;
+	}
+
+	u->slotCtx = calloc(u->numSlots, sizeof(u->slotCtx[0]));
+	u->slotGen = calloc(u->numSlots, sizeof(u->slotGen[0]));
+	u->freeSlots = calloc(u->numSlots, sizeof(u->freeSlots[0]));
+	u->tx = calloc(URING_TX_SLOTS, sizeof(u->tx[0]));
+
+	if ((u->numSlots < 64) || (u->slotCtx == NULL) || (u->slotGen == NULL) || (u->freeSlots == NULL) || (u->tx == NULL) ||
+		!UringSetupBufRing(&u->ring, URING_NUM_BUFS, sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + MAX_RX_BUFF, 0))
+	{
+		svr_uring_free(svr);
+		return 0;
+	}
+
+	//lowest slots are handed out first
+	for (i = u->numSlots - 1; i > 0; i--)
+		u->freeSlots[u->numFreeSlots++] = i;
+
+	for (i = 0; i < URING_TX_SLOTS; i++)
+	{
+		u->tx[i].next = u->freeTx;
+		u->freeTx = &u->tx[i];
+	}
+
+	u->rxMsg.msg_namelen = sizeof(struct sockaddr_in);
+
+	if (!UringUpdateFile(&u->ring, 0, svr->listenSock) || !svr_uring_arm_recv(svr, 0))
+	{
+		svr_uring_free(svr);
+		return 0;
+	}
+
+	u->isActive = 1;
+	return 1;
+}
+
+//runs a server worker on its io_uring engine, datagrams, sends and file jobs all complete on the ring
+//svr - pointer to server context, svr_uring_init succeeded
+// returns 0 - error occurred
+//returns 1 - user ended session
+static int svr_uring_worker(server_t *svr)
+{
+	io_pool_t inlinePool;
+	int ret, rc = 1;
+
+	//no wakeup fd, the queue only holds jobs run inline while the ring was full
+	memset(&inlinePool, 0, sizeof(inlinePool));
+	IoDoneInit(&svr->ioDone, &inlinePool);
+
+	while(!gDone)
+	{
+		//one system call submits everything prepared since the last wait and waits for completions
+		ret = UringSubmitAndWait(&svr->uring.ring, (int)UtilWheelNextTimeoutMs(&svr->wheel, LOOP_MAX_SLEEP_MS));
+
+		if ((ret < 0) && (ret != -EINTR) && (ret != -EBUSY) && (ret != -EAGAIN))
+		{
+			printf("io_uring_enter failed (%s)\n", strerror(-ret));
+			rc = 0;
+			break;
+		}
+
+		UtilWheelUpdateTime(&svr->wheel);
+		svr_uring_reap(svr);
+		UtilWheelRun(&svr->wheel);
+		svr_free_destroyed(svr);
+	}
+
+	//sends and file jobs still running reference their sessions
+	while ((svr->numIoPending > 0) || (svr->uring.numTxPending > 0))
+	{
+		ret = UringSubmitAndWait(&svr->uring.ring, LOOP_MAX_SLEEP_MS);
+
+		if ((ret < 0) && (ret != -EINTR) && (ret != -EBUSY) && (ret != -EAGAIN))
+			break;
+
+		svr_uring_reap(svr);
+	}
+
+	while (svr->sessions != NULL)
+		svr_destroy_session(svr, svr->sessions);
+
+	svr_free_destroyed(svr);
+
+	svr_uring_free(svr);
+	IoDoneDestroy(&svr->ioDone);
+	close_socket(&svr->listenSock);
+	return rc;
+}
+
+#endif // URING_SUPPORTED
+
+//raises the open file limit so that every session can own its TID socket
+static void svr_raise_fd_limit()
+{
+#ifndef _WIN32
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+		return;
+
+	if (rl.rlim_cur < rl.rlim_max)
+	{
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+#endif
+}
+
+//runs one server worker: its own listening socket, event loop, timer wheel and sessions
+//svr - pointer to server context of the worker
+// returns 0 - error occurred
+//returns 1 - user ended session
+static int svr_worker(server_t *svr)
+{
+	ev_event_t events[EV_MAX_EVENTS];
+	int i, j, n, ret;
+	rx_batch_t *rxb = &svr->rxBatch;
+	server_session_t *ctx;
+
+	svr->rxInfo.blksize = PROT_MAX_DATA;
+
+	UtilWheelInit(&svr->wheel);
+
+	if (gMetricsPath != NULL)
+	{
+		UtilWheelTimerInit(&svr->metricsTmr, svr_metrics_timeout, svr);
+		UtilWheelTimerStartMs(&svr->wheel, &svr->metricsTmr, METRICS_INTERVAL_MS);
+	}
+
+	if(!create_svr_sock(&svr->listenSock))
+		return 0;
+
+#ifdef URING_SUPPORTED
+	//the epoll loop below is the fallback when the kernel has no io_uring
+	if (gUseUring)
+	{
+		if (svr_uring_init(svr))
+			return svr_uring_worker(svr);
+
+		printf("io_uring not available, worker %d runs on epoll\n", svr->id);
+	}
+#endif
+
+	//the listening socket is registered with a NULL session pointer
+	if (!EvLoopCreate(&svr->ev) || !EvLoopAdd(&svr->ev, svr->listenSock, NULL))
+	{
+		close_socket(&svr->listenSock);
+		return 0;
+	}
+
+	//file job completions wake the loop through the fd of the completion queue
+	if (!IoDoneInit(&svr->ioDone, svr->io) ||
+		((svr->ioDone.fd != INVALID_SOCKET) && !EvLoopAdd(&svr->ev, svr->ioDone.fd, &svr->ioDone)))
+	{
+		IoDoneDestroy(&svr->ioDone);
+		EvLoopDestroy(&svr->ev);
+		close_socket(&svr->listenSock);
+		return 0;
+	}
+
+	while(!gDone)
+	{
+		// sleep until a socket is readable or the earliest session timer expires
+		ret = EvLoopWait(&svr->ev, events, EV_MAX_EVENTS,
+			(int)UtilWheelNextTimeoutMs(&svr->wheel, LOOP_MAX_SLEEP_MS));
+
+		// one clock read per iteration, timers started below are relative to it
+		UtilWheelUpdateTime(&svr->wheel);
+
+		for (i = 0; i < ret; i++)
+		{
+			ctx = (server_session_t *)events[i].ptr;
+
+			if (events[i].ptr == &svr->ioDone)
+			{
+				svr_io_drain(svr);
+			}
+			else if (ctx == NULL)
+			{
+				n = recv_batch(svr->listenSock, rxb);
+
+				for (j = 0; j < n; j++)
+					svr_listen_rx(svr, rxb->buf[j], rxb->len[j], &rxb->from[j]);
+			}
+			else if (!ctx->isDestroyed)
+			{
+				n = recv_batch(ctx->serverSock, rxb);
+
+				//datagrams left over after the session ended belong to a finished transfer
+				for (j = 0; j < n; j++)
+				{
+					if ((rxb->len[j] > 0) && !svr_session_rx(svr, ctx, rxb->buf[j], rxb->len[j], &rxb->from[j]))
+						break;
+				}
+			}
+		}
+
+		UtilWheelRun(&svr->wheel);
+		svr_free_destroyed(svr);
+	}
+
+	//file jobs still running reference their sessions
+	while (svr->numIoPending > 0)
+	{
+		svr_io_drain(svr);
+
+		#ifndef _WIN32
+			if (svr->numIoPending > 0)
+				usleep(1000);
+		#endif
+	}
+
+	while (svr->sessions != NULL)
+		svr_destroy_session(svr, svr->sessions);
+
+	svr_free_destroyed(svr);
+
+	IoDoneDestroy(&svr->ioDone);
+	EvLoopDel(&svr->ev, svr->listenSock);
+	close_socket(&svr->listenSock);
+	EvLoopDestroy(&svr->ev);
+	return 1;
+}
+
+#ifndef _WIN32
+//thread entry of the workers after the first one
+//arg - pointer to server context of the worker
+static void *svr_worker_thread(void *arg)
+{
+	svr_worker((server_t *)arg);
+	return NULL;
+}
+#endif
+
+//runs the server application, gNumWorkers workers share the port and the content cache
+// returns 0 - error occurred
+//returns 1 - user ended session
+static int file_server()
+{
+	content_cache_t cache;
+	io_pool_t io;
+	metrics_t metrics;
+	server_t **workers;
+	int i, rc;
+
+#ifndef _WIN32
+	pthread_t *threads;
+	sigset_t mask, oldMask;
+#endif
+
+	CacheInit(&cache, (uint64_t)gCacheMb * 1024 * 1024);
+
+	if (gCacheManifest != NULL)
+	{
+		rc = CacheLoadManifest(&cache, gCacheManifest);
+
+		if (rc < 0)
+			printf("failed to open cache manifest '%s'\n", gCacheManifest);
+		else
+			printf("cache: %d files pre-warmed, %llu bytes\n", rc, (unsigned long long)cache.used);
+	}
+
+	svr_raise_fd_limit();
+
+	if (!MetricsCreate(&metrics, gNumWorkers, gMetricsPath))
+	{
+		printf("failed to export metrics to '%s'\n", gMetricsPath);
+		CacheDestroy(&cache);
+		return 0;
+	}
+
+	if (!IoPoolCreate(&io, gNumIoThreads))
+	{
+		MetricsDestroy(&metrics);
+		CacheDestroy(&cache);
+		return 0;
+	}
+
+	//files missing from the cache are loaded on the pool, not by the worker that asked for them
+	cache.io = &io;
+
+	workers = calloc((size_t)gNumWorkers, sizeof(*workers));
+
+	if (workers == NULL)
+	{
+		IoPoolDestroy(&io);
+		MetricsDestroy(&metrics);
+		CacheDestroy(&cache);
+		return 0;
+	}
+
+	for (i = 0; i < gNumWorkers; i++)
+	{
+		workers[i] = calloc(1, sizeof(server_t));
+
+		if (workers[i] == NULL)
+			break;
+
+		workers[i]->id = i;
+		workers[i]->cache = &cache;
+		workers[i]->io = &io;
+		workers[i]->metrics = &metrics;
+	}
+
+	if (i < gNumWorkers)
+	{
+		printf("error, out of memory\n");
+		rc = 0;
+	}
+	else if (gNumWorkers == 1)
+	{
+		printf("server up, waiting for client requests\n");
+		rc = svr_worker(workers[0]);
+	}
+	else
+	{
+#ifndef _WIN32
+		threads = calloc((size_t)gNumWorkers, sizeof(*threads));
+
+		//signals are left to the main thread, it runs worker 0
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGHUP);
+		sigaddset(&mask, SIGTERM);
+		sigaddset(&mask, SIGINT);
+		sigaddset(&mask, SIGQUIT);
+		pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+
+		for (i = 1; (threads != NULL) && (i < gNumWorkers); i++)
+		{
+			if (pthread_create(&threads[i], NULL, svr_worker_thread, workers[i]) != 0)
+			{
+				printf("failed to start worker %d\n", i);
+				break;
+			}
+		}
+
+		pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+		if ((threads != NULL) && (i == gNumWorkers))
+		{
+			printf("server up, %d workers waiting for client requests\n", gNumWorkers);
+			rc = svr_worker(workers[0]);
+		}
+		else
+		{
+			rc = 0;
+		}
+
+		//workers see gDone within LOOP_MAX_SLEEP_MS
+		gDone = 1;
+
+		while (--i > 0)
+			pthread_join(threads[i], NULL);
+
+		free(threads);
+#else
+		rc = 0;
+#endif
+	}
+
+	//the workers are done, the export ends with their final counters
+	for (i = 0; i < gNumWorkers; i++)
+	{
+		if (workers[i] != NULL)
+			svr_metrics_publish(workers[i]);
+
+		free(workers[i]);
+	}
+
+	free(workers);
+	IoPoolDestroy(&io);
+	MetricsDestroy(&metrics);
+	CacheDestroy(&cache);
+	return rc;
+}
+
+// <operating mode> <Server Port Number> <Remote IP Address><Operation> <Filename> <Fsm_debug_on> <DebugDropTxAckOn><max_retransmission_tries> <drop all packes>
+// example: TFTP.exe -m server -p 1234 -r 198.678.0.8 -o putfile -f filename.txt
+int main(int argc, char *argv[])
+{
+	int c, isClient;
+
+	const char * op_mode = NULL;
+	const char* remote_ip_str = NULL;
+	const char * operation_str = NULL;
+	const char* filename = NULL;
+	int Fsm_debug_on = 0;
+	int DebugDropTxPacket = 0;
+	const char *engine_str = "epoll";
+	const char *transfer_mode = MODE_OCTET;
+	const char *checksum_str = NULL;
+
+	static const char *kOptString = "m:p:r:o:f:d:D:M:A:b:w:c:l:g:I:t:j:e:O:P:x:R:N:B:T:C:s:n:";
+
+	static const struct option kLongOpts[] =
+	{
+		{ "operating mode",  required_argument, NULL, 'm' },
+		{ "Server Port Number",  required_argument, NULL, 'p'},
+		{ "Remote IP Address",  required_argument, NULL, 'r'},
+		{ "Operation",  required_argument, NULL, 'o'},
+		{ "Filename",  required_argument, NULL, 'f'},
+		{ "Fsm_debug_on",  required_argument, NULL, 'd'},
+		{ "DebugDropTxPacket",  required_argument, NULL, 'D'},
+		{"max_retransmission_tries", required_argument, NULL, 'M'},
+		{"drop all packets", required_argument, NULL, 'A'},
+		{"blksize", required_argument, NULL, 'b'},
+		{"windowsize", required_argument, NULL, 'w'},
+		{"cache", required_argument, NULL, 'c'},
+		{"cache manifest", required_argument, NULL, 'l'},
+		{"multicast", required_argument, NULL, 'g'},
+		{"multicast interface", required_argument, NULL, 'I'},
+		{"workers", required_argument, NULL, 't'},
+		{"io threads", required_argument, NULL, 'j'},
+		{"engine", required_argument, NULL, 'e'},
+		{"direct io", required_argument, NULL, 'O'},
+		{"prefetch", required_argument, NULL, 'P'},
+		{"metrics", required_argument, NULL, 'x'},
+		{"report", required_argument, NULL, 'R'},
+		{"impairment", required_argument, NULL, 'N'},
+		{"rollover", required_argument, NULL, 'B'},
+		{"transfer mode", required_argument, NULL, 'T'},
+		{"checksum", required_argument, NULL, 'C'},
+		{"resume", required_argument, NULL, 's'},
+		{"streams", required_argument, NULL, 'n'},
+		{ NULL, 0, NULL, 0 }
+	};
+
+	if (argc < 1)
+	{
+		help();
+		return 0;
+	}
+
+	while ((c = getopt_long(argc, argv, kOptString, kLongOpts, NULL)) != -1)
+	{
+		switch (c)
+		{
+			case 'm': op_mode = optarg;break;
+			case 'p': gSrvPort = (uint16_t)atoi(optarg); break;
+			case 'r': remote_ip_str = optarg; break;
+			case 'o' : operation_str = optarg; break;
+			case 'f' : filename = optarg; break;
+			case'd' : Fsm_debug_on = atoi(optarg); break;
+			case 'D' : DebugDropTxPacket = atoi(optarg); break;
+			case 'M' : gMaxNumRetransTries = atoi(optarg); break;
+			case 'A' : gDebugDropAllPks= atoi(optarg); break;
+			case 'b' : gBlkSize = atoi(optarg); break;
+			case 'w' : gWindowSize = atoi(optarg); break;
+			case 'c' : gCacheMb = atoi(optarg); break;
+			case 'l' : gCacheManifest = optarg; break;
+			case 'g' : gMcastStr = optarg; break;
+			case 'I' : gMcastIf = optarg; break;
+			case 't' : gNumWorkers = atoi(optarg); break;
+			case 'j' : gNumIoThreads = atoi(optarg); break;
+			case 'e' : engine_str = optarg; break;
+			case 'O' : gDirectIo = atoi(optarg); break;
+			case 'P' : gPrefetch = atoi(optarg); break;
+			case 'x' : gMetricsPath = optarg; break;
+			case 'R' : gReportPath = optarg; break;
+			case 'N' : gImpairStr = optarg; break;
+			case 'B' : gRollover = atoi(optarg); break;
+			case 'T' : transfer_mode = optarg; break;
+			case 'C' : checksum_str = optarg; break;
+			case 's' : gResume = atoi(optarg); break;
+			case 'n' : gStreams = atoi(optarg); break;
+
+			default : help(); return 0;
+		}
+	}
+
+	isClient = 0;
+
+	if (gSrvPort == 0)
+	{
+		printf("error, invalid port number\n");
+		return 0;
+	}
+
+	if ((strcmp(op_mode, "client") != 0) && (strcmp(op_mode, "server") != 0))
+	{
+		printf("error: invalid operating mode\n");
+		return 0;
+	}
+
+	isClient = (strcmp(op_mode, "client") == 0) ? 1 : 0;
+
+	//client requests DEF_BLKSIZE, server accepts up to the RFC 2348 maximum
+	if (gBlkSize < 0)
+		gBlkSize = (isClient) ? DEF_BLKSIZE : PROT_MAX_BLKSIZE;
+
+	if ((gBlkSize != 0) && ((gBlkSize < PROT_MIN_BLKSIZE) || (gBlkSize > PROT_MAX_BLKSIZE)))
+	{
+		printf("error: invalid block size, valid range is %d-%d (0 = no blksize option)\n", PROT_MIN_BLKSIZE, PROT_MAX_BLKSIZE);
+		return 0;
+	}
+
+	//client requests DEF_WINDOWSIZE, server accepts up to MAX_WINDOWSIZE
+	if (gWindowSize < 0)
+		gWindowSize = (isClient) ? DEF_WINDOWSIZE : MAX_WINDOWSIZE;
+
+	if ((gWindowSize < 1) || (gWindowSize > 65535))
+	{
+		printf("error: invalid window size, valid range is 1-65535 (1 = no windowsize option)\n");
+		return 0;
+	}
+
+	if (gCacheMb < 0)
+	{
+		printf("error: invalid cache size\n");
+		return 0;
+	}
+
+	//server workers, 0 = one per core
+	if (gNumWorkers == 0)
+	{
+		#ifdef _WIN32
+			gNumWorkers = 1;
+		#else
+			gNumWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		#endif
+	}
+
+	#ifndef __linux__
+		//several workers need SO_REUSEPORT load balancing
+		if (gNumWorkers > 1)
+		{
+			printf("several server workers are not supported on this platform, running one\n");
+			gNumWorkers = 1;
+		}
+	#endif
+
+	if ((gNumWorkers < 1) || (gNumWorkers > SVR_MAX_WORKERS))
+	{
+		printf("error: invalid number of workers, valid range is 1-%d (0 = one per core)\n", SVR_MAX_WORKERS);
+		return 0;
+	}
+
+	if ((gNumIoThreads < 0) || (gNumIoThreads > IO_MAX_THREADS))
+	{
+		printf("error: invalid number of I/O threads, valid range is 0-%d (0 = file I/O in the network loop)\n", IO_MAX_THREADS);
+		return 0;
+	}
+
+	if ((gPrefetch < 0) || (gPrefetch > MAX_PREFETCH_BLOCKS))
+	{
+		printf("error: invalid prefetch, valid range is 0-%d blocks\n", MAX_PREFETCH_BLOCKS);
+		return 0;
+	}
+
+	if ((gRollover < -1) || (gRollover > 1))
+	{
+		printf("error: invalid rollover, valid values are 0 and 1 (-1 = no rollover option)\n");
+		return 0;
+	}
+
+	if ((strcasecmp(transfer_mode, MODE_OCTET) != 0) && (strcasecmp(transfer_mode, MODE_NETASCII) != 0))
+	{
+		printf("error: invalid transfer mode, valid modes are octet and netascii\n");
+		return 0;
+	}
+
+	gNetascii = (strcasecmp(transfer_mode, MODE_NETASCII) == 0);
+
+	//blocks of a group transfer arrive in any order, they cannot be converted one after the other
+	if (isClient && gNetascii && (gMcastStr != NULL))
+	{
+		printf("error: multicast transfers are octet only\n");
+		return 0;
+	}
+
+	if (checksum_str != NULL)
+	{
+		gChecksum = DigestAlg(checksum_str);
+
+		if (gChecksum == DIGEST_NONE)
+		{
+			printf("error: invalid checksum, valid checksums are crc32c and sha256\n");
+			return 0;
+		}
+
+		//the checksum is computed in block order, the blocks of a group transfer arrive in any order
+		if (isClient && (gMcastStr != NULL))
+		{
+			printf("error: multicast transfers are not checksummed\n");
+			return 0;
+		}
+	}
+
+	//the members of a group get the whole file
+	if (isClient && gResume && (gMcastStr != NULL))
+	{
+		printf("error: multicast transfers cannot be resumed\n");
+		return 0;
+	}
+
+	if ((gStreams < 1) || (gStreams > CL_MAX_STREAMS))
+	{
+		printf("error: invalid number of streams, valid range is 1-%d\n", CL_MAX_STREAMS);
+		return 0;
+	}
+
+	//the ranges are byte ranges of the file as it is stored, downloaded into a new file
+	if (isClient && (gStreams > 1) && ((strcmp(operation_str, "getfile") != 0) || gNetascii || gResume || (gMcastStr != NULL)))
+	{
+		printf("error: several streams are supported for octet downloads only, without resume or multicast\n");
+		return 0;
+	}
+
+	if ((gImpairStr != NULL) && !ImpairParse(&gImpair, gImpairStr))
+	{
+		printf("error: invalid impairment '%s', see help\n", gImpairStr);
+		return 0;
+	}
+
+	if ((strcasecmp(engine_str, "epoll") != 0) && (strcasecmp(engine_str, "uring") != 0))
+	{
+		printf("error: invalid engine, valid engines are epoll and uring\n");
+		return 0;
+	}
+
+	gUseUring = (strcasecmp(engine_str, "uring") == 0);
+
+	#ifndef URING_SUPPORTED
+		if ((!isClient) && gUseUring)
+		{
+			printf("io_uring is not supported on this platform, using the default engine\n");
+			gUseUring = 0;
+		}
+	#endif
+
+	//server offers multicast transfers on <group address>:<port>, one port per concurrent transfer of each worker
+	if ((!isClient) && (gMcastStr != NULL))
+	{
+		const char *sep = strchr(gMcastStr, ':');
+		char groupIp[INET_ADDRSTRLEN];
+
+		memset(&gMcastAddr, 0, sizeof(gMcastAddr));
+
+		if ((sep == NULL) || ((size_t)(sep - gMcastStr) >= sizeof(groupIp)) || (atoi(sep + 1) <= 0) ||
+			(atoi(sep + 1) > 65535 - (MCAST_MAX_GROUPS * gNumWorkers)))
+		{
+			printf("error: invalid multicast group, expected <group address>:<port>\n");
+			return 0;
+		}
+
+		memcpy(groupIp, gMcastStr, (size_t)(sep - gMcastStr));
+		groupIp[sep - gMcastStr] = '\0';
+
+		gMcastAddr.sin_family = AF_INET;
+		gMcastAddr.sin_port = htons((uint16_t)atoi(sep + 1));
+		gMcastAddr.sin_addr.s_addr = inet_addr(groupIp);
+
+		if (!IN_MULTICAST(ntohl(gMcastAddr.sin_addr.s_addr)))
+		{
+			printf("error: %s is not a multicast address\n", groupIp);
+			return 0;
+		}
+	}
+
+	if ((isClient) && ((strcmp(operation_str, "getfile") != 0) && (strcmp(operation_str, "putfile") != 0)))
+	{
+		printf("error: invalid operation request\n");
+		return 0;
+	}
+
+	if ((isClient == 1) && (strcmp(remote_ip_str, "0.0.0.0") == 0))
+	{
+		printf("error: invalid IP address\n");
+		return 0;
+	}
+
+	#ifdef _WIN32
+		SetConsoleCtrlHandler(signal_handler, TRUE);
+	#else
+		signal(SIGHUP, signal_handler);
+		signal(SIGTERM, signal_handler);
+		signal(SIGINT, signal_handler);
+		signal(SIGQUIT, signal_handler);
+	#endif
+
+	if (Fsm_debug_on > 0)
+		gFsmDebugOn = 1;
+
+	if (DebugDropTxPacket > 0)
+		gDebugDropPacket= 1;
+
+	if (isClient == 0)
+	{
+		file_server();
+	}
+	else
+	{
+		if (gStreams > 1)
+			file_client_ranges(remote_ip_str, filename);
+		else
+			file_client(remote_ip_str,filename, operation_str);
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,459 @@
+//
+//Transfer metrics, counters of the server workers in the Prometheus text format
+//scraped from a UNIX socket or written to a textfile (node exporter textfile collector)
+//
+
+#include "metrics.h"
+#include "tmr.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+	#include <errno.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <sys/socket.h>
+	#include <sys/time.h>
+	#include <sys/un.h>
+#endif
+
+static void metrics_lock(metrics_t *m)
+{
+	#ifdef _WIN32
+		EnterCriticalSection(&m->lock);
+	#else
+		pthread_mutex_lock(&m->lock);
+	#endif
+}
+
+static void metrics_unlock(metrics_t *m)
+{
+	#ifdef _WIN32
+		LeaveCriticalSection(&m->lock);
+	#else
+		pthread_mutex_unlock(&m->lock);
+	#endif
+}
+
+//writes a label value, backslash, double quote and newline escaped
+static void metrics_put_label(FILE *f, const char *s)
+{
+	for (; *s != '\0'; s++)
+	{
+		if (*s == '\n')
+			fputs("\\n", f);
+		else if ((*s == '\\') || (*s == '"'))
+			fprintf(f, "\\%c", *s);
+		else
+			fputc(*s, f);
+	}
+}
+
+static void metrics_put_header(FILE *f, const char *name, const char *type, const char *help)
+{
+	fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+//writes the textfile, renamed into place so the collector never reads half of it
+// returns 1=success, 0=failed
+static int metrics_write_file(metrics_t *m)
+{
+	size_t len = strlen(m->path);
+	char *tmp = malloc(len + 5);
+	FILE *f;
+	int rc;
+
+	if (tmp == NULL)
+		return 0;
+
+	memcpy(tmp, m->path, len);
+	memcpy(&tmp[len], ".tmp", 5);
+
+	f = fopen(tmp, "w");
+
+	if (f == NULL)
+	{
+		free(tmp);
+		return 0;
+	}
+
+	rc = MetricsWrite(m, f);
+
+	if ((fclose(f) != 0) || !rc)
+		rc = 0;
+
+	#ifdef _WIN32
+		remove(m->path);
+	#endif
+
+	if (rc && (rename(tmp, m->path) != 0))
+		rc = 0;
+
+	free(tmp);
+	return rc;
+}
+
+#ifndef _WIN32
+
+//answers one scrape, any request gets the metrics as an HTTP/1.0 response
+//fd - accepted connection
+static void metrics_serve(metrics_t *m, int fd)
+{
+	struct pollfd pfd;
+	struct timeval tv;
+	char req[1024];
+	FILE *f;
+
+	//the request is read (not parsed) so closing the connection doesn't reset it
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	if (poll(&pfd, 1, 100) > 0)
+		(void)!recv(fd, req, sizeof(req), MSG_DONTWAIT);
+
+	//a client that stops reading fails the scrape instead of stalling the export
+	tv.tv_sec = METRICS_SEND_TIMEOUT_MS / 1000;
+	tv.tv_usec = (METRICS_SEND_TIMEOUT_MS % 1000) * 1000;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	f = fdopen(fd, "w");
+
+	if (f == NULL)
+	{
+		close(fd);
+		return;
+	}
+
+	fputs("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n", f);
+	MetricsWrite(m, f);
+	fclose(f);
+}
+
+static void *metrics_thread(void *arg)
+{
+	metrics_t *m = (metrics_t *)arg;
+	struct pollfd pfd;
+	int stop, fd;
+
+	for (;;)
+	{
+		metrics_lock(m);
+		stop = m->stop;
+		metrics_unlock(m);
+
+		if (stop)
+			break;
+
+		if (m->sock < 0)
+		{
+			metrics_write_file(m);
+			usleep(METRICS_INTERVAL_MS * 1000);
+			continue;
+		}
+
+		pfd.fd = m->sock;
+		pfd.events = POLLIN;
+
+		if (poll(&pfd, 1, METRICS_INTERVAL_MS) <= 0)
+			continue;
+
+		fd = accept(m->sock, NULL, NULL);
+
+		if (fd >= 0)
+			metrics_serve(m, fd);
+	}
+
+	return NULL;
+}
+
+//creates the listening UNIX socket, a socket file left over by an earlier run is replaced
+// returns socket, -1 on failure
+static int metrics_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(fd, 16) != 0))
+	{
+		printf("failed to listen on metrics socket '%s' (%s)\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+#endif // _WIN32
+
+int MetricsCreate(metrics_t *m, int numWorkers, const char *path)
+{
+	memset(m, 0, sizeof(*m));
+	m->sock = -1;
+	m->numWorkers = numWorkers;
+	m->path = path;
+	m->rateMs = UtilTimeMs();
+
+	m->workers = calloc((size_t)numWorkers, sizeof(m->workers[0]));
+
+	if (m->workers == NULL)
+		return 0;
+
+	#ifdef _WIN32
+		InitializeCriticalSection(&m->lock);
+	#else
+		pthread_mutex_init(&m->lock, NULL);
+	#endif
+
+	if (path == NULL)
+		return 1;
+
+	if (strncmp(path, METRICS_UNIX_PREFIX, strlen(METRICS_UNIX_PREFIX)) == 0)
+	{
+	#ifdef _WIN32
+		printf("metrics on a UNIX socket are not supported on this platform\n");
+		m->path = NULL;
+		MetricsDestroy(m);
+		return 0;
+	#else
+		m->sock = metrics_listen(path + strlen(METRICS_UNIX_PREFIX));
+
+		if (m->sock < 0)
+		{
+			MetricsDestroy(m);
+			return 0;
+		}
+	#endif
+	}
+
+	#ifndef _WIN32
+		if (pthread_create(&m->thread, NULL, metrics_thread, m) != 0)
+		{
+			MetricsDestroy(m);
+			return 0;
+		}
+
+		m->hasThread = 1;
+	#endif
+
+	return 1;
+}
+
+void MetricsAdd(metrics_counters_t *dst, const metrics_counters_t *src)
+{
+	int i;
+
+	dst->bytesSent += src->bytesSent;
+	dst->bytesReceived += src->bytesReceived;
+	dst->blocksSent += src->blocksSent;
+	dst->blocksReceived += src->blocksReceived;
+	dst->retransmits += src->retransmits;
+	dst->duplicates += src->duplicates;
+	dst->outOfOrder += src->outOfOrder;
+	dst->timeouts += src->timeouts;
+
+	for (i = 0; i < METRICS_NUM_ERRORS; i++)
+	{
+		dst->errorsSent[i] += src->errorsSent[i];
+		dst->errorsReceived[i] += src->errorsReceived[i];
+	}
+
+	dst->transfersOk += src->transfersOk;
+	dst->transfersFailed += src->transfersFailed;
+}
+
+void MetricsPublish(metrics_t *m, int worker, const metrics_snapshot_t *s)
+{
+	//only the part of the list in use is copied
+	metrics_lock(m);
+	memcpy(&m->workers[worker], s, offsetof(metrics_snapshot_t, sessions) + (s->numListed * sizeof(s->sessions[0])));
+	metrics_unlock(m);
+
+	#ifdef _WIN32
+		if ((worker == 0) && (m->path != NULL))
+			metrics_write_file(m);
+	#endif
+}
+
+int MetricsWrite(metrics_t *m, FILE *f)
+{
+	static const char *kDir[2] = { "sent", "received" };
+	metrics_snapshot_t *snap;
+	metrics_counters_t t;
+	const metrics_session_t *s;
+	uint32_t numSessions = 0;
+	uint64_t now = UtilTimeMs();
+	uint64_t bytes;
+	double rate, totalRate;
+	int w, i, d;
+
+	snap = malloc((size_t)m->numWorkers * sizeof(*snap));
+
+	if (snap == NULL)
+		return 0;
+
+	memset(&t, 0, sizeof(t));
+
+	//only the copy is taken under the lock, the workers publish while it is written
+	metrics_lock(m);
+
+	for (w = 0; w < m->numWorkers; w++)
+	{
+		memcpy(&snap[w], &m->workers[w], offsetof(metrics_snapshot_t, sessions) + (m->workers[w].numListed * sizeof(snap[w].sessions[0])));
+		MetricsAdd(&t, &snap[w].total);
+		numSessions += snap[w].numSessions;
+	}
+
+	//throughput of all transfers, sampled at most once per interval
+	bytes = t.bytesSent + t.bytesReceived;
+
+	if (now - m->rateMs >= METRICS_INTERVAL_MS)
+	{
+		m->rate = (double)(bytes - m->rateBytes) * 1000.0 / (double)(now - m->rateMs);
+		m->rateBytes = bytes;
+		m->rateMs = now;
+	}
+
+	totalRate = m->rate;
+	metrics_unlock(m);
+
+	metrics_put_header(f, "tftp_bytes_total", "counter", "File data transferred, retransmits not included.");
+	fprintf(f, "tftp_bytes_total{direction=\"sent\"} %llu\n", (unsigned long long)t.bytesSent);
+	fprintf(f, "tftp_bytes_total{direction=\"received\"} %llu\n", (unsigned long long)t.bytesReceived);
+
+	metrics_put_header(f, "tftp_blocks_total", "counter", "DATA blocks sent (retransmits included) and received in order.");
+	fprintf(f, "tftp_blocks_total{direction=\"sent\"} %llu\n", (unsigned long long)t.blocksSent);
+	fprintf(f, "tftp_blocks_total{direction=\"received\"} %llu\n", (unsigned long long)t.blocksReceived);
+
+	metrics_put_header(f, "tftp_retransmits_total", "counter", "DATA blocks, OACKs and ACKs sent again.");
+	fprintf(f, "tftp_retransmits_total %llu\n", (unsigned long long)t.retransmits);
+
+	metrics_put_header(f, "tftp_duplicate_packets_total", "counter", "DATA blocks and ACKs received again.");
+	fprintf(f, "tftp_duplicate_packets_total %llu\n", (unsigned long long)t.duplicates);
+
+	metrics_put_header(f, "tftp_out_of_order_packets_total", "counter", "DATA blocks received ahead of a gap.");
+	fprintf(f, "tftp_out_of_order_packets_total %llu\n", (unsigned long long)t.outOfOrder);
+
+	metrics_put_header(f, "tftp_timeouts_total", "counter", "Retransmission timer expiries.");
+	fprintf(f, "tftp_timeouts_total %llu\n", (unsigned long long)t.timeouts);
+
+	metrics_put_header(f, "tftp_errors_total", "counter", "ERROR packets by direction and error code.");
+
+	for (i = 0; i < METRICS_NUM_ERRORS; i++)
+	{
+		fprintf(f, "tftp_errors_total{direction=\"sent\",code=\"%d\"} %llu\n", i, (unsigned long long)t.errorsSent[i]);
+		fprintf(f, "tftp_errors_total{direction=\"received\",code=\"%d\"} %llu\n", i, (unsigned long long)t.errorsReceived[i]);
+	}
+
+	metrics_put_header(f, "tftp_transfers_total", "counter", "Finished transfers by result.");
+	fprintf(f, "tftp_transfers_total{result=\"ok\"} %llu\n", (unsigned long long)t.transfersOk);
+	fprintf(f, "tftp_transfers_total{result=\"failed\"} %llu\n", (unsigned long long)t.transfersFailed);
+
+	metrics_put_header(f, "tftp_active_sessions", "gauge", "Transfers in progress.");
+	fprintf(f, "tftp_active_sessions %u\n", numSessions);
+
+	metrics_put_header(f, "tftp_throughput_bytes_per_second", "gauge", "File data sent and received per second, all transfers.");
+	fprintf(f, "tftp_throughput_bytes_per_second %.0f\n", totalRate);
+
+	//per session, labelled with client and direction, a file label would make a series per file name
+	metrics_put_header(f, "tftp_session_bytes", "gauge", "File data transferred by an active session.");
+
+	for (w = 0; w < m->numWorkers; w++)
+	{
+		for (i = 0; i < (int)snap[w].numListed; i++)
+		{
+			s = &snap[w].sessions[i];
+			d = s->isUpload;
+
+			fputs("tftp_session_bytes{peer=\"", f);
+			metrics_put_label(f, s->peer);
+			fprintf(f, "\",direction=\"%s\"} %llu\n", kDir[d], (unsigned long long)((d) ? s->c.bytesReceived : s->c.bytesSent));
+		}
+	}
+
+	metrics_put_header(f, "tftp_session_retransmits", "gauge", "Packets sent again by an active session.");
+
+	for (w = 0; w < m->numWorkers; w++)
+	{
+		for (i = 0; i < (int)snap[w].numListed; i++)
+		{
+			s = &snap[w].sessions[i];
+
+			fputs("tftp_session_retransmits{peer=\"", f);
+			metrics_put_label(f, s->peer);
+			fprintf(f, "\"} %llu\n", (unsigned long long)s->c.retransmits);
+		}
+	}
+
+	metrics_put_header(f, "tftp_session_throughput_bytes_per_second", "gauge", "Average throughput of an active session since its request.");
+
+	for (w = 0; w < m->numWorkers; w++)
+	{
+		for (i = 0; i < (int)snap[w].numListed; i++)
+		{
+			s = &snap[w].sessions[i];
+			rate = (s->elapsedMs > 0) ? ((double)(s->c.bytesSent + s->c.bytesReceived) * 1000.0 / (double)s->elapsedMs) : 0.0;
+
+			fputs("tftp_session_throughput_bytes_per_second{peer=\"", f);
+			metrics_put_label(f, s->peer);
+			fprintf(f, "\"} %.0f\n", rate);
+		}
+	}
+
+	free(snap);
+	return !ferror(f);
+}
+
+void MetricsDestroy(metrics_t *m)
+{
+	#ifndef _WIN32
+		if (m->hasThread)
+		{
+			metrics_lock(m);
+			m->stop = 1;
+			metrics_unlock(m);
+
+			pthread_join(m->thread, NULL);
+			m->hasThread = 0;
+
+			//the textfile keeps the final counters
+			if (m->sock < 0)
+				metrics_write_file(m);
+		}
+
+		if (m->sock >= 0)
+		{
+			close(m->sock);
+			unlink(m->path + strlen(METRICS_UNIX_PREFIX));
+			m->sock = -1;
+		}
+	#else
+		if ((m->workers != NULL) && (m->path != NULL))
+			metrics_write_file(m);
+	#endif
+
+	if (m->workers != NULL)
+	{
+		#ifdef _WIN32
+			DeleteCriticalSection(&m->lock);
+		#else
+			pthread_mutex_destroy(&m->lock);
+		#endif
+	}
+
+	free(m->workers);
+	m->workers = NULL;
+}
@@ -0,0 +1,106 @@
+//
+//Transfer metrics, counters of the server workers in the Prometheus text format
+//scraped from a UNIX socket or written to a textfile (node exporter textfile collector)
+//
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <windows.h>
+	typedef CRITICAL_SECTION metrics_lock_t;
+#else
+	#include <pthread.h>
+	typedef pthread_mutex_t metrics_lock_t;
+#endif
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#define METRICS_NUM_ERRORS		9		//TFTP error codes 0-8
+#define METRICS_MAX_SESSIONS	64		//active sessions listed per worker
+#define METRICS_INTERVAL_MS		1000	//workers publish their counters, the textfile is rewritten
+#define METRICS_UNIX_PREFIX		"unix:"	//export path prefix of a UNIX socket
+#define METRICS_SEND_TIMEOUT_MS	1000	//a scrape not read within this time is dropped
+
+typedef struct
+{
+	uint64_t bytesSent;			//file data sent, retransmits not included
+	uint64_t bytesReceived;		//file data received in order
+	uint64_t blocksSent;		//DATA packets sent, retransmits included
+	uint64_t blocksReceived;	//DATA blocks received in order
+	uint64_t retransmits;		//DATA blocks, OACKs and ACKs sent again
+	uint64_t duplicates;		//DATA blocks and ACKs received again
+	uint64_t outOfOrder;		//DATA blocks received ahead of a gap
+	uint64_t timeouts;			//retransmission timer expiries
+	uint64_t errorsSent[METRICS_NUM_ERRORS];		//ERROR packets by error code
+	uint64_t errorsReceived[METRICS_NUM_ERRORS];
+	uint64_t transfersOk;
+	uint64_t transfersFailed;
+} metrics_counters_t;
+
+typedef struct
+{
+	char peer[24];				//client address:port
+	int isUpload;				//the client writes the file (WRQ)
+	uint64_t elapsedMs;			//since the request
+	metrics_counters_t c;
+} metrics_session_t;
+
+//counters of one worker, published every METRICS_INTERVAL_MS
+typedef struct
+{
+	metrics_counters_t total;	//finished and active transfers
+	uint32_t numSessions;		//active sessions
+	uint32_t numListed;			//sessions in the list below, at most METRICS_MAX_SESSIONS
+	metrics_session_t sessions[METRICS_MAX_SESSIONS];
+} metrics_snapshot_t;
+
+typedef struct
+{
+	int numWorkers;
+	metrics_snapshot_t *workers;	//last snapshot of each worker
+	metrics_lock_t lock;
+
+	const char *path;			//textfile or METRICS_UNIX_PREFIX<socket path>
+	int sock;					//UNIX socket, -1 when writing a textfile
+	int stop;					//export thread ends, under lock
+
+	uint64_t rateBytes;			//bytes sent and received at the last throughput sample
+	uint64_t rateMs;
+	double rate;				//bytes per second over the last METRICS_INTERVAL_MS or more
+
+#ifndef _WIN32
+	pthread_t thread;			//serves the socket or rewrites the textfile
+	int hasThread;
+#endif
+} metrics_t;
+
+// sets up the export, path NULL keeps the counters without exporting them
+// returns 1=success, 0=failed
+extern int MetricsCreate(metrics_t *m, int numWorkers, const char *path);
+
+/* adds the counters of src to dst */
+extern void MetricsAdd(metrics_counters_t *dst, const metrics_counters_t *src);
+
+// replaces the snapshot of a worker, thread safe
+// on Windows (no export thread) worker 0 rewrites the textfile
+extern void MetricsPublish(metrics_t *m, int worker, const metrics_snapshot_t *s);
+
+// writes all metrics in the Prometheus text format, thread safe
+// the snapshots are copied under the lock and written without it, a slow reader doesn't hold up the workers
+// returns 1=success, 0=out of memory or write failed
+extern int MetricsWrite(metrics_t *m, FILE *f);
+
+/* stops the export, removes the UNIX socket */
+extern void MetricsDestroy(metrics_t *m);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _METRICS_H
@@ -0,0 +1,239 @@
+//
+//Netascii transfer mode (RFC 1350, RFC 764), streaming conversion between local text files with LF line ends
+//and the wire format: LF is sent as CR LF and CR as CR NUL, the receiver converts them back
+//runs of plain bytes are copied 16 (SSE2) or 32 (AVX2) bytes at a time, a CR/LF pair may be split across blocks
+//
+
+#include "netascii.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define NETASCII_SSE2
+	#include <emmintrin.h>
+#endif
+
+//the AVX2 copy is compiled for the target and chosen at run time if the CPU has AVX2
+#if defined(NETASCII_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define NETASCII_AVX2
+	#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+//copies bytes up to the first CR, or the first CR or LF if withLf is set
+// returns number of bytes copied, the byte at that position is special or the input ended
+static size_t na_copy_scalar(uint8_t *out, const uint8_t *in, size_t n, int withLf)
+{
+	const uint8_t lf = withLf ? '\n' : '\r';
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		if ((in[i] == '\r') || (in[i] == lf))
+			break;
+
+		out[i] = in[i];
+	}
+
+	return i;
+}
+
+#ifdef NETASCII_SSE2
+//index of the lowest set bit, mask not 0
+static unsigned na_ctz(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+#else
+	return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+//na_copy_scalar, 16 bytes per compare
+static size_t na_copy_sse2(uint8_t *out, const uint8_t *in, size_t n, int withLf)
+{
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8(withLf ? '\n' : '\r');
+	__m128i v;
+	uint32_t mask;
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16)
+	{
+		v = _mm_loadu_si128((const __m128i *)&in[i]);
+		mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+
+		if (mask != 0)
+		{
+			memcpy(&out[i], &in[i], na_ctz(mask));
+			return i + na_ctz(mask);
+		}
+
+		_mm_storeu_si128((__m128i *)&out[i], v);
+	}
+
+	return i + na_copy_scalar(&out[i], &in[i], n - i, withLf);
+}
+#endif
+
+#ifdef NETASCII_AVX2
+//na_copy_scalar, 32 bytes per compare
+__attribute__((target("avx2")))
+static size_t na_copy_avx2(uint8_t *out, const uint8_t *in, size_t n, int withLf)
+{
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i lf = _mm256_set1_epi8(withLf ? '\n' : '\r');
+	__m256i v;
+	uint32_t mask;
+	size_t i;
+
+	for (i = 0; i + 32 <= n; i += 32)
+	{
+		v = _mm256_loadu_si256((const __m256i *)&in[i]);
+		mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+
+		if (mask != 0)
+		{
+			memcpy(&out[i], &in[i], na_ctz(mask));
+			return i + na_ctz(mask);
+		}
+
+		_mm256_storeu_si256((__m256i *)&out[i], v);
+	}
+
+	return i + na_copy_sse2(&out[i], &in[i], n - i, withLf);
+}
+#endif
+
+//copies the run of plain bytes at the start of the input with the widest copy the CPU has
+static size_t na_copy(uint8_t *out, const uint8_t *in, size_t n, int withLf)
+{
+#if defined(NETASCII_AVX2)
+	if ((n >= 32) && __builtin_cpu_supports("avx2"))
+		return na_copy_avx2(out, in, n, withLf);
+#endif
+
+#if defined(NETASCII_SSE2)
+	return na_copy_sse2(out, in, n, withLf);
+#else
+	return na_copy_scalar(out, in, n, withLf);
+#endif
+}
+
+void NetasciiInit(netascii_t *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+size_t NetasciiEncode(netascii_t *s, const uint8_t *in, size_t inLen, size_t *used, uint8_t *out, size_t outSize)
+{
+	size_t i = 0;
+	size_t o = 0;
+	size_t n;
+
+	//the pair split by the end of the last block is completed first
+	if (s->hasCarry && (outSize > 0))
+	{
+		out[o++] = s->carry;
+		s->hasCarry = 0;
+	}
+
+	while ((i < inLen) && (o < outSize))
+	{
+		n = inLen - i;
+
+		if (n > outSize - o)
+			n = outSize - o;
+
+		n = na_copy(&out[o], &in[i], n, 1);
+		i += n;
+		o += n;
+
+		if ((i == inLen) || (o == outSize))
+			break;
+
+		//LF -> CR LF, CR -> CR NUL
+		out[o++] = '\r';
+
+		if (o < outSize)
+		{
+			out[o++] = (in[i] == '\n') ? '\n' : '\0';
+		}
+		else
+		{
+			s->carry = (in[i] == '\n') ? '\n' : '\0';
+			s->hasCarry = 1;
+		}
+
+		i++;
+	}
+
+	*used = i;
+	return o;
+}
+
+size_t NetasciiDecode(netascii_t *s, const uint8_t *in, size_t inLen, size_t *used, uint8_t *out, size_t outSize)
+{
+	size_t i = 0;
+	size_t o = 0;
+	size_t n;
+
+	while ((i < inLen) && (o < outSize))
+	{
+		//CR LF -> LF, CR NUL -> CR, a CR followed by anything else is kept and the byte after it is converted on its own
+		if (s->isCr)
+		{
+			s->isCr = 0;
+
+			if (in[i] == '\n')
+			{
+				out[o++] = '\n';
+				i++;
+			}
+			else if (in[i] == '\0')
+			{
+				out[o++] = '\r';
+				i++;
+			}
+			else
+			{
+				out[o++] = '\r';
+			}
+
+			continue;
+		}
+
+		n = inLen - i;
+
+		if (n > outSize - o)
+			n = outSize - o;
+
+		n = na_copy(&out[o], &in[i], n, 0);
+		i += n;
+		o += n;
+
+		if ((i < inLen) && (in[i] == '\r'))
+		{
+			s->isCr = 1;
+			i++;
+		}
+	}
+
+	*used = i;
+	return o;
+}
+
+size_t NetasciiDecodeEnd(netascii_t *s, uint8_t *out)
+{
+	if (!s->isCr)
+		return 0;
+
+	s->isCr = 0;
+	out[0] = '\r';
+	return 1;
+}
@@ -0,0 +1,46 @@
+//
+//Netascii transfer mode (RFC 1350, RFC 764), streaming conversion between local text files with LF line ends
+//and the wire format: LF is sent as CR LF and CR as CR NUL, the receiver converts them back
+//runs of plain bytes are copied 16 (SSE2) or 32 (AVX2) bytes at a time, a CR/LF pair may be split across blocks
+//
+#ifndef _NETASCII_H
+#define _NETASCII_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+//conversion state of one direction of a transfer, carried from block to block
+typedef struct
+{
+	int hasCarry;		//encoder: second byte of a CR LF or CR NUL pair that did not fit into the last block
+	uint8_t carry;
+	int isCr;			//decoder: the last block ended with CR, the next byte completes the pair
+} netascii_t;
+
+/* clears the state for a new transfer */
+extern void NetasciiInit(netascii_t *s);
+
+// converts local text to netascii, stops when the input is used up or out is full
+// used - number of input bytes converted
+// returns number of bytes written to out
+extern size_t NetasciiEncode(netascii_t *s, const uint8_t *in, size_t inLen, size_t *used, uint8_t *out, size_t outSize);
+
+// converts netascii to local text, stops when the input is used up or out is full
+// used - number of input bytes converted
+// returns number of bytes written to out
+extern size_t NetasciiDecode(netascii_t *s, const uint8_t *in, size_t inLen, size_t *used, uint8_t *out, size_t outSize);
+
+// ends decoding, a CR left at the end of the transfer is written as it is
+// out - room for one byte
+// returns number of bytes written to out
+extern size_t NetasciiDecodeEnd(netascii_t *s, uint8_t *out);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _NETASCII_H
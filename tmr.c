@@ -12,29 +12,24 @@
 	#include<time.h>
 #endif
 
-//get num of seconds since boot
-
-/* start a timer (timeout units=seconds) */
-uint32_t get_tick_count()
+/* monotonic time in milliseconds, 64 bit so it never wraps */
+uint64_t UtilTimeMs(void)
 {
 	#ifdef _WIN32
-		return (uint32_t)GetTickCount();
+		return (uint64_t)GetTickCount64();
 	#else
 		struct timespec ts;
 		clock_gettime(CLOCK_MONOTONIC, &ts);
 
 		// Convert seconds and nanoseconds to milliseconds
-		uint64_t milliseconds = (uint64_t)(ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
-
-		// Cast to uint32_t to mimic GetTickCount behavior (wrap around at ~49.7 days)
-		return (uint32_t)milliseconds;
+		return ((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000);
 	#endif
 }
 
 void UtilTickTimerStart(tick_timer_t *t, uint32_t timeout_secs)
 {
 	// get number of seconds since boot
-	t->tStart = get_tick_count();
+	t->tStart = UtilTimeMs();
 	t->tTimeout = (timeout_secs * 1000);
 	t->tDiff = 0;
 	t->running = 1;
@@ -44,7 +39,7 @@ void UtilTickTimerStart(tick_timer_t *t, uint32_t timeout_secs)
 void UtilTickTimerStartMs(tick_timer_t *t, uint32_t timeout_ms)
 {
 	// get number of seconds since boot
-	t->tStart = get_tick_count();
+	t->tStart = UtilTimeMs();
 	t->tTimeout = timeout_ms;
 	t->tDiff = 0;
 	t->running = 1;
@@ -54,15 +49,13 @@ void UtilTickTimerStartMs(tick_timer_t *t, uint32_t timeout_ms)
 // returns 0=timer not exired; 1=timer expired
 int UtilTickTimerRun(tick_timer_t *t)
 {
-	uint32_t now, diff;
+	uint64_t diff;
 
 	if (!t->running)
 		return 0;
 
-	now = get_tick_count();
-
-	diff = (now - t->tStart);
-	t->tDiff = diff;
+	diff = (UtilTimeMs() - t->tStart);
+	t->tDiff = (uint32_t)diff;
 
 	if (diff >= t->tTimeout)
 	{
@@ -78,3 +71,372 @@ void UtilStopTimer(tick_timer_t *t)
 {
 	t->running = 0;
 }
+
+// milliseconds until the timer expires
+// returns 0=timer expired; UINT32_MAX=timer not running
+uint32_t UtilTickTimerRemainingMs(tick_timer_t *t)
+{
+	uint64_t diff;
+
+	if (!t->running)
+		return UINT32_MAX;
+
+	diff = (UtilTimeMs() - t->tStart);
+
+	if (diff >= t->tTimeout)
+		return 0;
+
+	return t->tTimeout - (uint32_t)diff;
+}
+
+/* monotonic time in microseconds, for round trip measurements */
+uint64_t UtilTimeUs(void)
+{
+	#ifdef _WIN32
+		LARGE_INTEGER freq, count;
+
+		QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&count);
+
+		return (uint64_t)((count.QuadPart / freq.QuadPart) * 1000000 +
+			((count.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+	#else
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+	#endif
+}
+
+/* CPU time used by the process (user + system) in microseconds */
+uint64_t UtilCpuTimeUs(void)
+{
+	#ifdef _WIN32
+		FILETIME created, exited, kernel, user;
+		ULARGE_INTEGER k, u;
+
+		if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+			return 0;
+
+		k.LowPart = kernel.dwLowDateTime;
+		k.HighPart = kernel.dwHighDateTime;
+		u.LowPart = user.dwLowDateTime;
+		u.HighPart = user.dwHighDateTime;
+
+		// 100 ns units
+		return (k.QuadPart + u.QuadPart) / 10;
+	#else
+		struct timespec ts;
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+		return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+	#endif
+}
+
+//
+//Hierarchical timer wheel
+//
+//Level 0 holds timers due within the next TMR_WHEEL_SLOTS ms, one slot per ms.
+//Each higher level covers TMR_WHEEL_SLOTS times the span of the level below;
+//its slots are cascaded (re-inserted one level down) when the lower level wraps.
+//
+
+static void wheel_list_init(wheel_timer_t *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+static void wheel_list_unlink(wheel_timer_t *t)
+{
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = NULL;
+	t->prev = NULL;
+}
+
+static void wheel_list_append(wheel_timer_t *head, wheel_timer_t *t)
+{
+	t->prev = head->prev;
+	t->next = head;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+//puts a timer into the slot matching its expiry time
+static void wheel_insert(timer_wheel_t *w, wheel_timer_t *t)
+{
+	uint64_t expires = t->expires;
+	uint64_t delta;
+	int level, shift;
+
+	// already due, fire on the next tick
+	if (expires < w->current)
+		expires = w->current;
+
+	delta = expires - w->current;
+
+	for (level = 0; level < TMR_WHEEL_LEVELS - 1; level++)
+	{
+		if (delta < ((uint64_t)1 << (TMR_WHEEL_BITS * (level + 1))))
+			break;
+	}
+
+	// beyond the top level, park it in the furthest slot and re-cascade from there
+	shift = TMR_WHEEL_BITS * level;
+
+	if (delta >= ((uint64_t)1 << (TMR_WHEEL_BITS * TMR_WHEEL_LEVELS)))
+		expires = w->current + ((uint64_t)1 << (TMR_WHEEL_BITS * TMR_WHEEL_LEVELS)) - 1;
+
+	wheel_list_append(&w->slots[level][(expires >> shift) & TMR_WHEEL_MASK], t);
+}
+
+//moves all timers of a higher level slot one level down
+//returns - index of the slot that was cascaded
+static int wheel_cascade(timer_wheel_t *w, int level)
+{
+	int idx = (int)((w->current >> (TMR_WHEEL_BITS * level)) & TMR_WHEEL_MASK);
+	wheel_timer_t *head = &w->slots[level][idx];
+	wheel_timer_t list;
+	wheel_timer_t *t;
+
+	if (head->next == head)
+		return idx;
+
+	// detach the slot first, timers may land in the same slot again
+	list.next = head->next;
+	list.prev = head->prev;
+	list.next->prev = &list;
+	list.prev->next = &list;
+	wheel_list_init(head);
+
+	while (list.next != &list)
+	{
+		t = list.next;
+		wheel_list_unlink(t);
+		wheel_insert(w, t);
+	}
+
+	return idx;
+}
+
+void UtilWheelInit(timer_wheel_t *w)
+{
+	int level, i;
+
+	for (level = 0; level < TMR_WHEEL_LEVELS; level++)
+	{
+		for (i = 0; i < TMR_WHEEL_SLOTS; i++)
+			wheel_list_init(&w->slots[level][i]);
+	}
+
+	w->now = UtilTimeMs();
+	w->current = w->now;
+	w->count = 0;
+}
+
+// samples the monotonic clock, call once per loop iteration
+// returns - current time in ms
+uint64_t UtilWheelUpdateTime(timer_wheel_t *w)
+{
+	w->now = UtilTimeMs();
+
+	// nothing to expire, skip the idle period instead of walking it tick by tick
+	if (w->count == 0)
+		w->current = w->now;
+
+	return w->now;
+}
+
+void UtilWheelTimerInit(wheel_timer_t *t, wheel_timer_cb_t cb, void *arg)
+{
+	t->next = NULL;
+	t->prev = NULL;
+	t->expires = 0;
+	t->cb = cb;
+	t->arg = arg;
+}
+
+/* (re)start a timer relative to the last sampled time (timeout units=milliseconds) */
+void UtilWheelTimerStartMs(timer_wheel_t *w, wheel_timer_t *t, uint32_t timeout_ms)
+{
+	UtilWheelTimerStop(w, t);
+
+	if (w->count == 0)
+		w->current = w->now;
+
+	t->expires = w->now + timeout_ms;
+	wheel_insert(w, t);
+	w->count++;
+}
+
+void UtilWheelTimerStop(timer_wheel_t *w, wheel_timer_t *t)
+{
+	if (t->next == NULL)
+		return;
+
+	wheel_list_unlink(t);
+	w->count--;
+}
+
+// returns 0=timer stopped or expired; 1=timer running
+int UtilWheelTimerRunning(wheel_timer_t *t)
+{
+	return (t->next != NULL);
+}
+
+// fires the callbacks of all timers expired up to the last sampled time
+// returns - number of expired timers
+int UtilWheelRun(timer_wheel_t *w)
+{
+	wheel_timer_t expired;
+	wheel_timer_t *head;
+	wheel_timer_t *t;
+	int level, idx;
+	int num = 0;
+
+	wheel_list_init(&expired);
+
+	while ((w->count > 0) && (w->current <= w->now))
+	{
+		idx = (int)(w->current & TMR_WHEEL_MASK);
+
+		// level 0 wrapped, pull the next span down from the levels above
+		for (level = 1; (idx == 0) && (level < TMR_WHEEL_LEVELS); level++)
+		{
+			if (wheel_cascade(w, level) != 0)
+				break;
+		}
+
+		head = &w->slots[0][idx];
+
+		while (head->next != head)
+		{
+			t = head->next;
+			wheel_list_unlink(t);
+			wheel_list_append(&expired, t);
+		}
+
+		w->current++;
+	}
+
+	if (w->count == 0)
+		w->current = w->now;
+
+	// callbacks run after the walk, they may start or stop any timer
+	while (expired.next != &expired)
+	{
+		t = expired.next;
+		wheel_list_unlink(t);
+		w->count--;
+		num++;
+
+		t->cb(t->arg);
+	}
+
+	return num;
+}
+
+// milliseconds until the next timer may expire, for the event loop timeout
+// returns 0..max_ms
+uint32_t UtilWheelNextTimeoutMs(timer_wheel_t *w, uint32_t max_ms)
+{
+	uint64_t next = UINT64_MAX;
+	uint64_t base, tick;
+	int level, shift, i;
+
+	if (w->count == 0)
+		return max_ms;
+
+	// level 0 slots hold exact expiry ticks
+	for (i = 0; i < TMR_WHEEL_SLOTS; i++)
+	{
+		tick = w->current + i;
+
+		if (w->slots[0][tick & TMR_WHEEL_MASK].next != &w->slots[0][tick & TMR_WHEEL_MASK])
+		{
+			next = tick;
+			break;
+		}
+	}
+
+	// higher levels only tell when their slot is cascaded, an early wakeup is harmless
+	for (level = 1; level < TMR_WHEEL_LEVELS; level++)
+	{
+		shift = TMR_WHEEL_BITS * level;
+		base = w->current >> shift;
+
+		// on a boundary of the level the slot of 'current' is cascaded by the next tick, it still holds its timers
+		i = ((w->current & (((uint64_t)1 << shift) - 1)) == 0) ? 0 : 1;
+
+		for (; i <= TMR_WHEEL_SLOTS; i++)
+		{
+			if (w->slots[level][(base + i) & TMR_WHEEL_MASK].next != &w->slots[level][(base + i) & TMR_WHEEL_MASK])
+			{
+				tick = (base + i) << shift;
+
+				if (tick < next)
+					next = tick;
+
+				break;
+			}
+		}
+	}
+
+	if (next <= w->now)
+		return 0;
+
+	if ((next - w->now) > max_ms)
+		return max_ms;
+
+	return (uint32_t)(next - w->now);
+}
+
+#ifdef TMR_WHEEL_SELFTEST
+//regression check of the wheel, built and run by 'make check'
+//a timer on a higher level whose slot is due at the level boundary 'current' sits on must not be reported late
+
+static void wheel_check_cb(void *arg)
+{
+	(*(int *)arg)++;
+}
+
+int main(void)
+{
+	static timer_wheel_t w;
+	wheel_timer_t t;
+	uint64_t start, stop;
+	uint32_t timeout_ms;
+	int fired;
+	int failed = 0;
+
+	//timers started at every offset of a level 1 span, the wheel walked up to just before they expire
+	for (start = 64000; start < 64000 + 2 * TMR_WHEEL_SLOTS; start++)
+	{
+		for (stop = start; stop < start + 110; stop++)
+		{
+			UtilWheelInit(&w);
+			w.now = start;
+			w.current = start;
+			fired = 0;
+
+			UtilWheelTimerInit(&t, wheel_check_cb, &fired);
+			UtilWheelTimerStartMs(&w, &t, 110);
+
+			w.now = stop;
+			UtilWheelRun(&w);
+			timeout_ms = UtilWheelNextTimeoutMs(&w, 1000);
+
+			if (fired || (timeout_ms > start + 110 - stop))
+			{
+				printf("timer due at %llu, current %llu: next timeout %u ms\n", (unsigned long long)(start + 110),
+					(unsigned long long)w.current, timeout_ms);
+				failed = 1;
+			}
+		}
+	}
+
+	printf("timer wheel check %s\n", failed ? "failed" : "passed");
+	return failed;
+}
+#endif
@@ -12,7 +12,7 @@ extern "C"{
 
 typedef struct
 {
-	uint32_t tStart;
+	uint64_t tStart;
 	uint32_t tTimeout;
 	uint32_t tDiff;
 	uint32_t running;
@@ -30,6 +30,70 @@ extern int UtilTickTimerRun(tick_timer_t *t);
 
 extern void UtilStopTimer(tick_timer_t *t);
 
+// milliseconds until the timer expires
+// returns 0=timer expired; UINT32_MAX=timer not running
+extern uint32_t UtilTickTimerRemainingMs(tick_timer_t *t);
+
+/* monotonic time in milliseconds, 64 bit so it never wraps */
+extern uint64_t UtilTimeMs(void);
+
+/* monotonic time in microseconds, for round trip measurements */
+extern uint64_t UtilTimeUs(void);
+
+/* CPU time used by the process (user + system) in microseconds */
+extern uint64_t UtilCpuTimeUs(void);
+
+//
+//Hierarchical timer wheel, O(1) start/stop of timers, 1 ms resolution
+//
+#define TMR_WHEEL_BITS		6
+#define TMR_WHEEL_SLOTS		(1 << TMR_WHEEL_BITS)
+#define TMR_WHEEL_MASK		(TMR_WHEEL_SLOTS - 1)
+#define TMR_WHEEL_LEVELS	4	//covers 2^24 ms (~4.6 hours), longer timeouts are re-cascaded
+
+typedef void (*wheel_timer_cb_t)(void *arg);
+
+typedef struct wheel_timer_s
+{
+	struct wheel_timer_s *next;	//slot list, NULL when the timer is not running
+	struct wheel_timer_s *prev;
+	uint64_t expires;			//absolute expiry time in ms
+	wheel_timer_cb_t cb;		//called once the timer expires
+	void *arg;
+} wheel_timer_t;
+
+typedef struct
+{
+	uint64_t now;		//clock sampled once per loop iteration by UtilWheelUpdateTime
+	uint64_t current;	//next tick to be processed by UtilWheelRun
+	uint32_t count;		//number of running timers
+	wheel_timer_t slots[TMR_WHEEL_LEVELS][TMR_WHEEL_SLOTS];	//list heads
+} timer_wheel_t;
+
+extern void UtilWheelInit(timer_wheel_t *w);
+
+// samples the monotonic clock, call once per loop iteration
+// returns - current time in ms
+extern uint64_t UtilWheelUpdateTime(timer_wheel_t *w);
+
+extern void UtilWheelTimerInit(wheel_timer_t *t, wheel_timer_cb_t cb, void *arg);
+
+/* (re)start a timer relative to the last sampled time (timeout units=milliseconds) */
+extern void UtilWheelTimerStartMs(timer_wheel_t *w, wheel_timer_t *t, uint32_t timeout_ms);
+
+extern void UtilWheelTimerStop(timer_wheel_t *w, wheel_timer_t *t);
+
+// returns 0=timer stopped or expired; 1=timer running
+extern int UtilWheelTimerRunning(wheel_timer_t *t);
+
+// fires the callbacks of all timers expired up to the last sampled time
+// returns - number of expired timers
+extern int UtilWheelRun(timer_wheel_t *w);
+
+// milliseconds until the next timer may expire, for the event loop timeout
+// returns 0..max_ms
+extern uint32_t UtilWheelNextTimeoutMs(timer_wheel_t *w, uint32_t max_ms);
+
 #if defined(__cplusplus)
 }
 #endif
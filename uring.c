@@ -0,0 +1,337 @@
+//
+//io_uring, minimal ring over the raw system calls (no liburing)
+//submission/completion rings, fixed files and a provided buffer ring for receives
+//
+
+#include "uring.h"
+
+#ifdef URING_SUPPORTED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/time_types.h>
+
+#define URING_LOAD(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define URING_STORE(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argLen)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argLen);
+}
+
+static int uring_register(int fd, unsigned op, void *arg, unsigned numArgs)
+{
+	return (int)syscall(__NR_io_uring_register, fd, op, arg, numArgs);
+}
+
+int UringInit(uring_t *r, unsigned entries, unsigned cqEntries)
+{
+	struct io_uring_params p;
+	unsigned i;
+
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+
+	//one thread submits and reaps, completion work then runs only when it waits
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+	p.cq_entries = cqEntries;
+
+	r->fd = uring_setup(entries, &p);
+
+	if (r->fd < 0)
+	{
+		memset(&p, 0, sizeof(p));
+		p.flags = IORING_SETUP_CQSIZE;
+		p.cq_entries = cqEntries;
+
+		r->fd = uring_setup(entries, &p);
+	}
+
+	if (r->fd < 0)
+		return 0;
+
+	//waits with a timeout need IORING_ENTER_EXT_ARG (5.11)
+	if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP))
+	{
+		close(r->fd);
+		r->fd = -1;
+		return 0;
+	}
+
+	r->features = p.features;
+	r->sqRingLen = p.sq_off.array + (p.sq_entries * sizeof(unsigned));
+	r->cqRingLen = p.cq_off.cqes + (p.cq_entries * sizeof(struct io_uring_cqe));
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (r->cqRingLen > r->sqRingLen)
+			r->sqRingLen = r->cqRingLen;
+
+		r->cqRingLen = r->sqRingLen;
+	}
+
+	r->sqRing = mmap(NULL, r->sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+
+	if (r->sqRing == MAP_FAILED)
+	{
+		r->sqRing = NULL;
+		UringDestroy(r);
+		return 0;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		r->cqRing = r->sqRing;
+	}
+	else
+	{
+		r->cqRing = mmap(NULL, r->cqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+
+		if (r->cqRing == MAP_FAILED)
+		{
+			r->cqRing = NULL;
+			UringDestroy(r);
+			return 0;
+		}
+	}
+
+	r->sqesLen = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+
+	if (r->sqes == MAP_FAILED)
+	{
+		r->sqes = NULL;
+		UringDestroy(r);
+		return 0;
+	}
+
+	r->sqHead = (unsigned *)((uint8_t *)r->sqRing + p.sq_off.head);
+	r->sqTail = (unsigned *)((uint8_t *)r->sqRing + p.sq_off.tail);
+	r->sqArray = (unsigned *)((uint8_t *)r->sqRing + p.sq_off.array);
+	r->sqMask = *(unsigned *)((uint8_t *)r->sqRing + p.sq_off.ring_mask);
+	r->sqEntries = p.sq_entries;
+	r->sqLocalTail = *r->sqTail;
+
+	r->cqHead = (unsigned *)((uint8_t *)r->cqRing + p.cq_off.head);
+	r->cqTail = (unsigned *)((uint8_t *)r->cqRing + p.cq_off.tail);
+	r->cqMask = *(unsigned *)((uint8_t *)r->cqRing + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)((uint8_t *)r->cqRing + p.cq_off.cqes);
+
+	//SQE i always sits in slot i of the index array
+	for (i = 0; i < r->sqEntries; i++)
+		r->sqArray[i] = i;
+
+	return 1;
+}
+
+struct io_uring_sqe *UringGetSqe(uring_t *r)
+{
+	struct io_uring_sqe *sqe;
+
+	if (r->sqLocalTail - URING_LOAD(r->sqHead) >= r->sqEntries)
+		return NULL;
+
+	sqe = &r->sqes[r->sqLocalTail & r->sqMask];
+	r->sqLocalTail++;
+
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+unsigned UringSqSpace(uring_t *r)
+{
+	return r->sqEntries - (r->sqLocalTail - URING_LOAD(r->sqHead));
+}
+
+int UringSubmit(uring_t *r)
+{
+	unsigned toSubmit;
+	int ret;
+
+	URING_STORE(r->sqTail, r->sqLocalTail);
+	toSubmit = r->sqLocalTail - URING_LOAD(r->sqHead);
+
+	if (toSubmit == 0)
+		return 0;
+
+	ret = uring_enter(r->fd, toSubmit, 0, 0, NULL, 0);
+
+	return (ret < 0) ? -errno : ret;
+}
+
+int UringSubmitAndWait(uring_t *r, int timeout_ms)
+{
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	unsigned toSubmit;
+	unsigned waitNr;
+	int ret;
+
+	URING_STORE(r->sqTail, r->sqLocalTail);
+	toSubmit = r->sqLocalTail - URING_LOAD(r->sqHead);
+
+	//completions already posted are reaped without sleeping
+	waitNr = (*r->cqHead != URING_LOAD(r->cqTail)) ? 0 : 1;
+
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.sigmask_sz = _NSIG / 8;
+	arg.ts = (uint64_t)(uintptr_t)&ts;
+
+	ret = uring_enter(r->fd, toSubmit, waitNr, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+
+	if ((ret < 0) && (errno != ETIME))
+		return -errno;
+
+	return 0;
+}
+
+struct io_uring_cqe *UringPeekCqe(uring_t *r)
+{
+	unsigned head = *r->cqHead;
+
+	if (head == URING_LOAD(r->cqTail))
+		return NULL;
+
+	return &r->cqes[head & r->cqMask];
+}
+
+void UringCqeSeen(uring_t *r)
+{
+	URING_STORE(r->cqHead, *r->cqHead + 1);
+}
+
+int UringRegisterFiles(uring_t *r, unsigned num)
+{
+	int *fds = malloc(num * sizeof(int));
+	unsigned i;
+	int ret;
+
+	if (fds == NULL)
+		return 0;
+
+	for (i = 0; i < num; i++)
+		fds[i] = -1;
+
+	ret = uring_register(r->fd, IORING_REGISTER_FILES, fds, num);
+	free(fds);
+
+	return (ret >= 0);
+}
+
+int UringUpdateFile(uring_t *r, unsigned slot, int fd)
+{
+	struct io_uring_files_update up;
+
+	memset(&up, 0, sizeof(up));
+	up.offset = slot;
+	up.fds = (uint64_t)(uintptr_t)&fd;
+
+	return (uring_register(r->fd, IORING_REGISTER_FILES_UPDATE, &up, 1) == 1);
+}
+
+int UringSetupBufRing(uring_t *r, unsigned numBufs, unsigned bufSize, uint16_t bgid)
+{
+	struct io_uring_buf_reg reg;
+	size_t ringLen = numBufs * sizeof(struct io_uring_buf);
+	unsigned i;
+
+	//numBufs must be a power of 2
+	r->bufRing = mmap(NULL, ringLen, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+	if (r->bufRing == MAP_FAILED)
+	{
+		r->bufRing = NULL;
+		return 0;
+	}
+
+	r->bufs = malloc((size_t)numBufs * bufSize);
+
+	if (r->bufs == NULL)
+	{
+		munmap(r->bufRing, ringLen);
+		r->bufRing = NULL;
+		return 0;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)r->bufRing;
+	reg.ring_entries = numBufs;
+	reg.bgid = bgid;
+
+	if (uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+	{
+		free(r->bufs);
+		munmap(r->bufRing, ringLen);
+		r->bufs = NULL;
+		r->bufRing = NULL;
+		return 0;
+	}
+
+	r->numBufs = numBufs;
+	r->bufSize = bufSize;
+	r->bufGroup = bgid;
+	r->bufTail = 0;
+
+	for (i = 0; i < numBufs; i++)
+		UringBufRecycle(r, (uint16_t)i);
+
+	return 1;
+}
+
+uint8_t *UringBuf(uring_t *r, uint16_t bid)
+{
+	return &r->bufs[(size_t)bid * r->bufSize];
+}
+
+void UringBufRecycle(uring_t *r, uint16_t bid)
+{
+	//the ring tail overlays the resv field of entry 0, only the other fields are written
+	struct io_uring_buf *b = &r->bufRing->bufs[r->bufTail & (r->numBufs - 1)];
+
+	b->addr = (uint64_t)(uintptr_t)UringBuf(r, bid);
+	b->len = r->bufSize;
+	b->bid = bid;
+
+	r->bufTail++;
+	URING_STORE(&r->bufRing->tail, r->bufTail);
+}
+
+void UringDestroy(uring_t *r)
+{
+	if (r->bufRing != NULL)
+		munmap(r->bufRing, r->numBufs * sizeof(struct io_uring_buf));
+
+	free(r->bufs);
+
+	if (r->sqes != NULL)
+		munmap(r->sqes, r->sqesLen);
+
+	if ((r->cqRing != NULL) && (r->cqRing != r->sqRing))
+		munmap(r->cqRing, r->cqRingLen);
+
+	if (r->sqRing != NULL)
+		munmap(r->sqRing, r->sqRingLen);
+
+	if (r->fd >= 0)
+		close(r->fd);
+
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+#endif // URING_SUPPORTED
@@ -0,0 +1,108 @@
+//
+//io_uring, minimal ring over the raw system calls (no liburing)
+//submission/completion rings, fixed files and a provided buffer ring for receives
+//
+#ifndef _URING_H
+#define _URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __linux__
+	#include <linux/io_uring.h>
+
+	//multishot recvmsg and provided buffer rings, kernel headers >= 6.0
+	#ifdef IORING_RECV_MULTISHOT
+		#define URING_SUPPORTED
+	#endif
+#endif
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#ifdef URING_SUPPORTED
+
+typedef struct
+{
+	int fd;
+	unsigned features;
+
+	//submission ring, SQEs prepared since the last submit are [*sqTail, sqLocalTail)
+	unsigned *sqHead;
+	unsigned *sqTail;
+	unsigned *sqArray;
+	unsigned sqMask;
+	unsigned sqEntries;
+	unsigned sqLocalTail;
+	struct io_uring_sqe *sqes;
+
+	//completion ring
+	unsigned *cqHead;
+	unsigned *cqTail;
+	unsigned cqMask;
+	struct io_uring_cqe *cqes;
+
+	void *sqRing;
+	void *cqRing;
+	size_t sqRingLen;
+	size_t cqRingLen;
+	size_t sqesLen;
+
+	//provided buffers, the kernel picks one per received datagram
+	struct io_uring_buf_ring *bufRing;
+	uint8_t *bufs;
+	unsigned numBufs;
+	unsigned bufSize;
+	uint16_t bufGroup;
+	uint16_t bufTail;
+} uring_t;
+
+/* sets up a ring, returns 1=success, 0=io_uring not available */
+extern int UringInit(uring_t *r, unsigned entries, unsigned cqEntries);
+
+// gets a zeroed SQE to prepare, it is submitted by the next UringSubmit/UringSubmitAndWait
+// returns NULL if the submission ring is full
+extern struct io_uring_sqe *UringGetSqe(uring_t *r);
+
+/* returns number of SQEs UringGetSqe can still hand out before the next submit */
+extern unsigned UringSqSpace(uring_t *r);
+
+/* submits the prepared SQEs, returns number submitted, -errno on failure */
+extern int UringSubmit(uring_t *r);
+
+// submits the prepared SQEs and waits for a completion or the timeout
+// returns 0 on completion or timeout, -errno on failure (-EINTR: signal)
+extern int UringSubmitAndWait(uring_t *r, int timeout_ms);
+
+// gets the next completion
+// returns NULL if there is none
+extern struct io_uring_cqe *UringPeekCqe(uring_t *r);
+
+/* marks the completion returned by UringPeekCqe as consumed */
+extern void UringCqeSeen(uring_t *r);
+
+/* registers a sparse fixed file table of num slots, returns 1=success, 0=failed */
+extern int UringRegisterFiles(uring_t *r, unsigned num);
+
+/* puts a file into a fixed file slot, fd -1 empties the slot, returns 1=success, 0=failed */
+extern int UringUpdateFile(uring_t *r, unsigned slot, int fd);
+
+/* registers numBufs receive buffers of bufSize bytes as buffer group bgid, returns 1=success, 0=failed */
+extern int UringSetupBufRing(uring_t *r, unsigned numBufs, unsigned bufSize, uint16_t bgid);
+
+/* gets a provided buffer */
+extern uint8_t *UringBuf(uring_t *r, uint16_t bid);
+
+/* hands a provided buffer back to the kernel */
+extern void UringBufRecycle(uring_t *r, uint16_t bid);
+
+extern void UringDestroy(uring_t *r);
+
+#endif // URING_SUPPORTED
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _URING_H
@@ -0,0 +1,275 @@
+//
+//File writer, received data collected into large aligned chunks
+//the chunks are written as io_job_t by the I/O threads, the ring or inline
+//
+
+#define _FILE_OFFSET_BITS 64	//64 bit off_t for files over 2 GB on 32 bit builds
+
+#ifdef __linux__
+	#define _GNU_SOURCE		//O_DIRECT, fallocate
+#endif
+
+#include "writer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <sys/statvfs.h>
+#endif
+
+//allocates a chunk starting at the current end of the file
+//job and buffer share one allocation, the buffer starts WRITER_ALIGN bytes in
+static io_job_t *writer_alloc_chunk(file_writer_t *w)
+{
+	io_job_t *job;
+	void *p;
+
+#ifdef _WIN32
+	p = malloc(WRITER_ALIGN + WRITER_CHUNK);
+
+	if (p == NULL)
+		return NULL;
+#else
+	if (posix_memalign(&p, WRITER_ALIGN, WRITER_ALIGN + WRITER_CHUNK) != 0)
+		return NULL;
+#endif
+
+	job = (io_job_t *)p;
+	memset(job, 0, sizeof(*job));
+
+	job->op = IO_OP_WRITE;
+	job->pFile = w->pFile;
+	job->buf = (uint8_t *)p + WRITER_ALIGN;
+	job->offset = w->size;
+
+	return job;
+}
+
+#ifdef __linux__
+//gives back the blocks reserved past the end of the data
+//the file is cut at the data written, chunks collected but not written are not part of it
+static void writer_release(file_writer_t *w)
+{
+	struct stat st;
+
+	if ((w->reserved > 0) && (fstat(fileno(w->pFile), &st) == 0))
+	{
+		if ((uint64_t)st.st_size > w->size)
+			st.st_size = (off_t)w->size;
+
+		if (ftruncate(fileno(w->pFile), st.st_size) != 0)
+			printf("failed to release the space reserved for the file\n");
+	}
+
+	w->reserved = 0;
+}
+#endif
+
+int WriterInit(file_writer_t *w, FILE *pFile, uint64_t offset, uint64_t expectedSize, int isDirect, int isNetascii)
+{
+	memset(w, 0, sizeof(*w));
+	w->pFile = pFile;
+	w->size = offset;
+	w->isNetascii = isNetascii;
+	NetasciiInit(&w->ascii);
+
+	//a partial file longer than the offset it is resumed from loses its tail, a reused one all of it
+#ifdef _WIN32
+	if (_chsize_s(_fileno(pFile), (__int64)offset) != 0)
+		return 0;
+#else
+	if (ftruncate(fileno(pFile), (off_t)offset) != 0)
+		return 0;
+#endif
+
+#ifdef __linux__
+	int fd = fileno(pFile);
+	struct statvfs vfs;
+
+	//one allocation for the whole file instead of growing it chunk by chunk, the file size is not changed
+	//the size comes from the peer, more than the free space is refused before anything is allocated
+	if (expectedSize > offset)
+	{
+		if ((fstatvfs(fd, &vfs) == 0) && (expectedSize - offset > (uint64_t)vfs.f_bavail * vfs.f_frsize))
+			return 0;
+
+		//a failed allocation may have reserved part of the space
+		w->reserved = expectedSize;
+
+		if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)expectedSize) == 0)
+		{
+			w->isPrealloc = 1;
+		}
+		else
+		{
+			int err = errno;
+
+			writer_release(w);
+
+			if ((err == ENOSPC) || (err == EFBIG))
+				return 0;
+		}
+	}
+
+	if (isDirect)
+	{
+		if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) == 0)
+			w->isDirect = 1;
+		else
+			printf("O_DIRECT not supported for this file, using buffered writes\n");
+	}
+#else
+	(void)expectedSize;
+	(void)isDirect;
+#endif
+
+	return 1;
+}
+
+void WriterInitRange(file_writer_t *w, FILE *pFile, uint64_t offset)
+{
+	memset(w, 0, sizeof(*w));
+	w->pFile = pFile;
+	w->size = offset;
+	NetasciiInit(&w->ascii);
+}
+
+int WriterPreallocate(FILE *pFile, uint64_t size)
+{
+#ifdef _WIN32
+	return (_chsize_s(_fileno(pFile), (__int64)size) == 0);
+#else
+#ifdef __linux__
+	//blocks allocated up front, the ranges do not fragment the file as they grow side by side
+	if (size > 0)
+	{
+		if (fallocate(fileno(pFile), 0, 0, (off_t)size) == 0)
+			return 1;
+
+		if ((errno == ENOSPC) || (errno == EFBIG))
+			return 0;
+	}
+#endif
+
+	return (ftruncate(fileno(pFile), (off_t)size) == 0);
+#endif
+}
+
+int WriterAppend(file_writer_t *w, const uint8_t *data, size_t len, int isLast)
+{
+	io_job_t *job;
+	size_t n;
+	size_t used;
+
+	//a netascii CR at the very end has no pair, it is written as it is
+	while ((len > 0) || (isLast && w->ascii.isCr))
+	{
+		if (w->job == NULL)
+		{
+			w->job = writer_alloc_chunk(w);
+
+			if (w->job == NULL)
+				return 0;
+		}
+
+		job = w->job;
+		n = WRITER_CHUNK - job->len;
+
+		if (len == 0)
+		{
+			n = NetasciiDecodeEnd(&w->ascii, &job->buf[job->len]);
+			used = 0;
+		}
+		else if (w->isNetascii)
+		{
+			//the text is converted while it is copied into the chunk
+			n = NetasciiDecode(&w->ascii, data, len, &used, &job->buf[job->len], n);
+		}
+		else
+		{
+			if (n > len)
+				n = len;
+
+			memcpy(&job->buf[job->len], data, n);
+			used = n;
+		}
+
+		job->len += n;
+		w->size += n;
+		data += used;
+		len -= used;
+
+		//chunks are always full, their offsets and lengths stay aligned
+		if (job->len == WRITER_CHUNK)
+		{
+			w->ready[w->numReady++] = job;
+			w->job = NULL;
+		}
+	}
+
+	if (isLast && (w->job != NULL))
+	{
+		job = w->job;
+
+		//a direct write covers whole blocks, the padding is cut off by WriterFinish
+		if (w->isDirect)
+		{
+			n = (job->len + WRITER_ALIGN - 1) & ~(size_t)(WRITER_ALIGN - 1);
+			memset(&job->buf[job->len], 0, n - job->len);
+			job->len = n;
+		}
+
+		w->ready[w->numReady++] = job;
+		w->job = NULL;
+	}
+
+	return 1;
+}
+
+io_job_t *WriterTake(file_writer_t *w)
+{
+	io_job_t *job;
+
+	if (w->numReady == 0)
+		return NULL;
+
+	job = w->ready[0];
+	w->ready[0] = w->ready[1];
+	w->numReady--;
+
+	return job;
+}
+
+int WriterFinish(file_writer_t *w)
+{
+#ifndef _WIN32
+	//the cut frees the reservation past the end too
+	w->reserved = 0;
+
+	if (w->isDirect || w->isPrealloc)
+		return (ftruncate(fileno(w->pFile), (off_t)w->size) == 0);
+#endif
+
+	(void)w;
+	return 1;
+}
+
+void WriterFree(file_writer_t *w)
+{
+#ifdef __linux__
+	//a transfer that failed or was cut off keeps only the data it received
+	writer_release(w);
+#endif
+
+	free(w->job);
+	w->job = NULL;
+
+	while (w->numReady > 0)
+		free(WriterTake(w));
+}
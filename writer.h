@@ -0,0 +1,73 @@
+//
+//File writer, received data collected into large aligned chunks
+//the chunks are written as io_job_t by the I/O threads, the ring or inline
+//
+#ifndef _WRITER_H
+#define _WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "iopool.h"
+#include "netascii.h"
+
+#if defined(__cplusplus)
+extern "C"{
+#endif
+
+#define WRITER_ALIGN		4096			//O_DIRECT alignment of buffers, offsets and lengths
+#define WRITER_CHUNK		(256 * 1024)	//bytes per write job, a multiple of WRITER_ALIGN
+
+typedef struct
+{
+	FILE *pFile;
+	int isDirect;				//file written with O_DIRECT, the last chunk is padded
+	int isPrealloc;				//space reserved for the expected size
+	int isNetascii;				//data received in netascii mode, converted to LF line ends as it is appended
+	netascii_t ascii;
+	uint64_t size;				//end of the data so far, the start offset plus the bytes appended
+	uint64_t reserved;			//end of the space reserved past the data, released if the file is not finished
+
+	io_job_t *job;				//chunk being collected
+	io_job_t *ready[2];			//chunks completed by the last append
+	int numReady;
+} file_writer_t;
+
+// prepares writing a file from an offset, the file is cut there
+// offset - data kept at the start of the file (resumed transfer), a multiple of WRITER_ALIGN, 0 for a new file
+// expectedSize - size announced by the sender (tsize), space is reserved up front if the file system has it free, 0 if unknown
+// isDirect - 1 writes with O_DIRECT if the file system supports it (Linux)
+// isNetascii - 1 converts the appended data from netascii
+// returns 1=success, 0=not enough space for expectedSize or the file could not be cut
+extern int WriterInit(file_writer_t *w, FILE *pFile, uint64_t offset, uint64_t expectedSize, int isDirect, int isNetascii);
+
+// prepares writing one byte range of a file other sessions write the other ranges of (parallel download)
+// the file keeps its size and the data around the range, no space is reserved and O_DIRECT is not used
+// (the padding of a last direct chunk would overwrite the start of the next range)
+// offset - file offset of the range
+extern void WriterInitRange(file_writer_t *w, FILE *pFile, uint64_t offset);
+
+// sets the size of a file written in ranges before the ranges are written, space is reserved (Linux)
+// returns 1=success, 0=not enough space
+extern int WriterPreallocate(FILE *pFile, uint64_t size);
+
+// copies data to the end of the file, take the chunks it completed with WriterTake before appending again
+// isLast - end of the file, the partial chunk is completed too
+// returns 1=success, 0=out of memory
+extern int WriterAppend(file_writer_t *w, const uint8_t *data, size_t len, int isLast);
+
+// takes a completed chunk, an IO_OP_WRITE job at its file offset, freed with free() once written
+// returns job or NULL if there is none
+extern io_job_t *WriterTake(file_writer_t *w);
+
+// completes the file once all chunks are written, trims padding and unused reserved space
+// returns 1=success, 0=failed
+extern int WriterFinish(file_writer_t *w);
+
+/* frees the chunks not taken and the space reserved for a file that was not finished, the file is left open */
+extern void WriterFree(file_writer_t *w);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // _WRITER_H